@@ -0,0 +1,408 @@
+/*
+ * ECE 521 - Computer Design Techniques, Fall 2014
+ * Project 3 - Dynamic Instruction Scheduler
+ *
+ * This module builds the cache hierarchy configuration. The usual L1 + L2
+ * hierarchy comes from the command line with the fixed project latencies;
+ * a configuration file can describe any number of levels (up to
+ * CACHE_MAX_LEVELS) with per level geometry, policies and latencies. The
+ * file is line based, '#' starts a comment:
+ *
+ *  level   <size> <assoc> <block-size> <lru|lfu> <wbwa|wtna> <hit-latency>
+ *  victim  <size> <hit-latency>
+ *  memory  <latency>
+ *  address <bits>
+ *  prefetch <level> <next-line|stride|stream> [degree]
+ *
+ * Levels are listed from L1 outwards. All latencies are totals as seen by
+ * the pipeline, i.e., the latency of a reference which hits in that level.
+ *
+ * Author: Aravindhan Dhanasekaran <adhanas@ncsu.edu>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "dis.h"
+#include "dis-utils.h"
+#include "dis-cache.h"
+#include "dis-cache-utils.h"
+#include "dis-cache-config.h"
+#include "dis-cache-prefetch.h"
+
+
+/***************************************************************************
+ * Name:    cache_config_init
+ *
+ * Desc:    Resets the configuration to an empty hierarchy with the default
+ *          victim cache and memory latencies and 64-bit addresses.
+ *
+ * Params:
+ *  config  ptr to the configuration
+ *
+ * Returns: Nothing
+ **************************************************************************/
+static void
+cache_config_init(cache_config_t *config)
+{
+    memset(config, 0, sizeof(*config));
+    config->victim_hit_latency = CACHE_VC_HIT_LATENCY;
+    config->mem_latency = CACHE_TOTAL_MISS_LATENCY;
+    config->addr_bits = CACHE_ADDR_DEFAULT_BITS;
+    return;
+}
+
+
+/***************************************************************************
+ * Name:    cache_config_from_args
+ *
+ * Desc:    Builds the L1 (+ VC) + L2 configuration from the command line.
+ *          A zero block size disables the caches and a zero L2 size
+ *          disables L2.
+ *
+ * Params:
+ *  config      ptr to the configuration to be filled in
+ *  victim_size size of the L1 victim cache; 0 disables it
+ *  input       ptr to input list of the form:
+ *              <block-size> <l1-size> <l1-assoc> <l2-size> <l2-assoc>
+ *              <trace-file>
+ *
+ * Returns: Nothing
+ **************************************************************************/
+void
+cache_config_from_args(cache_config_t *config, uint32_t victim_size,
+        char **input)
+{
+    uint8_t                 arg_iter = 0;
+    uint32_t                blk_size = 0;
+    cache_level_config_t    *level = NULL;
+
+    if ((!config) || (!input)) {
+        cache_assert(0);
+        goto exit;
+    }
+
+    cache_config_init(config);
+
+    blk_size = atoi(input[arg_iter++]);
+    if (!blk_size)
+        goto exit;
+
+    level = &config->levels[config->num_levels++];
+    level->blk_size = blk_size;
+    level->size = atoi(input[arg_iter++]);
+    level->set_assoc = atoi(input[arg_iter++]);
+    level->repl_plcy = CACHE_REPL_PLCY_LRU;
+    level->write_plcy = CACHE_WRITE_PLCY_WBWA;
+    level->hit_latency = CACHE_L1_HIT_LATENCY;
+
+    level = &config->levels[config->num_levels];
+    level->blk_size = blk_size;
+    level->size = atoi(input[arg_iter++]);
+    level->set_assoc = atoi(input[arg_iter++]);
+    level->repl_plcy = CACHE_REPL_PLCY_LRU;
+    level->write_plcy = CACHE_WRITE_PLCY_WBWA;
+    level->hit_latency = CACHE_L2_HIT_LATENCY;
+    if (level->size)
+        config->num_levels += 1;
+
+    config->victim_size = victim_size;
+    config->trace_file = input[arg_iter++];
+
+exit:
+    return;
+}
+
+
+/***************************************************************************
+ * Name:    cache_config_parse_policies
+ *
+ * Desc:    Maps the replacement and write policy keywords from the
+ *          configuration file to their values.
+ *
+ * Params:
+ *  repl    replacement policy keyword, lru or lfu
+ *  write   write policy keyword, wbwa or wtna
+ *  level   ptr to the level configuration to store the policies
+ *
+ * Returns: boolean
+ *  TRUE if both the keywords are known
+ *  FALSE otherwise
+ **************************************************************************/
+static boolean
+cache_config_parse_policies(const char *repl, const char *write,
+        cache_level_config_t *level)
+{
+    if (!strcmp(repl, "lru"))
+        level->repl_plcy = CACHE_REPL_PLCY_LRU;
+    else if (!strcmp(repl, "lfu"))
+        level->repl_plcy = CACHE_REPL_PLCY_LFU;
+    else
+        return FALSE;
+
+    if (!strcmp(write, "wbwa"))
+        level->write_plcy = CACHE_WRITE_PLCY_WBWA;
+    else if (!strcmp(write, "wtna"))
+        level->write_plcy = CACHE_WRITE_PLCY_WTNA;
+    else
+        return FALSE;
+
+    return TRUE;
+}
+
+
+/***************************************************************************
+ * Name:    cache_config_set_prefetch
+ *
+ * Desc:    Attaches a prefetcher to the given cache level. The level and the
+ *          degree are checked later by cache_config_validate.
+ *
+ * Params:
+ *  config  ptr to the configuration
+ *  level   cache level, starting at 1 for L1
+ *  name    prefetcher name, next-line, stride or stream
+ *  degree  prefetch degree; 0 picks the default
+ *
+ * Returns: boolean
+ *  TRUE if the prefetcher name is known and the level is in range
+ *  FALSE otherwise
+ **************************************************************************/
+boolean
+cache_config_set_prefetch(cache_config_t *config, uint32_t level,
+        const char *name, uint32_t degree)
+{
+    uint8_t type = CACHE_PF_NONE;
+
+    if ((!config) || (!name)) {
+        cache_assert(0);
+        return FALSE;
+    }
+
+    type = cache_prefetch_get_type(name);
+    if ((CACHE_PF_NONE == type) || (!level) || (level > CACHE_MAX_LEVELS)) {
+        dprint("ERROR: Bad prefetcher %s for L%u.\n", name, level);
+        return FALSE;
+    }
+
+    config->levels[level - 1].pf_type = type;
+    config->levels[level - 1].pf_degree =
+        (degree ? degree : CACHE_PF_DEFAULT_DEGREE);
+    return TRUE;
+}
+
+
+/***************************************************************************
+ * Name:    cache_config_parse_file
+ *
+ * Desc:    Builds the cache hierarchy configuration from the given
+ *          configuration file. See the top of this file for the format.
+ *
+ * Params:
+ *  config  ptr to the configuration to be filled in
+ *  path    configuration file path
+ *
+ * Returns: boolean
+ *  TRUE if the file was parsed successfully
+ *  FALSE otherwise
+ **************************************************************************/
+boolean
+cache_config_parse_file(cache_config_t *config, const char *path)
+{
+    FILE                    *fp = NULL;
+    char                    *comment = NULL;
+    char                    buf[CACHE_CONFIG_LINE_LEN];
+    char                    key[CACHE_CONFIG_LINE_LEN];
+    char                    repl[CACHE_CONFIG_LINE_LEN];
+    char                    write[CACHE_CONFIG_LINE_LEN];
+    char                    extra[CACHE_CONFIG_LINE_LEN];
+    uint32_t                line_num = 0;
+    uint32_t                size = 0;
+    uint32_t                assoc = 0;
+    uint32_t                blk_size = 0;
+    uint32_t                latency = 0;
+    int                     num_args = 0;
+    cache_level_config_t    *level = NULL;
+
+    if ((!config) || (!path)) {
+        cache_assert(0);
+        goto error_exit;
+    }
+
+    cache_config_init(config);
+
+    fp = fopen(path, "r");
+    if (!fp) {
+        dprint("ERROR: Unable to open cache config file %s.\n", path);
+        goto error_exit;
+    }
+
+    while (fgets(buf, sizeof(buf), fp)) {
+        line_num += 1;
+        if ((comment = strchr(buf, '#')))
+            *comment = '\0';
+
+        if (1 != sscanf(buf, "%255s", key))
+            continue;
+
+        if (!strcmp(key, "level")) {
+            if (config->num_levels >= CACHE_MAX_LEVELS) {
+                dprint("ERROR: %s:%u: too many cache levels, max %u.\n",
+                        path, line_num, CACHE_MAX_LEVELS);
+                goto parse_error;
+            }
+
+            if (6 != sscanf(buf, "%*s %u %u %u %255s %255s %u %255s",
+                        &size, &assoc, &blk_size, repl, write, &latency,
+                        extra))
+                goto syntax_error;
+
+            level = &config->levels[config->num_levels];
+            level->size = size;
+            level->set_assoc = assoc;
+            level->blk_size = blk_size;
+            level->hit_latency = latency;
+            if (!cache_config_parse_policies(repl, write, level))
+                goto syntax_error;
+
+            config->num_levels += 1;
+        } else if (!strcmp(key, "victim")) {
+            if (2 != sscanf(buf, "%*s %u %u %255s", &size, &latency, extra))
+                goto syntax_error;
+
+            config->victim_size = size;
+            config->victim_hit_latency = latency;
+        } else if (!strcmp(key, "memory")) {
+            if (1 != sscanf(buf, "%*s %u %255s", &latency, extra))
+                goto syntax_error;
+
+            config->mem_latency = latency;
+        } else if (!strcmp(key, "address")) {
+            if (1 != sscanf(buf, "%*s %u %255s", &size, extra))
+                goto syntax_error;
+
+            /* Range is checked by cache_config_validate. */
+            config->addr_bits = ((size > UINT8_MAX) ? UINT8_MAX : size);
+        } else if (!strcmp(key, "prefetch")) {
+            /* Degree is optional; size holds the level here. */
+            latency = 0;
+            num_args = sscanf(buf, "%*s %u %255s %u %255s", &size, repl,
+                    &latency, extra);
+            if ((2 != num_args) && (3 != num_args))
+                goto syntax_error;
+
+            if (!cache_config_set_prefetch(config, size, repl, latency))
+                goto parse_error;
+        } else {
+            goto syntax_error;
+        }
+    }
+
+    if (!config->num_levels) {
+        dprint("ERROR: %s: no cache levels given.\n", path);
+        goto parse_error;
+    }
+
+    fclose(fp);
+    return TRUE;
+
+syntax_error:
+    dprint("ERROR: %s:%u: bad cache config line.\n", path, line_num);
+
+parse_error:
+    fclose(fp);
+
+error_exit:
+    return FALSE;
+}
+
+
+/***************************************************************************
+ * Name:    cache_config_validate
+ *
+ * Desc:    Validates the cache hierarchy configuration. Checks that all the
+ *          sizes are powers of 2 and consistent with each other, and that
+ *          the victim cache holds a whole # of L1 blocks.
+ *
+ * Params:
+ *  config  ptr to the configuration
+ *
+ * Returns: boolean
+ *  TRUE if the configuration is good
+ *  FALSE otherwise
+ **************************************************************************/
+boolean
+cache_config_validate(const cache_config_t *config)
+{
+    uint32_t                    iter = 0;
+    uint32_t                    num_sets = 0;
+    const cache_level_config_t  *level = NULL;
+
+    if (!config) {
+        cache_assert(0);
+        return FALSE;
+    }
+
+    if ((config->addr_bits < CACHE_ADDR_MIN_BITS) ||
+            (config->addr_bits > CACHE_ADDR_MAX_BITS)) {
+        dprint("ERROR: Address bits %u not in [%u, %u].\n",
+                config->addr_bits, CACHE_ADDR_MIN_BITS,
+                CACHE_ADDR_MAX_BITS);
+        return FALSE;
+    }
+
+    for (iter = 0; iter < config->num_levels; ++iter) {
+        level = &config->levels[iter];
+
+        if ((!level->size) || (!level->set_assoc) ||
+                (!util_is_power_of_2(level->blk_size)) ||
+                (level->size % (level->set_assoc * level->blk_size))) {
+            dprint("ERROR: L%u: size %u, assoc %u and block size %u don't "
+                    "make a cache.\n", (iter + 1), level->size,
+                    level->set_assoc, level->blk_size);
+            return FALSE;
+        }
+
+        num_sets = (level->size / (level->set_assoc * level->blk_size));
+        if (!util_is_power_of_2(num_sets)) {
+            dprint("ERROR: L%u: # of sets %u is not a power of 2.\n",
+                    (iter + 1), num_sets);
+            return FALSE;
+        }
+
+        if ((util_log_base_2(num_sets) + util_log_base_2(level->blk_size)) >=
+                config->addr_bits) {
+            dprint("ERROR: L%u: no tag bits left in a %u-bit address.\n",
+                    (iter + 1), config->addr_bits);
+            return FALSE;
+        }
+    }
+
+    for (iter = 0; iter < CACHE_MAX_LEVELS; ++iter) {
+        level = &config->levels[iter];
+        if (CACHE_PF_NONE == level->pf_type)
+            continue;
+
+        if (iter >= config->num_levels) {
+            dprint("ERROR: Prefetcher given for L%u, but there are only %u "
+                    "levels.\n", (iter + 1), config->num_levels);
+            return FALSE;
+        }
+        if (level->pf_degree > CACHE_PF_MAX_DEGREE) {
+            dprint("ERROR: L%u: prefetch degree %u is more than %u.\n",
+                    (iter + 1), level->pf_degree, CACHE_PF_MAX_DEGREE);
+            return FALSE;
+        }
+    }
+
+    /* VC is fully associative; it has to hold a whole # of L1 blocks. */
+    if (config->victim_size && config->num_levels &&
+            (config->victim_size % config->levels[0].blk_size)) {
+        dprint("ERROR: Victim cache size %u is not a multiple of block "
+                "size %u.\n", config->victim_size, config->levels[0].blk_size);
+        return FALSE;
+    }
+
+    return TRUE;
+}
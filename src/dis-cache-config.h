@@ -0,0 +1,32 @@
+/*
+ * ECE 521 - Computer Design Techniques, Fall 2014
+ * Project 3 - Dynamic Instruction Scheduler
+ *
+ * This module contains all required function declarations for building the
+ * cache hierarchy configuration, either from the command line or from a
+ * configuration file.
+ *
+ * Author: Aravindhan Dhanasekaran <adhanas@ncsu.edu>
+ */
+
+#ifndef DIS_CACHE_CONFIG_H_
+#define DIS_CACHE_CONFIG_H_
+
+#include "dis-cache.h"
+
+/* Constants */
+#define CACHE_CONFIG_LINE_LEN   256
+
+/* Function declarations */
+void
+cache_config_from_args(cache_config_t *config, uint32_t victim_size,
+        char **input);
+boolean
+cache_config_parse_file(cache_config_t *config, const char *path);
+boolean
+cache_config_set_prefetch(cache_config_t *config, uint32_t level,
+        const char *name, uint32_t degree);
+boolean
+cache_config_validate(const cache_config_t *config);
+
+#endif /* DIS_CACHE_CONFIG_H_ */
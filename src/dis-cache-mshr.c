@@ -0,0 +1,472 @@
+/*
+ * ECE 521 - Computer Design Techniques, Fall 2014
+ * Project 3 - Dynamic Instruction Scheduler
+ *
+ * This module implements the miss status holding registers (MSHRs) which
+ * turn the blocking L1 data cache into a non-blocking one. Every primary
+ * miss holds an MSHR till its block fill is done, later misses to the same
+ * block merge into that MSHR and fills share a bandwidth limited fill bus.
+ *
+ * Author: Aravindhan Dhanasekaran <adhanas@ncsu.edu>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "dis.h"
+#include "dis-utils.h"
+#include "dis-cache.h"
+#include "dis-cache-utils.h"
+#include "dis-cache-mshr.h"
+
+#ifdef dprint_info
+#undef dprint_info
+#define dprint_info(str, ...)
+#endif
+
+
+/***************************************************************************
+ * Name:    cache_mshr_init
+ *
+ * Desc:    Allocates and attaches an MSHR file to the given cache. Free
+ *          MSHRs are kept on a free list, outstanding ones in a hash on the
+ *          block address and in a heap on the fill done cycle, so that no
+ *          reference has to scan the whole file.
+ *
+ * Params:
+ *  cache           ptr to the cache which is to be made non-blocking
+ *  num_entries     # of MSHRs
+ *  fill_interval   # of cycles the fill bus is busy per block; 0 means
+ *                  unlimited fill bandwidth
+ *
+ * Returns: Nothing
+ **************************************************************************/
+void
+cache_mshr_init(cache_generic_t *cache, uint32_t num_entries,
+        uint32_t fill_interval)
+{
+    uint32_t        i = 0;
+    cache_mshr_t    *mshr = NULL;
+
+    if ((!cache) || (!num_entries)) {
+        cache_assert(0);
+        goto exit;
+    }
+
+    mshr = (cache_mshr_t *) calloc(1, sizeof(*mshr));
+    if (mshr) {
+        /* At least twice as many buckets as MSHRs; chains stay short. */
+        mshr->hash_bits = (util_log_base_2(num_entries) + 2);
+        mshr->entries = (cache_mshr_entry_t *)
+            calloc(num_entries, sizeof(*mshr->entries));
+        mshr->buckets = (uint32_t *)
+            calloc((1U << mshr->hash_bits), sizeof(*mshr->buckets));
+        mshr->heap = (uint32_t *) calloc(num_entries, sizeof(*mshr->heap));
+    }
+
+    if ((!mshr) || (!mshr->entries) || (!mshr->buckets) || (!mshr->heap)) {
+        dprint("Error: Unable to allocate memory for cache %s MSHRs.\n",
+                CACHE_GET_NAME(cache));
+        cache_assert(0);
+        goto fatal_exit;
+    }
+
+    /* All the MSHRs start out on the free list, in order. */
+    for (i = 0; i < num_entries; ++i)
+        mshr->entries[i].next = ((i + 1) < num_entries) ? (i + 2) : 0;
+    mshr->free_head = 1;
+
+    mshr->num_entries = num_entries;
+    mshr->fill_interval = fill_interval;
+    cache->mshr = mshr;
+
+    dprint_info("%s, %u MSHRs init successful\n",
+            CACHE_GET_NAME(cache), num_entries);
+
+exit:
+    return;
+
+fatal_exit:
+    /* Fatal exit. Quit the program. */
+    exit(-1);
+}
+
+
+/***************************************************************************
+ * Name:    cache_mshr_cleanup
+ *
+ * Desc:    Frees the MSHR file of the given cache.
+ *
+ * Params:
+ *  cache   ptr to the cache owning the MSHRs
+ *
+ * Returns: Nothing
+ **************************************************************************/
+void
+cache_mshr_cleanup(cache_generic_t *cache)
+{
+    if ((!cache) || (!cache->mshr)) {
+        cache_assert(0);
+        goto exit;
+    }
+
+    free(cache->mshr->entries);
+    free(cache->mshr->buckets);
+    free(cache->mshr->heap);
+    free(cache->mshr);
+    cache->mshr = NULL;
+
+exit:
+    return;
+}
+
+
+/***************************************************************************
+ * Name:    cache_mshr_hash
+ *
+ * Desc:    Hashes a block address to a bucket. Fibonacci hashing, as for
+ *          the tag index.
+ *
+ * Params:
+ *  mshr        ptr to the MSHR file
+ *  blk_addr    block aligned address
+ *
+ * Returns: uint32_t
+ *  bucket of the block address
+ **************************************************************************/
+static inline uint32_t
+cache_mshr_hash(cache_mshr_t *mshr, mem_addr_t blk_addr)
+{
+    return (uint32_t) ((((uint64_t) blk_addr) * 0x9E3779B97F4A7C15ULL) >>
+            (64 - mshr->hash_bits));
+}
+
+
+/***************************************************************************
+ * Name:    cache_mshr_heap_less
+ *
+ * Desc:    Orders two MSHRs in the heap by their fill done cycle.
+ *
+ * Params:
+ *  mshr    ptr to the MSHR file
+ *  a       heap position of the first MSHR
+ *  b       heap position of the second MSHR
+ *
+ * Returns: boolean
+ *  TRUE if the first MSHR's fill is done before the second's
+ *  FALSE otherwise
+ **************************************************************************/
+static inline boolean
+cache_mshr_heap_less(cache_mshr_t *mshr, uint32_t a, uint32_t b)
+{
+    return (mshr->entries[mshr->heap[a]].ready_cycle <
+            mshr->entries[mshr->heap[b]].ready_cycle);
+}
+
+
+/***************************************************************************
+ * Name:    cache_mshr_heap_swap
+ *
+ * Desc:    Swaps two positions of the heap.
+ *
+ * Params:
+ *  mshr    ptr to the MSHR file
+ *  a       first heap position
+ *  b       second heap position
+ *
+ * Returns: Nothing
+ **************************************************************************/
+static inline void
+cache_mshr_heap_swap(cache_mshr_t *mshr, uint32_t a, uint32_t b)
+{
+    uint32_t tmp = mshr->heap[a];
+
+    mshr->heap[a] = mshr->heap[b];
+    mshr->heap[b] = tmp;
+    return;
+}
+
+
+/***************************************************************************
+ * Name:    cache_mshr_heap_push
+ *
+ * Desc:    Adds an outstanding MSHR to the heap. The caller has already
+ *          counted it in num_used.
+ *
+ * Params:
+ *  mshr    ptr to the MSHR file
+ *  id      ID of the MSHR
+ *
+ * Returns: Nothing
+ **************************************************************************/
+static inline void
+cache_mshr_heap_push(cache_mshr_t *mshr, uint32_t id)
+{
+    uint32_t pos = (mshr->num_used - 1);
+    uint32_t parent = 0;
+
+    mshr->heap[pos] = id;
+    while (pos) {
+        parent = ((pos - 1) >> 1);
+        if (!cache_mshr_heap_less(mshr, pos, parent))
+            break;
+        cache_mshr_heap_swap(mshr, pos, parent);
+        pos = parent;
+    }
+    return;
+}
+
+
+/***************************************************************************
+ * Name:    cache_mshr_heap_pop
+ *
+ * Desc:    Removes the MSHR whose fill is done first from the heap, and
+ *          drops it from num_used.
+ *
+ * Params:
+ *  mshr    ptr to the MSHR file
+ *
+ * Returns: uint32_t
+ *  ID of the removed MSHR
+ **************************************************************************/
+static inline uint32_t
+cache_mshr_heap_pop(cache_mshr_t *mshr)
+{
+    uint32_t id = mshr->heap[0];
+    uint32_t pos = 0;
+    uint32_t child = 0;
+
+    mshr->num_used -= 1;
+    mshr->heap[0] = mshr->heap[mshr->num_used];
+    while ((child = ((pos << 1) + 1)) < mshr->num_used) {
+        if (((child + 1) < mshr->num_used) &&
+                cache_mshr_heap_less(mshr, (child + 1), child))
+            child += 1;
+        if (!cache_mshr_heap_less(mshr, child, pos))
+            break;
+        cache_mshr_heap_swap(mshr, pos, child);
+        pos = child;
+    }
+    return id;
+}
+
+
+/***************************************************************************
+ * Name:    cache_mshr_retire_entries
+ *
+ * Desc:    Frees all MSHRs whose block fill is done by the given cycle:
+ *          pops them off the heap, unlinks them from their hash bucket and
+ *          puts them back on the free list.
+ *
+ * Params:
+ *  mshr    ptr to the MSHR file
+ *  now     current cycle
+ *
+ * Returns: Nothing
+ **************************************************************************/
+static inline void
+cache_mshr_retire_entries(cache_mshr_t *mshr, uint32_t now)
+{
+    uint32_t            id = 0;
+    uint32_t            *link = NULL;
+    cache_mshr_entry_t  *entry = NULL;
+
+    while (mshr->num_used &&
+            (mshr->entries[mshr->heap[0]].ready_cycle <= now)) {
+        id = cache_mshr_heap_pop(mshr);
+        entry = &mshr->entries[id];
+
+        link = &mshr->buckets[cache_mshr_hash(mshr, entry->blk_addr)];
+        while (*link != (id + 1))
+            link = &mshr->entries[*link - 1].next;
+        *link = entry->next;
+
+        entry->valid = 0;
+        entry->next = mshr->free_head;
+        mshr->free_head = (id + 1);
+    }
+    return;
+}
+
+
+/***************************************************************************
+ * Name:    cache_mshr_lookup
+ *
+ * Desc:    Looks for an outstanding MSHR for the given block address.
+ *
+ * Params:
+ *  mshr        ptr to the MSHR file
+ *  blk_addr    block aligned address
+ *
+ * Returns: cache_mshr_entry_t *
+ *  ptr to the matching MSHR, if any
+ *  NULL otherwise
+ **************************************************************************/
+static inline cache_mshr_entry_t *
+cache_mshr_lookup(cache_mshr_t *mshr, mem_addr_t blk_addr)
+{
+    uint32_t            id = 0;
+    cache_mshr_entry_t  *entry = NULL;
+
+    for (id = mshr->buckets[cache_mshr_hash(mshr, blk_addr)]; id;
+            id = entry->next) {
+        entry = &mshr->entries[id - 1];
+        if (entry->blk_addr == blk_addr)
+            return entry;
+    }
+    return NULL;
+}
+
+
+/***************************************************************************
+ * Name:    cache_mshr_alloc_entry
+ *
+ * Desc:    Takes an MSHR off the free list for the given block and adds it
+ *          to the hash and the heap.
+ *
+ * Params:
+ *  mshr        ptr to the MSHR file
+ *  blk_addr    block aligned address
+ *  ready_cycle cycle the block fill is done
+ *
+ * Returns: cache_mshr_entry_t *
+ *  ptr to the allocated MSHR, if any
+ *  NULL if all MSHRs are in use
+ **************************************************************************/
+static inline cache_mshr_entry_t *
+cache_mshr_alloc_entry(cache_mshr_t *mshr, mem_addr_t blk_addr,
+        uint32_t ready_cycle)
+{
+    uint32_t            id = 0;
+    uint32_t            bucket = 0;
+    cache_mshr_entry_t  *entry = NULL;
+
+    if (!mshr->free_head)
+        return NULL;
+
+    id = (mshr->free_head - 1);
+    entry = &mshr->entries[id];
+    mshr->free_head = entry->next;
+
+    bucket = cache_mshr_hash(mshr, blk_addr);
+    entry->valid = 1;
+    entry->blk_addr = blk_addr;
+    entry->ready_cycle = ready_cycle;
+    entry->num_merged = 0;
+    entry->next = mshr->buckets[bucket];
+    mshr->buckets[bucket] = (id + 1);
+
+    mshr->num_used += 1;
+    cache_mshr_heap_push(mshr, id);
+    return entry;
+}
+
+
+/***************************************************************************
+ * Name:    cache_mshr_handle_request
+ *
+ * Desc:    Non-blocking entry point for a memory reference. Does one of the
+ *          following:
+ *          1. Secondary miss: the block already has an outstanding fill.
+ *             Merge with that MSHR; the reference is done when the fill is.
+ *             The primary miss has already put the block in the tagstore,
+ *             but the merge is still counted as a miss, not a hit.
+ *          2. Hit, or a write miss in a WTNA cache: no MSHR required,
+ *             the reference is handled as in a blocking cache.
+ *          3. Primary miss: allocate an MSHR and schedule the block fill
+ *             on the fill bus. If all MSHRs are busy, nothing is done and
+ *             the reference has to be retried in a later cycle.
+ *
+ *          Tagstore state and statistics are updated thru the regular
+ *          cache_handle_line path in all the cases.
+ *
+ * Params:
+ *  cache   ptr to the (L1) cache owning the MSHRs
+ *  mref    ptr to incoming memory reference
+ *  line    ptr to the decoded cache line of the reference
+ *  latency ptr to store the latency of the reference, from this cycle
+ *
+ * Returns: boolean
+ *  TRUE if the reference was accepted
+ *  FALSE if it has to be retried due to lack of MSHRs
+ **************************************************************************/
+boolean
+cache_mshr_handle_request(cache_generic_t *cache, mem_ref_t *mref,
+        cache_line_t *line, uint32_t *latency)
+{
+    int32_t             block_id = 0;
+    uint32_t            now = 0;
+    mem_addr_t          blk_addr = 0;
+    uint32_t            ready_cycle = 0;
+    cache_mshr_t        *mshr = NULL;
+    cache_mshr_entry_t  *entry = NULL;
+
+    if ((!cache) || (!cache->mshr) || (!mref) || (!line) || (!latency)) {
+        cache_assert(0);
+        goto error_exit;
+    }
+
+    mshr = cache->mshr;
+    now = g_cache_cycle;
+    blk_addr = (mref->ref_addr >> cache->tagstore->num_offset_bits);
+    cache_mshr_retire_entries(mshr, now);
+    block_id = cache_does_tag_match(cache->tagstore, line);
+
+    /* Secondary miss; piggyback on the outstanding fill. */
+    entry = cache_mshr_lookup(mshr, blk_addr);
+    if (entry) {
+        cache_handle_line(cache, mref, line, block_id, TRUE, latency);
+        if (*latency < (entry->ready_cycle - now))
+            *latency = (entry->ready_cycle - now);
+
+        entry->num_merged += 1;
+        mshr->num_secondary += 1;
+        dprint_info("%s, blk 0x%" PRIx64 " merged, ready at %u, "
+                "cycle %u\n",
+                CACHE_GET_NAME(cache), blk_addr, entry->ready_cycle, now);
+        return TRUE;
+    }
+
+    /* Hits and WTNA write misses, which don't allocate, need no MSHR. */
+    if ((CACHE_RV_ERR != block_id) ||
+            ((!IS_MEM_REF_READ(mref)) &&
+             (CACHE_WRITE_PLCY_WTNA == CACHE_GET_WRITE_POLICY(cache)))) {
+        cache_handle_line(cache, mref, line, block_id, FALSE, latency);
+        return TRUE;
+    }
+
+    /* Primary miss; stall if we are out of MSHRs. */
+    if (!mshr->free_head) {
+        mshr->num_full_stalls += 1;
+        dprint_info("%s, blk 0x%" PRIx64 " stalled, no free MSHR, "
+                "cycle %u\n",
+                CACHE_GET_NAME(cache), blk_addr, now);
+        return FALSE;
+    }
+
+    cache_handle_line(cache, mref, line, block_id, FALSE, latency);
+
+    /* Fills are serialized on the fill bus, fill_interval cycles apart. */
+    ready_cycle = (now + *latency);
+    if (mshr->fill_interval) {
+        if (ready_cycle < mshr->next_fill_cycle)
+            ready_cycle = mshr->next_fill_cycle;
+        mshr->next_fill_cycle = (ready_cycle + mshr->fill_interval);
+    }
+    *latency = (ready_cycle - now);
+    cache_mshr_alloc_entry(mshr, blk_addr, ready_cycle);
+
+    mshr->num_primary += 1;
+    if (mshr->num_used > mshr->max_used)
+        mshr->max_used = mshr->num_used;
+
+    dprint_info("%s, blk 0x%" PRIx64 " primary miss, ready at %u, "
+            "cycle %u\n",
+            CACHE_GET_NAME(cache), blk_addr, ready_cycle, now);
+    return TRUE;
+
+error_exit:
+    return FALSE;
+}
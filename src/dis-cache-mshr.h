@@ -0,0 +1,26 @@
+/*
+ * ECE 521 - Computer Design Techniques, Fall 2014
+ * Project 3 - Dynamic Instruction Scheduler
+ *
+ * This module contains all required function declrations for the miss
+ * status holding registers (MSHRs) of the non-blocking data cache.
+ *
+ * Author: Aravindhan Dhanasekaran <adhanas@ncsu.edu>
+ */
+
+#ifndef DIS_CACHE_MSHR_H_
+#define DIS_CACHE_MSHR_H_
+
+#include "dis-cache.h"
+
+/* Function declarations */
+void
+cache_mshr_init(cache_generic_t *cache, uint32_t num_entries,
+        uint32_t fill_interval);
+void
+cache_mshr_cleanup(cache_generic_t *cache);
+boolean
+cache_mshr_handle_request(cache_generic_t *cache, mem_ref_t *mref,
+        cache_line_t *line, uint32_t *latency);
+
+#endif /* DIS_CACHE_MSHR_H_ */
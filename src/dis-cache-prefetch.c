@@ -0,0 +1,477 @@
+/*
+ * ECE 521 - Computer Design Techniques, Fall 2014
+ * Project 3 - Dynamic Instruction Scheduler
+ *
+ * This module implements the hardware prefetchers. A prefetcher can be
+ * attached to any level of the cache hierarchy and is one of:
+ *  1. Next-line: on a demand miss, or the first use of a prefetched block,
+ *     prefetch the next 'degree' blocks into the cache.
+ *  2. Stride: a PC indexed table tracks the last address and stride of
+ *     each load; once a stride repeats, prefetch 'degree' strides ahead
+ *     into the cache.
+ *  3. Stream buffer: on a demand miss, a FIFO of the next 'degree' blocks
+ *     is fetched on the side. A later miss which finds its block at the
+ *     head of a stream buffer takes it from there instead of the next
+ *     level, and the buffer fetches one more block.
+ *
+ * Prefetches read their blocks from the next (non-victim) level like any
+ * other miss, so the traffic shows up there. Each prefetched block carries
+ * the cycle its fill is done, which is used to charge late prefetches.
+ *
+ * Author: Aravindhan Dhanasekaran <adhanas@ncsu.edu>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "dis.h"
+#include "dis-utils.h"
+#include "dis-cache.h"
+#include "dis-cache-utils.h"
+#include "dis-cache-prefetch.h"
+
+#ifdef dprint_info
+#undef dprint_info
+#define dprint_info(str, ...)
+#endif
+
+/* Prefetcher names, indexed by CACHE_PF_* */
+static const char *g_pf_names[] = {
+    "none",
+    "next-line",
+    "stride",
+    "stream"
+};
+
+
+/***************************************************************************
+ * Name:    cache_prefetch_init
+ *
+ * Desc:    Allocates and attaches a prefetcher to the given cache.
+ *
+ * Params:
+ *  cache   ptr to the cache
+ *  type    prefetcher type, CACHE_PF_*
+ *  degree  # of blocks prefetched per trigger (stream buffer depth)
+ *
+ * Returns: Nothing
+ **************************************************************************/
+void
+cache_prefetch_init(cache_generic_t *cache, uint8_t type, uint8_t degree)
+{
+    cache_prefetcher_t *pf = NULL;
+
+    if ((!cache) || (CACHE_PF_NONE == type) || (type > CACHE_PF_STREAM) ||
+            (!degree) || (degree > CACHE_PF_MAX_DEGREE)) {
+        cache_assert(0);
+        goto exit;
+    }
+
+    pf = (cache_prefetcher_t *) calloc(1, sizeof(*pf));
+    if (!pf) {
+        dprint("Error: Unable to allocate memory for cache %s prefetcher.\n",
+                CACHE_GET_NAME(cache));
+        cache_assert(0);
+        goto fatal_exit;
+    }
+
+    pf->type = type;
+    pf->degree = degree;
+    cache->prefetcher = pf;
+
+    dprint_info("%s, %s prefetcher of degree %u init successful\n",
+            CACHE_GET_NAME(cache), g_pf_names[type], degree);
+
+exit:
+    return;
+
+fatal_exit:
+    /* Fatal exit. Quit the program. */
+    exit(-1);
+}
+
+
+/***************************************************************************
+ * Name:    cache_prefetch_cleanup
+ *
+ * Desc:    Frees the prefetcher of the given cache.
+ *
+ * Params:
+ *  cache   ptr to the cache owning the prefetcher
+ *
+ * Returns: Nothing
+ **************************************************************************/
+void
+cache_prefetch_cleanup(cache_generic_t *cache)
+{
+    if ((!cache) || (!cache->prefetcher)) {
+        cache_assert(0);
+        goto exit;
+    }
+
+    free(cache->prefetcher);
+    cache->prefetcher = NULL;
+
+exit:
+    return;
+}
+
+
+/***************************************************************************
+ * Name:    cache_prefetch_fetch
+ *
+ * Desc:    Reads a block for a prefetch from the next level below the
+ *          given cache. The victim cache is skipped; it only holds L1
+ *          evictions.
+ *
+ * Params:
+ *  cache       ptr to the cache the prefetch is for
+ *  blk_addr    block address to prefetch
+ *
+ * Returns: uint32_t
+ *  latency of the fetch, from this cycle
+ **************************************************************************/
+static uint32_t
+cache_prefetch_fetch(cache_generic_t *cache, mem_addr_t blk_addr)
+{
+    uint32_t        latency = 0;
+    mem_ref_t       read_ref;
+    cache_generic_t *next_cache = NULL;
+
+    next_cache = cache->next_cache;
+    if (next_cache && CACHE_IS_VC(next_cache))
+        next_cache = next_cache->next_cache;
+
+    if (next_cache) {
+        memset(&read_ref, 0, sizeof(read_ref));
+        read_ref.ref_type = MEM_REF_TYPE_READ;
+        read_ref.ref_src = MEM_REF_SRC_PREFETCH;
+        read_ref.ref_addr = (blk_addr << cache->tagstore->num_offset_bits);
+        cache_evict_and_add_tag(next_cache, &read_ref, &latency);
+    } else {
+        latency = g_cache_mem_latency;
+    }
+
+    cache->stats.num_pf_issued += 1;
+    cache->stats.num_blk_mem_traffic += 1;
+    return latency;
+}
+
+
+/***************************************************************************
+ * Name:    cache_prefetch_fill
+ *
+ * Desc:    Prefetches the given block into the cache, unless it is already
+ *          there. The block goes in as the MRU block of its set, marked as
+ *          prefetched till a demand reference uses it.
+ *
+ * Params:
+ *  cache       ptr to the cache
+ *  blk_addr    block address to prefetch
+ *
+ * Returns: Nothing
+ **************************************************************************/
+static void
+cache_prefetch_fill(cache_generic_t *cache, mem_addr_t blk_addr)
+{
+    int32_t             block_id = 0;
+    uint32_t            latency = 0;
+    mem_ref_t           pf_ref;
+    cache_line_t        line;
+    cache_tag_data_t    *tag_data = NULL;
+    cache_tagstore_t    *tagstore = NULL;
+
+    tagstore = cache->tagstore;
+    memset(&pf_ref, 0, sizeof(pf_ref));
+    pf_ref.ref_type = MEM_REF_TYPE_READ;
+    pf_ref.ref_src = MEM_REF_SRC_PREFETCH;
+    pf_ref.ref_addr = (blk_addr << tagstore->num_offset_bits);
+
+    /* Nothing to model for sets outside a set sample. */
+    if (!cache_util_is_sampled(tagstore, pf_ref.ref_addr))
+        return;
+
+    memset(&line, 0, sizeof(line));
+    cache_util_decode_mem_addr(tagstore, pf_ref.ref_addr, &line);
+    if (CACHE_RV_ERR != cache_does_tag_match(tagstore, &line)) {
+        cache->stats.num_pf_dropped += 1;
+        return;
+    }
+
+    block_id = cache_get_first_invalid_block(tagstore, &line);
+    if (CACHE_RV_ERR == block_id)
+        block_id = cache_evict_tag(cache, &pf_ref, &line);
+
+    latency = cache_prefetch_fetch(cache, blk_addr);
+
+    cache_tagstore_set_tag(tagstore, line.index, block_id, line.tag);
+    tag_data = &tagstore->tag_data[(line.index *
+            tagstore->num_blocks_per_set) + block_id];
+    cache_util_touch_block(tagstore, line.index, block_id,
+            util_get_next_age());
+    tag_data->ref_count = 1;
+    tag_data->dirty = 0;
+    tag_data->prefetched = 1;
+    tag_data->pf_ready_cycle = (g_cache_cycle + latency);
+
+    dprint_info("%s, prefetched blk 0x%" PRIx64 " into index %u, "
+            "block %d, ready %u\n",
+            CACHE_GET_NAME(cache), blk_addr, line.index, block_id,
+            tag_data->pf_ready_cycle);
+    return;
+}
+
+
+/***************************************************************************
+ * Name:    cache_prefetch_stride
+ *
+ * Desc:    Trains the PC indexed stride table with a demand reference and
+ *          prefetches ahead once the stride of the load repeats.
+ *
+ * Params:
+ *  cache   ptr to the cache
+ *  pf      ptr to the prefetcher
+ *  mref    ptr to the demand reference
+ *
+ * Returns: Nothing
+ **************************************************************************/
+static void
+cache_prefetch_stride(cache_generic_t *cache, cache_prefetcher_t *pf,
+        mem_ref_t *mref)
+{
+    int64_t                 stride = 0;
+    uint32_t                iter = 0;
+    mem_addr_t              blk_addr = 0;
+    mem_addr_t              last_blk_addr = 0;
+    uint32_t                offset_bits = 0;
+    cache_pf_stride_entry_t *entry = NULL;
+
+    /* Writes back and refs without a pc can't be tracked. */
+    if (!mref->ref_pc)
+        return;
+
+    entry = &pf->stride[(mref->ref_pc >> 2) % CACHE_PF_STRIDE_ENTRIES];
+    if ((!entry->valid) || (entry->pc != mref->ref_pc)) {
+        entry->valid = 1;
+        entry->pc = mref->ref_pc;
+        entry->last_addr = mref->ref_addr;
+        entry->stride = 0;
+        entry->confidence = 0;
+        return;
+    }
+
+    stride = (int64_t) (mref->ref_addr - entry->last_addr);
+    entry->last_addr = mref->ref_addr;
+    if (stride && (stride == entry->stride)) {
+        if (entry->confidence < 3)
+            entry->confidence += 1;
+    } else {
+        entry->stride = stride;
+        entry->confidence = 0;
+        return;
+    }
+
+    if (entry->confidence < 2)
+        return;
+
+    offset_bits = cache->tagstore->num_offset_bits;
+    last_blk_addr = (mref->ref_addr >> offset_bits);
+    for (iter = 1; iter <= pf->degree; ++iter) {
+        blk_addr = ((mref->ref_addr + (iter * stride)) >> offset_bits);
+        if (blk_addr == last_blk_addr)
+            continue;
+
+        cache_prefetch_fill(cache, blk_addr);
+        last_blk_addr = blk_addr;
+    }
+    return;
+}
+
+
+/***************************************************************************
+ * Name:    cache_prefetch_train
+ *
+ * Desc:    Lets the prefetcher of a cache see a demand reference to it, and
+ *          issue prefetches as per its type. Stream buffers are looked up
+ *          and trained in the miss path instead.
+ *
+ * Params:
+ *  cache   ptr to the cache
+ *  mref    ptr to the demand reference
+ *  trigger TRUE for a demand miss or the first use of a prefetched block
+ *
+ * Returns: Nothing
+ **************************************************************************/
+void
+cache_prefetch_train(cache_generic_t *cache, mem_ref_t *mref,
+        boolean trigger)
+{
+    uint32_t            iter = 0;
+    mem_addr_t          blk_addr = 0;
+    cache_prefetcher_t  *pf = NULL;
+
+    if ((!cache) || (!cache->prefetcher) || (!mref)) {
+        cache_assert(0);
+        goto exit;
+    }
+    pf = cache->prefetcher;
+
+    switch (pf->type) {
+    case CACHE_PF_NEXT_LINE:
+        if (!trigger)
+            break;
+
+        blk_addr = (mref->ref_addr >> cache->tagstore->num_offset_bits);
+        for (iter = 1; iter <= pf->degree; ++iter)
+            cache_prefetch_fill(cache, (blk_addr + iter));
+        break;
+
+    case CACHE_PF_STRIDE:
+        cache_prefetch_stride(cache, pf, mref);
+        break;
+
+    default:
+        break;
+    }
+
+exit:
+    return;
+}
+
+
+/***************************************************************************
+ * Name:    cache_prefetch_stream_lookup
+ *
+ * Desc:    Looks up the stream buffers of a cache on a demand miss. If the
+ *          block is at the head of a stream buffer, it is taken from there
+ *          and the buffer fetches one more block. Otherwise, the LRU stream
+ *          buffer is restarted with the blocks following the missed one.
+ *
+ * Params:
+ *  cache   ptr to the cache which missed
+ *  mref    ptr to the demand reference
+ *  latency ptr to store the latency, if the block was in a stream buffer
+ *
+ * Returns: boolean
+ *  TRUE if a stream buffer had the block; no need to go to the next level
+ *  FALSE otherwise, or if the cache has no stream buffers
+ **************************************************************************/
+boolean
+cache_prefetch_stream_lookup(cache_generic_t *cache, mem_ref_t *mref,
+        uint32_t *latency)
+{
+    uint32_t            iter = 0;
+    uint32_t            now = 0;
+    uint32_t            head = 0;
+    mem_addr_t          blk_addr = 0;
+    cache_pf_stream_t   *stream = NULL;
+    cache_pf_stream_t   *victim = NULL;
+    cache_prefetcher_t  *pf = NULL;
+
+    if ((!cache) || (!mref) || (!latency)) {
+        cache_assert(0);
+        return FALSE;
+    }
+
+    pf = cache->prefetcher;
+    if ((!pf) || (CACHE_PF_STREAM != pf->type))
+        return FALSE;
+
+    now = g_cache_cycle;
+    blk_addr = (mref->ref_addr >> cache->tagstore->num_offset_bits);
+
+    for (iter = 0; iter < CACHE_PF_NUM_STREAMS; ++iter) {
+        stream = &pf->streams[iter];
+        head = stream->head;
+        if ((!stream->valid) || (stream->blk_addr[head] != blk_addr))
+            continue;
+
+        /* Stream buffer hit; wait for the fill if it's still on its way. */
+        cache->stats.num_pf_useful += 1;
+        *latency = cache->hit_latency;
+        if (stream->ready_cycle[head] > now) {
+            cache->stats.num_pf_late += 1;
+            if ((stream->ready_cycle[head] - now) > *latency)
+                *latency = (stream->ready_cycle[head] - now);
+        }
+
+        /* Reuse the slot for the next block of the stream. */
+        stream->blk_addr[head] = stream->next_blk;
+        stream->ready_cycle[head] =
+            (now + cache_prefetch_fetch(cache, stream->next_blk));
+        stream->next_blk += 1;
+        stream->head = ((head + 1) % pf->degree);
+        stream->age = util_get_next_age();
+
+        dprint_info("%s, blk 0x%" PRIx64 " from stream buffer %u\n",
+                CACHE_GET_NAME(cache), blk_addr, iter);
+        return TRUE;
+    }
+
+    /* Missed all the stream buffers; restart the LRU one. */
+    for (iter = 0; iter < CACHE_PF_NUM_STREAMS; ++iter) {
+        stream = &pf->streams[iter];
+        if (!stream->valid) {
+            victim = stream;
+            break;
+        }
+        if ((!victim) || (stream->age < victim->age))
+            victim = stream;
+    }
+
+    for (iter = 0; iter < pf->degree; ++iter) {
+        victim->blk_addr[iter] = (blk_addr + 1 + iter);
+        victim->ready_cycle[iter] =
+            (now + cache_prefetch_fetch(cache, (blk_addr + 1 + iter)));
+    }
+    victim->head = 0;
+    victim->next_blk = (blk_addr + 1 + pf->degree);
+    victim->age = util_get_next_age();
+    victim->valid = 1;
+    return FALSE;
+}
+
+
+/***************************************************************************
+ * Name:    cache_prefetch_get_type
+ *
+ * Desc:    Maps a prefetcher name to its type.
+ *
+ * Params:
+ *  name    prefetcher name; next-line, stride or stream
+ *
+ * Returns: uint8_t
+ *  CACHE_PF_* for a known name
+ *  CACHE_PF_NONE otherwise
+ **************************************************************************/
+uint8_t
+cache_prefetch_get_type(const char *name)
+{
+    uint8_t type = 0;
+
+    for (type = CACHE_PF_NEXT_LINE; type <= CACHE_PF_STREAM; ++type) {
+        if (!strcmp(name, g_pf_names[type]))
+            return type;
+    }
+    return CACHE_PF_NONE;
+}
+
+
+/***************************************************************************
+ * Name:    cache_prefetch_get_name
+ *
+ * Desc:    Returns the name of a prefetcher type.
+ *
+ * Params:
+ *  type    prefetcher type, CACHE_PF_*
+ *
+ * Returns: const char *
+ *  name of the prefetcher
+ **************************************************************************/
+const char *
+cache_prefetch_get_name(uint8_t type)
+{
+    return ((type <= CACHE_PF_STREAM) ? g_pf_names[type] : g_pf_names[0]);
+}
@@ -0,0 +1,32 @@
+/*
+ * ECE 521 - Computer Design Techniques, Fall 2014
+ * Project 3 - Dynamic Instruction Scheduler
+ *
+ * This module contains all required function declarations for the hardware
+ * prefetchers which can be attached to any level of the cache hierarchy.
+ *
+ * Author: Aravindhan Dhanasekaran <adhanas@ncsu.edu>
+ */
+
+#ifndef DIS_CACHE_PREFETCH_H_
+#define DIS_CACHE_PREFETCH_H_
+
+#include "dis-cache.h"
+
+/* Function declarations */
+void
+cache_prefetch_init(cache_generic_t *cache, uint8_t type, uint8_t degree);
+void
+cache_prefetch_cleanup(cache_generic_t *cache);
+void
+cache_prefetch_train(cache_generic_t *cache, mem_ref_t *mref,
+        boolean trigger);
+boolean
+cache_prefetch_stream_lookup(cache_generic_t *cache, mem_ref_t *mref,
+        uint32_t *latency);
+uint8_t
+cache_prefetch_get_type(const char *name);
+const char *
+cache_prefetch_get_name(uint8_t type);
+
+#endif /* DIS_CACHE_PREFETCH_H_ */
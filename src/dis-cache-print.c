@@ -11,12 +11,14 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <math.h>
 
 #include "dis.h"
 #include "dis-utils.h"
 #include "dis-cache.h"
 #include "dis-cache-utils.h"
 #include "dis-cache-print.h"
+#include "dis-cache-prefetch.h"
 
 #ifdef dprint_info
 #undef dprint_info
@@ -215,10 +217,117 @@ cache_print_sim_stats(cache_generic_t *cache)
 }
 
 
+/***************************************************************************
+ * Name:    cache_print_sample_stats
+ *
+ * Desc:    Prints the set sampling summary of a cache: the miss ratio seen
+ *          in the sampled sets with its 95% confidence interval, and the #
+ *          of misses it extrapolates to over all the accesses. Refs to the
+ *          same set are far from independent, so the set is the sampling
+ *          unit: the interval comes from the spread of the misses across
+ *          the sampled sets (ratio estimator of cluster sampling), with the
+ *          finite population correction for the sets sampled. With fewer
+ *          than two sampled sets there is no spread to go by; the interval
+ *          is then all of [0, 1].
+ *
+ * Params:
+ *  cache   ptr to the set sampled cache
+ *
+ * Returns: Nothing
+ **************************************************************************/
+static void
+cache_print_sample_stats(cache_generic_t *cache)
+{
+    double              ratio = 0;
+    double              margin = 1;
+    double              resid = 0;
+    double              sum_sq = 0;
+    double              mean_refs = 0;
+    uint32_t            iter = 0;
+    uint32_t            num_sets = 0;
+    uint32_t            num_accesses = 0;
+    cache_stats_t       *stats = NULL;
+    cache_tagstore_t    *tagstore = NULL;
+
+    stats = &cache->stats;
+    tagstore = cache->tagstore;
+    num_sets = tagstore->num_sets;
+    num_accesses = (stats->num_reads + stats->num_writes);
+    if (stats->num_sampled_refs)
+        ratio = ((double) stats->num_sampled_misses / stats->num_sampled_refs);
+
+    if (stats->num_sampled_refs && (num_sets > 1)) {
+        for (iter = 0; iter < num_sets; ++iter) {
+            resid = (tagstore->sample_misses[iter] -
+                    (ratio * tagstore->sample_refs[iter]));
+            sum_sq += (resid * resid);
+        }
+        mean_refs = ((double) stats->num_sampled_refs / num_sets);
+        margin = (1.96 * sqrt((1 - (1.0 / (1U << tagstore->num_sample_bits))) *
+                    (sum_sq / (num_sets - 1)) /
+                    (num_sets * mean_refs * mean_refs)));
+    }
+
+    dprint("   set sampling : 1 in %u sets, %u of %u accesses sampled\n",
+            (1U << cache->tagstore->num_sample_bits), stats->num_sampled_refs,
+            num_accesses);
+    dprint("   miss rate : %.4f +/- %.4f (95%% CI)\n", ratio, margin);
+    dprint("   est. number of misses : %.0f [%.0f, %.0f]\n",
+            (ratio * num_accesses),
+            (((ratio > margin) ? (ratio - margin) : 0) * num_accesses),
+            (((ratio + margin) < 1 ? (ratio + margin) : 1) * num_accesses));
+    return;
+}
+
+
+/***************************************************************************
+ * Name:    cache_print_prefetch_stats
+ *
+ * Desc:    Prints the prefetcher summary of a cache: accuracy (useful /
+ *          issued), coverage (misses removed / misses without prefetching)
+ *          and timeliness (useful prefetches which were not late).
+ *
+ * Params:
+ *  cache   ptr to the cache with a prefetcher
+ *
+ * Returns: Nothing
+ **************************************************************************/
+static void
+cache_print_prefetch_stats(cache_generic_t *cache)
+{
+    uint32_t        num_misses = 0;
+    cache_stats_t   *stats = NULL;
+
+    stats = &cache->stats;
+    num_misses = (stats->num_read_misses + stats->num_write_misses);
+
+    /* Stream buffer hits are still counted as cache misses. */
+    if (CACHE_PF_STREAM != cache->prefetcher->type)
+        num_misses += stats->num_pf_useful;
+
+    dprint("   prefetcher : %s, degree %u\n",
+            cache_prefetch_get_name(cache->prefetcher->type),
+            cache->prefetcher->degree);
+    dprint("   prefetches : %u issued, %u useful, %u late, %u dropped\n",
+            stats->num_pf_issued, stats->num_pf_useful, stats->num_pf_late,
+            stats->num_pf_dropped);
+    dprint("   accuracy : %.4f, coverage : %.4f, timeliness : %.4f\n",
+            (stats->num_pf_issued ?
+             ((double) stats->num_pf_useful / stats->num_pf_issued) : 0),
+            (num_misses ? ((double) stats->num_pf_useful / num_misses) : 0),
+            (stats->num_pf_useful ?
+             ((double) (stats->num_pf_useful - stats->num_pf_late) /
+              stats->num_pf_useful) : 0));
+    return;
+}
+
+
 /*************************************************************************** 
  * Name:    cache_print_cache_data
  *
- * Desc:    Prints the simulator data in TA's style. 
+ * Desc:    Prints the simulator data in TA's style. The valid blocks of
+ *          each set are printed in way order (TA's style) or, with
+ *          g_cache_dump_order set to MRU, from MRU to LRU.
  *
  * Params:
  *  cache   ptr to the main cache data structure
@@ -228,84 +337,103 @@ cache_print_sim_stats(cache_generic_t *cache)
 void
 cache_print_cache_data(cache_generic_t *cache)
 {
-    char                *title = NULL;
     uint32_t            index = 0;
     uint32_t            tag_index = 0;
     uint32_t            id = 0;
     uint32_t            block_id = 0;
     uint32_t            num_sets = 0;
     uint32_t            num_blocks_per_set = 0;
-    uint32_t            *tags = NULL;
-    uint64_t            *tag_ages = NULL;
+    uint32_t            num_valid = 0;
+    uint32_t            *order = NULL;
     cache_tag_data_t    *tag_data = NULL;
     cache_tagstore_t    *tagstore = NULL;
 
     tagstore = cache->tagstore;
     num_sets = tagstore->num_sets;
     num_blocks_per_set = tagstore->num_blocks_per_set;
-    tag_ages = (uint64_t *) calloc(1, (num_blocks_per_set * sizeof(uint64_t)));
-
-    switch (cache->level) {
-        case CACHE_LEVEL_1:
-            title = "L1 CACHE CONTENTS";
-            break;
 
-        case CACHE_LEVEL_L1_VICTIM:
-            title = "===== Victim Cache contents =====";
-            break;
-
-        case CACHE_LEVEL_2:
-            title = "L2 CACHE CONTENTS";
-            break;
-        default:
-            cache_assert(0);
+    /* One ordering buffer for the whole dump, only for MRU order. */
+    if (CACHE_DUMP_ORDER_MRU == g_cache_dump_order) {
+        order = (uint32_t *) malloc(num_blocks_per_set * sizeof(uint32_t));
+        if (!order) {
+            dprint("Error: Unable to allocate memory for cache %s dump.\n",
+                    CACHE_GET_NAME(cache));
+            return;
+        }
     }
 
-    dprint("%s\n", title);
+    if (CACHE_IS_VC(cache))
+        dprint("VICTIM CACHE CONTENTS\n");
+    else
+        dprint("%s CACHE CONTENTS\n", CACHE_GET_NAME(cache));
+
     dprint("a. number of accesses : %u\n",
             (cache->stats.num_reads + cache->stats.num_writes));
     dprint("b. number of misses : %u\n",
             (cache->stats.num_read_misses + cache->stats.num_write_misses));
+    if (tagstore->num_sample_bits)
+        cache_print_sample_stats(cache);
+    if (cache->prefetcher)
+        cache_print_prefetch_stats(cache);
+
     for (index = 0; index < num_sets; ++index) {
         tag_index = (index * num_blocks_per_set);
-        tags = &tagstore->tags[tag_index];
         tag_data = &tagstore->tag_data[tag_index];
-
-        /*
-         * Copy the tag ages for sorting. TAs decided to print the tags by
-         * their ages. Recent tags goes first.
-         *
-         * qsort the tags, match them back to the block IDs and print the
-         * tags accordingly!
-         */
-        for (block_id = 0; block_id < num_blocks_per_set; ++block_id)
-            tag_ages[block_id] = tag_data[block_id].age;
-
-#if 0
-        qsort(tag_ages, num_blocks_per_set,
-                sizeof(uint64_t), util_compare_uint64);
-#endif
-        
-        dprint("set%4u: ", index);
-        for (id = 0; id < num_blocks_per_set; ++id) {
-            for (block_id = 0; block_id < num_blocks_per_set; ++block_id) {
-                if ((tag_ages[id]) &&
-                        (tag_data[block_id].age == tag_ages[id])) {
-                    dprint(" %7x %s",
-                        tags[block_id],
-                        (tag_data[block_id].dirty) ? g_dirty : " ");
-                    tag_ages[id] = 0;
-                }
-            }
+        num_valid = (order ? cache_util_get_set_order(tagstore, index, order) :
+                num_blocks_per_set);
+
+        dprint("set%4u: ", (index << tagstore->num_sample_bits));
+        for (id = 0; id < num_valid; ++id) {
+            block_id = (order ? order[id] : id);
+            if (!tag_data[block_id].valid)
+                continue;
+
+            dprint(" %7" PRIx64 " %s",
+                    cache_tagstore_get_tag(tagstore, (tag_index + block_id)),
+                    (tag_data[block_id].dirty) ? g_dirty : " ");
         }
         dprint("\n");
     }
-    free(tag_ages);
+    free(order);
 
     return;
 }
 
 
+/***************************************************************************
+ * Name:    cache_print_mshr_stats
+ *
+ * Desc:    Prints the MSHR statistics of a non-blocking cache.
+ *
+ * Params:
+ *  cache   ptr to the cache owning the MSHRs
+ *
+ * Returns: Nothing
+ **************************************************************************/
+void
+cache_print_mshr_stats(cache_generic_t *cache)
+{
+    cache_mshr_t *mshr = NULL;
+
+    if ((!cache) || (!cache->mshr)) {
+        cache_assert(0);
+        goto exit;
+    }
+    mshr = cache->mshr;
+
+    dprint("%s MSHR STATISTICS\n", CACHE_GET_NAME(cache));
+    dprint("a. number of MSHRs : %u\n", mshr->num_entries);
+    dprint("b. fill interval : %u\n", mshr->fill_interval);
+    dprint("c. number of primary misses : %u\n", mshr->num_primary);
+    dprint("d. number of secondary misses : %u\n", mshr->num_secondary);
+    dprint("e. number of MSHR full stalls : %u\n", mshr->num_full_stalls);
+    dprint("f. peak MSHRs in use : %u\n", mshr->max_used);
+
+exit:
+    return;
+}
+
+
 /*************************************************************************** 
  * Name:    cache_print_usage
  *
@@ -481,9 +609,9 @@ cache_print_tags(cache_generic_t *cache, cache_line_t *line)
 {
     char                *dirty_str = NULL;
     int32_t             lru_id = -1;
-    uint32_t            *tags = NULL;
     uint32_t            num_blocks = 0;
     uint32_t            block_id = 0;
+    cache_tag_t         tag = 0;
     uint32_t            tag_index = 0;
     cache_tagstore_t    *tagstore = NULL;
     cache_tag_data_t    *tag_data = NULL;
@@ -491,18 +619,18 @@ cache_print_tags(cache_generic_t *cache, cache_line_t *line)
     tagstore = cache->tagstore;
     num_blocks = tagstore->num_blocks_per_set;
     tag_index = (line->index * num_blocks);
-    tags = &tagstore->tags[tag_index];
     tag_data = &tagstore->tag_data[tag_index];
     lru_id = cache_util_get_lru_block_id(tagstore, line);
 
-    dprint("%6u %s [%2u, %d, %7x]: ",
+    dprint("%6u %s [%2u, %d, %7" PRIx64 "]: ",
             g_addr_count, CACHE_GET_NAME(cache),
             line->index, lru_id, line->tag);
 
     for (block_id = 0; block_id < num_blocks; ++block_id) {
         dirty_str = ((tag_data[block_id].dirty) ? "D" : "");
-        if (tags[block_id])
-            dprint("%8x %1s", tags[block_id], dirty_str);
+        tag = cache_tagstore_get_tag(tagstore, (tag_index + block_id));
+        if (tag)
+            dprint("%8" PRIx64 " %1s", tag, dirty_str);
         else
             dprint("%8s %1s", "-", dirty_str);
     }
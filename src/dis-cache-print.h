@@ -23,6 +23,8 @@ void
 cache_print_sim_config(cache_generic_t *cache);
 void
 cache_print_stats(cache_stats_t *pcache_stats, boolean detail);
+void
+cache_print_mshr_stats(cache_generic_t *cache);
 
 #ifdef DBG_ON
 void
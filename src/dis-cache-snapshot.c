@@ -0,0 +1,505 @@
+/*
+ * ECE 521 - Computer Design Techniques, Fall 2014
+ * Project 3 - Dynamic Instruction Scheduler
+ *
+ * This module implements warm cache snapshots. The tagstores of all the
+ * caches in the hierarchy (L1, victim cache and L2), along with their
+ * replacement state, are dumped to a compact file which can later be
+ * mapped back in at startup instead of starting with cold caches.
+ *
+ * Author: Aravindhan Dhanasekaran <adhanas@ncsu.edu>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "dis.h"
+#include "dis-utils.h"
+#include "dis-cache.h"
+#include "dis-cache-utils.h"
+#include "dis-cache-snapshot.h"
+
+#ifdef dprint_info
+#undef dprint_info
+#define dprint_info(str, ...)
+#endif
+
+
+/***************************************************************************
+ * Name:    cache_snapshot_align
+ *
+ * Desc:    Rounds the given file offset up to the snapshot alignment.
+ *
+ * Params:
+ *  off     file offset
+ *
+ * Returns: uint64_t
+ *  aligned file offset
+ **************************************************************************/
+static inline uint64_t
+cache_snapshot_align(uint64_t off)
+{
+    return ((off + (CACHE_SNAPSHOT_ALIGN - 1)) &
+            ~((uint64_t) (CACHE_SNAPSHOT_ALIGN - 1)));
+}
+
+
+/***************************************************************************
+ * Name:    cache_snapshot_get_caches
+ *
+ * Desc:    Collects the caches of the hierarchy, starting at L1 and
+ *          following the next level links.
+ *
+ * Params:
+ *  l1_cache    ptr to the L1 cache
+ *  caches      array to store the cache ptrs
+ *
+ * Returns: uint32_t
+ *  # of caches in the hierarchy
+ **************************************************************************/
+static uint32_t
+cache_snapshot_get_caches(cache_generic_t *l1_cache,
+        cache_generic_t *caches[CACHE_SNAPSHOT_MAX_CACHES])
+{
+    uint32_t        num_caches = 0;
+    cache_generic_t *cache = NULL;
+
+    for (cache = l1_cache; cache && (num_caches < CACHE_SNAPSHOT_MAX_CACHES);
+            cache = cache->next_cache)
+        caches[num_caches++] = cache;
+
+    return num_caches;
+}
+
+
+/***************************************************************************
+ * Name:    cache_snapshot_write_section
+ *
+ * Desc:    Writes a section at the given (aligned) file offset, zero
+ *          padding the file up to it.
+ *
+ * Params:
+ *  fp      snapshot file ptr
+ *  off     file offset of the section
+ *  buf     section data
+ *  len     section length in bytes
+ *
+ * Returns: boolean
+ *  TRUE on success
+ *  FALSE on a write error
+ **************************************************************************/
+static boolean
+cache_snapshot_write_section(FILE *fp, uint64_t off, const void *buf,
+        uint64_t len)
+{
+    static const char   pad[CACHE_SNAPSHOT_ALIGN];
+    long                curr = 0;
+
+    curr = ftell(fp);
+    if ((curr < 0) || ((uint64_t) curr > off) ||
+            ((off - curr) > CACHE_SNAPSHOT_ALIGN))
+        return FALSE;
+
+    if ((off - curr) && (1 != fwrite(pad, (off - curr), 1, fp)))
+        return FALSE;
+
+    if (len && (1 != fwrite(buf, len, 1, fp)))
+        return FALSE;
+
+    return TRUE;
+}
+
+
+/***************************************************************************
+ * Name:    cache_snapshot_save
+ *
+ * Desc:    Dumps the tagstores and the replacement state of all the caches
+ *          to the given snapshot file. Statistics are not part of the
+ *          snapshot; a restored run starts with warm caches but clean
+ *          counters.
+ *
+ * Params:
+ *  l1_cache    ptr to the L1 cache
+ *  path        snapshot file path
+ *  inst_count  # of insts done so far; informational
+ *
+ * Returns: boolean
+ *  TRUE on success
+ *  FALSE otherwise
+ **************************************************************************/
+boolean
+cache_snapshot_save(cache_generic_t *l1_cache, const char *path,
+        uint32_t inst_count)
+{
+    FILE                    *fp = NULL;
+    uint32_t                iter = 0;
+    uint32_t                num_caches = 0;
+    uint64_t                off = 0;
+    uint64_t                num_blocks = 0;
+    cache_tagstore_t        *tagstore = NULL;
+    cache_generic_t         *caches[CACHE_SNAPSHOT_MAX_CACHES];
+    cache_snapshot_hdr_t    hdr;
+    cache_snapshot_level_t  levels[CACHE_SNAPSHOT_MAX_CACHES];
+
+    if ((!l1_cache) || (!path)) {
+        cache_assert(0);
+        goto error_exit;
+    }
+
+    num_caches = cache_snapshot_get_caches(l1_cache, caches);
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, CACHE_SNAPSHOT_MAGIC, CACHE_SNAPSHOT_MAGIC_LEN);
+    hdr.version = CACHE_SNAPSHOT_VERSION;
+    hdr.num_caches = num_caches;
+    hdr.tag_data_size = sizeof(cache_tag_data_t);
+    hdr.inst_count = inst_count;
+    hdr.age = g_cache_age;
+
+    /* Lay out the arrays after the header and the level records. */
+    memset(levels, 0, sizeof(levels));
+    off = (sizeof(hdr) + (num_caches * sizeof(levels[0])));
+    for (iter = 0; iter < num_caches; ++iter) {
+        tagstore = caches[iter]->tagstore;
+        num_blocks = tagstore->num_blocks;
+
+        levels[iter].level = caches[iter]->level;
+        levels[iter].size = caches[iter]->size;
+        levels[iter].set_assoc = caches[iter]->set_assoc;
+        levels[iter].blk_size = caches[iter]->blk_size;
+        levels[iter].num_sets = tagstore->num_sets;
+        levels[iter].num_tag_bits = tagstore->num_tag_bits;
+
+        levels[iter].tags_off = off = cache_snapshot_align(off);
+        off += (num_blocks * sizeof(*(tagstore->tags)));
+        levels[iter].tag_data_off = off = cache_snapshot_align(off);
+        off += (num_blocks * sizeof(*(tagstore->tag_data)));
+        levels[iter].set_ref_count_off = off = cache_snapshot_align(off);
+        off += (tagstore->num_sets * sizeof(*(tagstore->set_ref_count)));
+        levels[iter].tags_hi_off = off = cache_snapshot_align(off);
+        off += (num_blocks * tagstore->num_tag_hi_bytes);
+    }
+
+    fp = fopen(path, "wb");
+    if (!fp) {
+        dprint("ERROR: Unable to open snapshot file %s for writing.\n", path);
+        goto error_exit;
+    }
+
+    if ((1 != fwrite(&hdr, sizeof(hdr), 1, fp)) ||
+            (num_caches &&
+             (1 != fwrite(levels, (num_caches * sizeof(levels[0])), 1, fp))))
+        goto write_error;
+
+    for (iter = 0; iter < num_caches; ++iter) {
+        tagstore = caches[iter]->tagstore;
+        num_blocks = tagstore->num_blocks;
+
+        if (!cache_snapshot_write_section(fp, levels[iter].tags_off,
+                    tagstore->tags, (num_blocks * sizeof(*(tagstore->tags)))))
+            goto write_error;
+
+        if (!cache_snapshot_write_section(fp, levels[iter].tag_data_off,
+                    tagstore->tag_data,
+                    (num_blocks * sizeof(*(tagstore->tag_data)))))
+            goto write_error;
+
+        if (!cache_snapshot_write_section(fp, levels[iter].set_ref_count_off,
+                    tagstore->set_ref_count, (tagstore->num_sets *
+                        sizeof(*(tagstore->set_ref_count)))))
+            goto write_error;
+
+        if (tagstore->tags_hi &&
+                !cache_snapshot_write_section(fp, levels[iter].tags_hi_off,
+                    tagstore->tags_hi,
+                    (num_blocks * tagstore->num_tag_hi_bytes)))
+            goto write_error;
+    }
+
+    if (fclose(fp)) {
+        fp = NULL;
+        goto write_error;
+    }
+
+    dprint_info("saved %u caches to snapshot %s at inst %u\n",
+            num_caches, path, inst_count);
+    return TRUE;
+
+write_error:
+    dprint("ERROR: Unable to write snapshot file %s.\n", path);
+    if (fp)
+        fclose(fp);
+
+error_exit:
+    return FALSE;
+}
+
+
+/***************************************************************************
+ * Name:    cache_snapshot_restore
+ *
+ * Desc:    Maps the given snapshot file and loads the tagstores and the
+ *          replacement state of all the caches from it. The cache
+ *          hierarchy has to be set up already and has to match the one
+ *          the snapshot was taken with.
+ *
+ * Params:
+ *  l1_cache    ptr to the L1 cache
+ *  path        snapshot file path
+ *
+ * Returns: boolean
+ *  TRUE on success
+ *  FALSE otherwise
+ **************************************************************************/
+boolean
+cache_snapshot_restore(cache_generic_t *l1_cache, const char *path)
+{
+    int                     fd = -1;
+    uint8_t                 *base = MAP_FAILED;
+    uint32_t                iter = 0;
+    uint32_t                num_caches = 0;
+    uint64_t                file_size = 0;
+    uint64_t                tags_len = 0;
+    uint64_t                tag_data_len = 0;
+    uint64_t                ref_count_len = 0;
+    uint64_t                tags_hi_len = 0;
+    struct stat             st;
+    cache_tagstore_t        *tagstore = NULL;
+    cache_generic_t         *caches[CACHE_SNAPSHOT_MAX_CACHES];
+    cache_snapshot_hdr_t    *hdr = NULL;
+    cache_snapshot_level_t  *levels = NULL;
+
+    if ((!l1_cache) || (!path)) {
+        cache_assert(0);
+        goto error_exit;
+    }
+
+    fd = open(path, O_RDONLY);
+    if ((fd < 0) || fstat(fd, &st)) {
+        dprint("ERROR: Unable to open snapshot file %s.\n", path);
+        goto error_exit;
+    }
+
+    file_size = st.st_size;
+    if (file_size < sizeof(*hdr))
+        goto bad_snapshot;
+
+    base = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (MAP_FAILED == base) {
+        dprint("ERROR: Unable to map snapshot file %s.\n", path);
+        goto error_exit;
+    }
+
+    hdr = (cache_snapshot_hdr_t *) base;
+    if (memcmp(hdr->magic, CACHE_SNAPSHOT_MAGIC, CACHE_SNAPSHOT_MAGIC_LEN) ||
+            (CACHE_SNAPSHOT_VERSION != hdr->version) ||
+            (sizeof(cache_tag_data_t) != hdr->tag_data_size))
+        goto bad_snapshot;
+
+    num_caches = cache_snapshot_get_caches(l1_cache, caches);
+    if ((num_caches != hdr->num_caches) ||
+            (file_size < (sizeof(*hdr) + (num_caches * sizeof(*levels)))))
+        goto bad_config;
+
+    /* Validate everything before touching any of the tagstores. */
+    levels = (cache_snapshot_level_t *) (base + sizeof(*hdr));
+    for (iter = 0; iter < num_caches; ++iter) {
+        tagstore = caches[iter]->tagstore;
+        if ((levels[iter].level != caches[iter]->level) ||
+                (levels[iter].size != caches[iter]->size) ||
+                (levels[iter].set_assoc != caches[iter]->set_assoc) ||
+                (levels[iter].blk_size != caches[iter]->blk_size) ||
+                (levels[iter].num_sets != tagstore->num_sets) ||
+                (levels[iter].num_tag_bits != tagstore->num_tag_bits))
+            goto bad_config;
+
+        tags_len = (tagstore->num_blocks * sizeof(*(tagstore->tags)));
+        tag_data_len = (tagstore->num_blocks * sizeof(*(tagstore->tag_data)));
+        ref_count_len =
+            (tagstore->num_sets * sizeof(*(tagstore->set_ref_count)));
+        tags_hi_len = (tagstore->num_blocks * tagstore->num_tag_hi_bytes);
+        if ((levels[iter].tags_off > file_size) ||
+                (tags_len > (file_size - levels[iter].tags_off)) ||
+                (levels[iter].tag_data_off > file_size) ||
+                (tag_data_len > (file_size - levels[iter].tag_data_off)) ||
+                (levels[iter].set_ref_count_off > file_size) ||
+                (ref_count_len >
+                 (file_size - levels[iter].set_ref_count_off)) ||
+                (levels[iter].tags_hi_off > file_size) ||
+                (tags_hi_len > (file_size - levels[iter].tags_hi_off)))
+            goto bad_snapshot;
+    }
+
+    for (iter = 0; iter < num_caches; ++iter) {
+        tagstore = caches[iter]->tagstore;
+
+        memcpy(tagstore->tags, (base + levels[iter].tags_off),
+                (tagstore->num_blocks * sizeof(*(tagstore->tags))));
+        memcpy(tagstore->tag_data, (base + levels[iter].tag_data_off),
+                (tagstore->num_blocks * sizeof(*(tagstore->tag_data))));
+        memcpy(tagstore->set_ref_count,
+                (base + levels[iter].set_ref_count_off),
+                (tagstore->num_sets * sizeof(*(tagstore->set_ref_count))));
+        if (tagstore->tags_hi)
+            memcpy(tagstore->tags_hi, (base + levels[iter].tags_hi_off),
+                    (tagstore->num_blocks * tagstore->num_tag_hi_bytes));
+        cache_tagstore_rebuild(tagstore);
+
+        dprint_info("%s, restored from snapshot %s\n",
+                CACHE_GET_NAME(caches[iter]), path);
+    }
+
+    /* New references have to be younger than all the restored blocks. */
+    g_cache_age = hdr->age;
+
+    munmap(base, file_size);
+    close(fd);
+    return TRUE;
+
+bad_config:
+    dprint("ERROR: Snapshot %s was taken with a different cache "
+            "configuration.\n", path);
+    goto error_exit;
+
+bad_snapshot:
+    dprint("ERROR: Snapshot file %s is not valid.\n", path);
+
+error_exit:
+    if (MAP_FAILED != base)
+        munmap(base, file_size);
+    if (fd >= 0)
+        close(fd);
+    return FALSE;
+}
+
+
+/***************************************************************************
+ * Name:    cache_snapshot_dump
+ *
+ * Desc:    Writes the contents of all the caches to the given file in the
+ *          binary dump format, each set from MRU to LRU. Meant for diffing
+ *          the final cache state of two runs offline; replacement ages are
+ *          left out as they depend on the # of references seen.
+ *
+ * Params:
+ *  l1_cache    ptr to the L1 cache
+ *  path        dump file path
+ *
+ * Returns: boolean
+ *  TRUE on success
+ *  FALSE otherwise
+ **************************************************************************/
+boolean
+cache_snapshot_dump(cache_generic_t *l1_cache, const char *path)
+{
+    FILE                *fp = NULL;
+    uint32_t            iter = 0;
+    uint32_t            index = 0;
+    uint32_t            rank = 0;
+    uint32_t            block_id = 0;
+    uint32_t            num_caches = 0;
+    uint32_t            num_valid = 0;
+    uint32_t            num_blocks_per_set = 0;
+    uint32_t            *order = NULL;
+    cache_tag_data_t    *tag_data = NULL;
+    cache_tagstore_t    *tagstore = NULL;
+    cache_generic_t     *caches[CACHE_SNAPSHOT_MAX_CACHES];
+    cache_dump_block_t  *blocks = NULL;
+    cache_dump_hdr_t    hdr;
+    cache_dump_level_t  level;
+
+    if ((!l1_cache) || (!path)) {
+        cache_assert(0);
+        goto error_exit;
+    }
+
+    num_caches = cache_snapshot_get_caches(l1_cache, caches);
+
+    fp = fopen(path, "wb");
+    if (!fp) {
+        dprint("ERROR: Unable to open cache dump file %s for writing.\n", path);
+        goto error_exit;
+    }
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, CACHE_DUMP_MAGIC, CACHE_SNAPSHOT_MAGIC_LEN);
+    hdr.version = CACHE_DUMP_VERSION;
+    hdr.num_caches = num_caches;
+    if (1 != fwrite(&hdr, sizeof(hdr), 1, fp))
+        goto write_error;
+
+    for (iter = 0; iter < num_caches; ++iter) {
+        tagstore = caches[iter]->tagstore;
+        num_blocks_per_set = tagstore->num_blocks_per_set;
+
+        memset(&level, 0, sizeof(level));
+        level.level = caches[iter]->level;
+        level.num_sets = tagstore->num_sets;
+        level.set_assoc = num_blocks_per_set;
+        level.num_tag_bits = tagstore->num_tag_bits;
+        level.num_sample_bits = tagstore->num_sample_bits;
+        if (1 != fwrite(&level, sizeof(level), 1, fp))
+            goto write_error;
+
+        /* Set buffers are sized by the associativity; reuse them per set. */
+        free(order);
+        free(blocks);
+        order = (uint32_t *) malloc(num_blocks_per_set * sizeof(*order));
+        blocks = (cache_dump_block_t *)
+            malloc(num_blocks_per_set * sizeof(*blocks));
+        if ((!order) || (!blocks)) {
+            dprint("ERROR: Unable to allocate memory for cache dump.\n");
+            goto close_exit;
+        }
+
+        for (index = 0; index < tagstore->num_sets; ++index) {
+            tag_data = &tagstore->tag_data[index * num_blocks_per_set];
+            num_valid = cache_util_get_set_order(tagstore, index, order);
+
+            memset(blocks, 0, (num_blocks_per_set * sizeof(*blocks)));
+            for (rank = 0; rank < num_blocks_per_set; ++rank) {
+                blocks[rank].set = (index << tagstore->num_sample_bits);
+                blocks[rank].rank = rank;
+            }
+
+            for (rank = 0; rank < num_valid; ++rank) {
+                block_id = order[rank];
+                blocks[rank].tag = cache_tagstore_get_tag(tagstore,
+                        ((index * num_blocks_per_set) + block_id));
+                blocks[rank].valid = 1;
+                blocks[rank].dirty = (tag_data[block_id].dirty ? 1 : 0);
+            }
+
+            if (1 != fwrite(blocks, (num_blocks_per_set * sizeof(*blocks)),
+                        1, fp))
+                goto write_error;
+        }
+    }
+
+    free(order);
+    free(blocks);
+    if (fclose(fp)) {
+        dprint("ERROR: Unable to write cache dump file %s.\n", path);
+        return FALSE;
+    }
+
+    dprint_info("dumped %u caches to %s\n", num_caches, path);
+    return TRUE;
+
+write_error:
+    dprint("ERROR: Unable to write cache dump file %s.\n", path);
+
+close_exit:
+    free(order);
+    free(blocks);
+    fclose(fp);
+
+error_exit:
+    return FALSE;
+}
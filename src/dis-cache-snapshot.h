@@ -0,0 +1,104 @@
+/*
+ * ECE 521 - Computer Design Techniques, Fall 2014
+ * Project 3 - Dynamic Instruction Scheduler
+ *
+ * This module contains the snapshot file layout and function declarations
+ * for saving and restoring the warm state of the cache hierarchy.
+ *
+ * Author: Aravindhan Dhanasekaran <adhanas@ncsu.edu>
+ */
+
+#ifndef DIS_CACHE_SNAPSHOT_H_
+#define DIS_CACHE_SNAPSHOT_H_
+
+#include <stdint.h>
+
+#include "dis-cache.h"
+
+/* Constants */
+#define CACHE_SNAPSHOT_MAGIC        "DISCSNAP"
+#define CACHE_SNAPSHOT_MAGIC_LEN    8
+#define CACHE_SNAPSHOT_VERSION      2
+#define CACHE_SNAPSHOT_MAX_CACHES   8
+#define CACHE_SNAPSHOT_ALIGN        8
+
+/*
+ * Snapshot file layout; all sections are CACHE_SNAPSHOT_ALIGN aligned so
+ * that the arrays can be used in place from a mapping of the file:
+ *
+ *  +--------+---------+-----+---------+------+----------+---------------+
+ *  | header | level 0 | ... | level n | tags | tag_data | set_ref_count |
+ *  +--------+---------+-----+---------+------+----------+---------------+
+ *  +---------+--
+ *  | tags_hi | .. next level
+ *  +---------+--
+ *
+ * Arrays are stored in host byte order with the in memory tagstore layout.
+ */
+typedef struct cache_snapshot_hdr__ {
+    char        magic[CACHE_SNAPSHOT_MAGIC_LEN];
+    uint32_t    version;                /* CACHE_SNAPSHOT_VERSION       */
+    uint32_t    num_caches;             /* # of level records           */
+    uint32_t    tag_data_size;          /* sizeof(cache_tag_data_t)     */
+    uint32_t    inst_count;             /* # of insts done at save time */
+    uint64_t    age;                    /* running block age (LRU)      */
+} cache_snapshot_hdr_t;
+
+typedef struct cache_snapshot_level__ {
+    uint32_t    level;                  /* cache level                  */
+    uint32_t    size;                   /* total cache size             */
+    uint32_t    set_assoc;              /* level of associativity       */
+    uint32_t    blk_size;               /* cache block size             */
+    uint32_t    num_sets;               /* # of sets                    */
+    uint32_t    num_tag_bits;           /* # of bits for tags           */
+    uint64_t    tags_off;               /* file offset of tags          */
+    uint64_t    tag_data_off;           /* file offset of tag data      */
+    uint64_t    set_ref_count_off;      /* file offset of set ref count */
+    uint64_t    tags_hi_off;            /* file offset of wide tag bytes*/
+} cache_snapshot_level_t;
+
+/*
+ * Binary cache dump, for diffing the final cache contents offline. Unlike
+ * a snapshot it carries no replacement ages; each set is written as
+ * set_assoc records from MRU to LRU, with the invalid blocks last:
+ *
+ *  +--------+------+---------------+-----+-------------------+------+--
+ *  | header | dump | set 0 records | ... | set n - 1 records | dump | ..
+ *  +--------+------+---------------+-----+-------------------+------+--
+ */
+#define CACHE_DUMP_MAGIC            "DISCDUMP"
+#define CACHE_DUMP_VERSION          1
+
+typedef struct cache_dump_hdr__ {
+    char        magic[CACHE_SNAPSHOT_MAGIC_LEN];
+    uint32_t    version;                /* CACHE_DUMP_VERSION           */
+    uint32_t    num_caches;             /* # of cache dumps             */
+} cache_dump_hdr_t;
+
+typedef struct cache_dump_level__ {
+    uint32_t    level;                  /* cache level                  */
+    uint32_t    num_sets;               /* # of (simulated) sets        */
+    uint32_t    set_assoc;              /* level of associativity       */
+    uint32_t    num_tag_bits;           /* # of bits for tags           */
+    uint32_t    num_sample_bits;        /* set sampling ratio, log2     */
+    uint32_t    reserved;
+} cache_dump_level_t;
+
+typedef struct cache_dump_block__ {
+    uint64_t    tag;                    /* 0, if invalid                */
+    uint32_t    set;                    /* set # in the full cache      */
+    uint16_t    rank;                   /* 0 is MRU                     */
+    uint8_t     valid;
+    uint8_t     dirty;
+} cache_dump_block_t;
+
+/* Function declarations */
+boolean
+cache_snapshot_save(cache_generic_t *l1_cache, const char *path,
+        uint32_t inst_count);
+boolean
+cache_snapshot_restore(cache_generic_t *l1_cache, const char *path);
+boolean
+cache_snapshot_dump(cache_generic_t *l1_cache, const char *path);
+
+#endif /* DIS_CACHE_SNAPSHOT_H_ */
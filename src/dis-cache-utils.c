@@ -13,7 +13,6 @@
 #include <string.h>
 #include <stdint.h>
 #include <unistd.h>
-#include <sys/time.h>
 
 #include "dis.h"
 #include "dis-utils.h"
@@ -27,20 +26,20 @@
 
 /* Util functions */
 /*************************************************************************** 
- * Name:    util_get_msb_mask
+ * Name:    util_get_tag_mask
  *
- * Desc:    Computes and returns a 32-bit unsigned MSB mask.
+ * Desc:    Computes and returns a 64-bit unsigned LSB mask for tags.
  *
  * Params:
- *  num_msb_bits    # of MSB bits to be masked
+ *  num_tag_bits    # of LSB bits to be masked
  *
- * Returns: uint32_t
- *  32-bit uint with num_msb_bits masked
+ * Returns: cache_tag_t
+ *  64-bit uint with num_tag_bits masked
  **************************************************************************/
-static inline unsigned
-util_get_msb_mask(uint32_t num_msb_bits)
+static inline cache_tag_t
+util_get_tag_mask(uint32_t num_tag_bits)
 {
-    return ((~0U) << (32 - num_msb_bits));
+    return (num_tag_bits ? ((~((cache_tag_t) 0)) >> (64 - num_tag_bits)) : 0);
 }
 
 
@@ -58,7 +57,8 @@ util_get_msb_mask(uint32_t num_msb_bits)
 static inline unsigned
 util_get_lsb_mask(uint32_t num_lsb_bits)
 {
-    return ((~0U) >> (32 - num_lsb_bits));
+    /* A shift by 32 is undefined; fully associative caches need a 0. */
+    return (num_lsb_bits ? ((~0U) >> (32 - num_lsb_bits)) : 0);
 }
 
 
@@ -84,37 +84,21 @@ util_get_field_mask(uint32_t start_bit, uint32_t end_bit)
 
 
 /*************************************************************************** 
- * Name:    util_get_curr_time
+ * Name:    util_get_next_age
  *
- * Desc:    Returns the current system time in useconds
+ * Desc:    Returns a new age for a block reference (for LRU). Ages only need
+ *          to be strictly increasing in reference order; a running counter
+ *          does that without a timer syscall per reference.
  *
  * Params:  None
  *
  * Returns: uint64_t
- *  Current system time in useconds
+ *  Age for the current reference; never 0, which denotes an unused block
  **************************************************************************/
 inline uint64_t
-util_get_curr_time(void)
+util_get_next_age(void)
 {
-    struct timeval  curr_time;
-
-    memset(&curr_time, 0, sizeof(curr_time));
-
-#ifndef DBG_ON
-    /*
-     * An ugly hack to prevent the same-time for different references due to
-     * a usecond timer bug in non-QA code. The perfomance is still reasonable;
-     * i.e., under 7s for an input trace of 100k references.
-     *
-     * QA code uses a lot of dprints, thus the time interval between two
-     * consecutinve references of a same block is substantially higher than
-     * in non-QA code.
-     */
-    usleep(1);
-#endif /* !DBG_ON */
-    gettimeofday(&curr_time, NULL);
-
-    return ((curr_time.tv_sec * 1000000) + curr_time.tv_usec);
+    return ++g_cache_age;
 }
 
 
@@ -327,6 +311,59 @@ cache_util_get_l2(void)
 }
 
 
+/***************************************************************************
+ * Name:    cache_util_get_level
+ *
+ * Desc:    Returns a ptr to the cache at the given level of the hierarchy.
+ *
+ * Params:
+ *  level   cache level, CACHE_LEVEL_1 .. CACHE_MAX_LEVELS
+ *
+ * Returns: ptr to cache_generic_t
+ * for the given level; NULL for a bad level
+ **************************************************************************/
+cache_generic_t *
+cache_util_get_level(uint32_t level)
+{
+    if (CACHE_LEVEL_1 == level)
+        return &g_l1_cache;
+    else if (CACHE_LEVEL_2 == level)
+        return &g_l2_cache;
+    else if ((level > CACHE_LEVEL_2) && (level <= CACHE_MAX_LEVELS))
+        return &g_lx_caches[level - CACHE_LEVEL_3];
+
+    cache_assert(0);
+    return NULL;
+}
+
+
+/***************************************************************************
+ * Name:    cache_util_get_level_tagstore
+ *
+ * Desc:    Returns a ptr to the tagstore for the given level of the
+ *          hierarchy.
+ *
+ * Params:
+ *  level   cache level, CACHE_LEVEL_1 .. CACHE_MAX_LEVELS
+ *
+ * Returns: ptr to cache_tagstore_t
+ * for the given level; NULL for a bad level
+ **************************************************************************/
+cache_tagstore_t *
+cache_util_get_level_tagstore(uint32_t level)
+{
+    if (CACHE_LEVEL_1 == level)
+        return &g_l1_cache_ts;
+    else if (CACHE_LEVEL_2 == level)
+        return &g_l2_cache_ts;
+    else if ((level > CACHE_LEVEL_2) && (level <= CACHE_MAX_LEVELS))
+        return &g_lx_cache_ts[level - CACHE_LEVEL_3];
+
+    cache_assert(0);
+    return NULL;
+}
+
+
 /*************************************************************************** 
  * Name:    cache_util_validate_input
  *
@@ -375,6 +412,28 @@ cache_util_validate_input(int nargs, char **args)
 }
 
 
+/***************************************************************************
+ * Name:    cache_util_is_sampled
+ *
+ * Desc:    Checks whether the given address maps to a set which is
+ *          simulated in full detail. Without set sampling, all sets are.
+ *
+ * Params:
+ *  tagstore    ptr to the tagstore of the cache
+ *  addr        incoming 32-bit memory address
+ *
+ * Returns: boolean
+ *  TRUE if the set of the address is sampled
+ *  FALSE otherwise
+ **************************************************************************/
+inline boolean
+cache_util_is_sampled(cache_tagstore_t *tagstore, mem_addr_t addr)
+{
+    return (((addr >> tagstore->num_offset_bits) &
+                util_get_lsb_mask(tagstore->num_sample_bits)) ? FALSE : TRUE);
+}
+
+
 /*************************************************************************** 
  * Name:    cache_util_decode_mem_addr
  *
@@ -384,16 +443,15 @@ cache_util_validate_input(int nargs, char **args)
  *
  * Params:
  *  tagstore    ptr to the tagstore of the cache for which addr is decoded
- *  addr        incoming 32-bit memory address
+ *  addr        incoming memory address, up to g_cache_addr_bits wide
  *  line        ptr to store the decoded addr
  *
  * Returns: Nothing
  **************************************************************************/
 void
-cache_util_decode_mem_addr(cache_tagstore_t *tagstore, uint32_t addr, 
+cache_util_decode_mem_addr(cache_tagstore_t *tagstore, mem_addr_t addr, 
         cache_line_t *line)
 {
-    uint32_t tag_mask = 0;
     uint32_t index_mask = 0;
     uint32_t offset_mask = 0;
 
@@ -414,17 +472,21 @@ cache_util_decode_mem_addr(cache_tagstore_t *tagstore, uint32_t addr,
         goto exit;
     }
 
-    tag_mask = util_get_msb_mask(tagstore->num_tag_bits);
     offset_mask = util_get_lsb_mask(tagstore->num_offset_bits);
     index_mask = 
         util_get_field_mask(tagstore->num_offset_bits, 
                 (tagstore->num_offset_bits + 
                     tagstore->num_index_bits) - 1); 
 
-    line->tag = ((addr & tag_mask) >> (32 - tagstore->num_tag_bits));
+    line->tag = ((addr >> (tagstore->num_offset_bits +
+                    tagstore->num_index_bits)) &
+            util_get_tag_mask(tagstore->num_tag_bits));
     line->index = ((addr & index_mask) >> tagstore->num_offset_bits);
     line->offset = (addr & offset_mask);
 
+    /* Compressed index for set sampled caches; see cache_util_is_sampled. */
+    line->index >>= tagstore->num_sample_bits;
+
 exit:
     return;
 }
@@ -464,10 +526,12 @@ cache_util_encode_mem_addr(cache_tagstore_t *tagstore, cache_line_t *line,
     num_offset_bits = tagstore->num_offset_bits;
 
     mref->ref_addr = ((line->tag << (num_index_bits + num_offset_bits)) |
-            (line->index << num_offset_bits));
+            (((mem_addr_t) line->index) <<
+             (num_offset_bits + tagstore->num_sample_bits)));
 
 #ifdef DBG_ON
-    dprint_info("%s, addr_encode tag 0x%x, index %u, addr 0x%x\n",
+    dprint_info("%s, addr_encode tag 0x%" PRIx64 ", index %u, addr 0x%"
+            PRIx64 "\n",
             CACHE_GET_NAME(cache), line->tag, line->index, mref->ref_addr);
 #endif /* DBB_ON */
 
@@ -476,6 +540,91 @@ exit:
 }
 
 
+/***************************************************************************
+ * Name:    cache_util_touch_block
+ *
+ * Desc:    Sets the age of a valid block on a reference and moves it to the
+ *          MRU end of its set's recency list. Blocks of a set are touched
+ *          in increasing age order, so the list stays sorted on age.
+ *
+ * Params:
+ *  tagstore    ptr to the cache tagstore
+ *  index       set index
+ *  block_id    block within the set
+ *  age         age of the reference
+ *
+ * Returns: Nothing
+ **************************************************************************/
+inline void
+cache_util_touch_block(cache_tagstore_t *tagstore, uint32_t index,
+        uint32_t block_id, uint64_t age)
+{
+    uint32_t    head = 0;
+    uint32_t    *next = NULL;
+    uint32_t    *prev = NULL;
+
+    tagstore->tag_data[(index * tagstore->num_blocks_per_set) +
+        block_id].age = age;
+
+    head = tagstore->mru_head[index];
+    if (head == block_id)
+        return;
+
+    next = &tagstore->mru_next[index * tagstore->num_blocks_per_set];
+    prev = &tagstore->mru_prev[index * tagstore->num_blocks_per_set];
+
+    /* Unlink the block, unless it is new to the list. */
+    if (CACHE_MRU_NONE != prev[block_id]) {
+        next[prev[block_id]] = next[block_id];
+        if (CACHE_MRU_NONE != next[block_id])
+            prev[next[block_id]] = prev[block_id];
+    }
+
+    prev[block_id] = CACHE_MRU_NONE;
+    next[block_id] = head;
+    if (CACHE_MRU_NONE != head)
+        prev[head] = block_id;
+    tagstore->mru_head[index] = block_id;
+    return;
+}
+
+
+/***************************************************************************
+ * Name:    cache_util_get_set_order
+ *
+ * Desc:    Orders the valid blocks of a set from MRU to LRU, so that the
+ *          set can be walked in recency order. The order is read off the
+ *          set's recency list, in O(assoc).
+ *
+ * Params:
+ *  tagstore    ptr to the cache tagstore
+ *  index       set index
+ *  order       ptr to store the block IDs in; holds num_blocks_per_set
+ *
+ * Returns: uint32_t
+ *  # of valid blocks placed in order
+ **************************************************************************/
+uint32_t
+cache_util_get_set_order(cache_tagstore_t *tagstore, uint32_t index,
+        uint32_t *order)
+{
+    uint32_t            block_id = 0;
+    uint32_t            num_valid = 0;
+    uint32_t            *next = NULL;
+
+    if ((!tagstore) || (!order)) {
+        cache_assert(0);
+        return 0;
+    }
+
+    next = &tagstore->mru_next[index * tagstore->num_blocks_per_set];
+    for (block_id = tagstore->mru_head[index]; CACHE_MRU_NONE != block_id;
+            block_id = next[block_id])
+        order[num_valid++] = block_id;
+    return num_valid;
+}
+
+
 /***************************************************************************
  * Name:    cache_util_get_lru_block_id
  *
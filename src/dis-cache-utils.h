@@ -53,8 +53,10 @@ cache_util_is_block_dirty(cache_tagstore_t *tagstore, cache_line_t *line,
         int32_t block_id);
 boolean
 cache_util_validate_input(int nargs, char **args);
+inline boolean
+cache_util_is_sampled(cache_tagstore_t *tagstore, mem_addr_t addr);
 void
-cache_util_decode_mem_addr(cache_tagstore_t *tagstore, uint32_t addr, 
+cache_util_decode_mem_addr(cache_tagstore_t *tagstore, mem_addr_t addr, 
         cache_line_t *line);
 void
 cache_util_encode_mem_addr(cache_tagstore_t *tagstore, cache_line_t *line,
@@ -69,6 +71,16 @@ inline cache_generic_t *
 cache_util_get_vc(void);
 inline cache_generic_t *
 cache_util_get_l2(void);
+cache_generic_t *
+cache_util_get_level(uint32_t level);
+cache_tagstore_t *
+cache_util_get_level_tagstore(uint32_t level);
+inline void
+cache_util_touch_block(cache_tagstore_t *tagstore, uint32_t index,
+        uint32_t block_id, uint64_t age);
+uint32_t
+cache_util_get_set_order(cache_tagstore_t *tagstore, uint32_t index,
+        uint32_t *order);
 int8_t
 cache_util_get_lru_block_id(cache_tagstore_t *tagstore, cache_line_t *line);
 boolean
@@ -76,7 +88,7 @@ util_is_power_of_2(uint32_t num);
 uint32_t
 util_log_base_2(uint32_t num);
 inline uint64_t
-util_get_curr_time(void);
+util_get_next_age(void);
 inline uint32_t
 util_get_block_ref_count(cache_tagstore_t *tagstore, cache_line_t *line);
 int
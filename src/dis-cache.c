@@ -19,6 +19,8 @@
 #include "dis-cache.h"
 #include "dis-cache-utils.h"
 #include "dis-cache-print.h"
+#include "dis-cache-mshr.h"
+#include "dis-cache-prefetch.h"
 
 #ifdef dprint_info
 #undef dprint_info
@@ -28,6 +30,7 @@
 /* Globals */
 boolean             g_l2_present = FALSE;       /* l2 cache present?        */
 boolean             g_victim_present = FALSE;   /* victim cache present?    */
+boolean             g_tag_index_present = FALSE;/* hash index high assoc?   */
 
 cache_generic_t     g_l1_cache;             /* primary l1 cache             */
 cache_generic_t     g_l2_cache;             /* l2 cache                     */
@@ -37,7 +40,16 @@ cache_tagstore_t    g_l1_cache_ts;          /* primary cache tagstore       */
 cache_tagstore_t    g_l2_cache_ts;          /* l2 cache tagstore            */
 cache_tagstore_t    g_vic_cache_ts;         /* victim cache tagstore        */
 
+cache_generic_t     g_lx_caches[CACHE_MAX_LEVELS - 2];  /* L3 and beyond    */
+cache_tagstore_t    g_lx_cache_ts[CACHE_MAX_LEVELS - 2];
+
 uint32_t            g_addr_count;           /* ID for mref from trace file  */
+uint32_t            g_cache_cycle;          /* current pipeline cycle       */
+uint64_t            g_cache_age;            /* running block age (LRU)      */
+uint16_t            g_cache_mem_latency;    /* total latency to memory      */
+uint8_t             g_cache_addr_bits = CACHE_ADDR_DEFAULT_BITS;  /* addr */
+uint32_t            g_cache_sample_rand = CACHE_SAMPLE_SEED;  /* set sampling */
+uint8_t             g_cache_dump_order = CACHE_DUMP_ORDER_WAY;  /* data dump */
 
 const char          *g_dirty = "D";         /* used to denote dirty blocks  */
 const char          *g_l1_name = "L1";      /* L1 cache name                */
@@ -51,116 +63,118 @@ const char          *g_write = "WRITE";     /* mref WRITE type string       */
  * Name:    cache_init
  *
  * Desc:    Init code for cache. It sets up the cache parameters based on
- *          the user given cache configuration.
+ *          the given hierarchy configuration, chains the levels together
+ *          (L1 -> VC -> L2 -> L3 ..) and sets up their tagstores.
  *
  * Params:  
- *  l1_cache    ptr to the L1 cache 
- *  vic_cache   ptr to the victim cache
- *  l2_cache    ptr to the L2 cache
- *  num_args    # of input arguments
- *  input       ptr to input list
+ *  config      ptr to the cache hierarchy configuration
  *
  * Returns: Nothing
  **************************************************************************/
 void
-cache_init(cache_generic_t *l1_cache, cache_generic_t *vic_cache,
-        cache_generic_t *l2_cache, int num_args, char **input)
+cache_init(const cache_config_t *config)
 {
-    char        *trace_file = NULL;
-    uint8_t     arg_iter = 0;
-    uint32_t    blk_size = 0;
-    uint32_t    l1_size = 0;
-    uint16_t    l1_set_assoc = 0;
-    uint32_t    l2_size = 0;
-    uint16_t    l2_set_assoc = 0;
-    uint32_t    victim_size = 0;
-
-    if ((!l1_cache) || (!l2_cache) || (!input)) {
+    uint32_t                    iter = 0;
+    cache_generic_t             *cache = NULL;
+    cache_generic_t             *prev = NULL;
+    cache_generic_t             *vic_cache = NULL;
+    const cache_level_config_t  *level = NULL;
+
+    if ((!config) || (!config->num_levels) ||
+            (config->num_levels > CACHE_MAX_LEVELS)) {
         cache_assert(0);
         goto exit;
     }
 
-    memset(l1_cache, 0, sizeof(*l1_cache));
-    memset(l2_cache, 0, sizeof(*l2_cache));
-
-    /* Input for caches is of the form: 
-     * ... <block-size> <l1-cache-size> <l1-set-assoc>
-     *                  <l2-cache-size> <l2-set-assoc> ...
-     */
-    g_victim_present =  FALSE;
-
-    blk_size = atoi(input[arg_iter++]);
-    l1_size = atoi(input[arg_iter++]);
-    l1_set_assoc = atoi(input[arg_iter++]);
-    
-    l2_size = atoi(input[arg_iter++]);
-    g_l2_present = (l2_size ? TRUE : FALSE);
-    l2_set_assoc = atoi(input[arg_iter++]);
-    
-    trace_file = input[arg_iter++];
-
-    /* Init L1 cache. */
-    strncpy(l1_cache->name, g_l1_name, (CACHE_NAME_LEN - 1));
-    strncpy(l1_cache->trace_file, trace_file, (CACHE_TRACE_FILE_LEN - 1));
-    l1_cache->size = l1_size;
-    l1_cache->level = CACHE_LEVEL_1;
-    l1_cache->set_assoc = l1_set_assoc;
-    l1_cache->blk_size = blk_size;
-    l1_cache->repl_plcy = CACHE_REPL_PLCY_LRU;
-    l1_cache->write_plcy = CACHE_WRITE_PLCY_WBWA;
-    l1_cache->victim_size = victim_size;
-    l1_cache->stats.cache = l1_cache;
-    dprint_info("%s init successful\n", CACHE_GET_NAME(l1_cache));
-
-
-    /* Init victim cache. */
-    if (cache_util_is_victim_present()) {
-        strncpy(vic_cache->name, g_vic_name, (CACHE_NAME_LEN - 1));
-        strncpy(vic_cache->trace_file, trace_file,
-                (CACHE_TRACE_FILE_LEN - 1));
-        vic_cache->size = victim_size;
-        vic_cache->level = CACHE_LEVEL_L1_VICTIM;
-        vic_cache->blk_size = blk_size;
-        vic_cache->repl_plcy = CACHE_REPL_PLCY_LRU;
-        vic_cache->write_plcy = CACHE_WRITE_PLCY_WBWA;
-        vic_cache->stats.cache = vic_cache;
-        vic_cache->set_assoc = /* VC is a fully associative cache. */
-            (vic_cache->size / vic_cache->blk_size);
-        dprint_info("%s init successful\n", CACHE_GET_NAME(vic_cache));
+    memset(&g_l1_cache, 0, sizeof(g_l1_cache));
+    memset(&g_l2_cache, 0, sizeof(g_l2_cache));
+    memset(&g_vic_cache, 0, sizeof(g_vic_cache));
+    memset(g_lx_caches, 0, sizeof(g_lx_caches));
+
+    g_l2_present = ((config->num_levels > 1) ? TRUE : FALSE);
+    g_victim_present = (config->victim_size ? TRUE : FALSE);
+    g_cache_mem_latency = config->mem_latency;
+    g_cache_addr_bits = (config->addr_bits ?
+            config->addr_bits : CACHE_ADDR_DEFAULT_BITS);
+
+    for (iter = 0; iter < config->num_levels; ++iter) {
+        level = &config->levels[iter];
+        cache = cache_util_get_level(iter + 1);
+
+        if (CACHE_LEVEL_1 == (iter + 1))
+            strncpy(cache->name, g_l1_name, (CACHE_NAME_LEN - 1));
+        else if (CACHE_LEVEL_2 == (iter + 1))
+            strncpy(cache->name, g_l2_name, (CACHE_NAME_LEN - 1));
+        else
+            snprintf(cache->name, CACHE_NAME_LEN, "L%u", (iter + 1));
+
+        if (config->trace_file && (CACHE_LEVEL_1 == (iter + 1)))
+            strncpy(cache->trace_file, config->trace_file,
+                    (CACHE_TRACE_FILE_LEN - 1));
+        cache->size = level->size;
+        cache->level = (iter + 1);
+        cache->set_assoc = level->set_assoc;
+        cache->blk_size = level->blk_size;
+        cache->repl_plcy = level->repl_plcy;
+        cache->write_plcy = level->write_plcy;
+        cache->hit_latency = level->hit_latency;
+        cache->stats.cache = cache;
+
+        /* L1 sees every reference; set sampling is for the big levels. */
+        if (CACHE_LEVEL_1 != (iter + 1))
+            cache->set_sample = config->set_sample;
+
+        /* Only L1 can have a victim cache. */
+        if (CACHE_LEVEL_1 == (iter + 1))
+            cache->victim_size = config->victim_size;
+
+        /* Link the previous level to this one. */
+        if (prev) {
+            prev->next_cache = cache;
+            cache->prev_cache = prev;
+        }
+        prev = cache;
+
+        /* If VC is present, it sits between L1 and the next level. */
+        if ((CACHE_LEVEL_1 == (iter + 1)) && cache_util_is_victim_present()) {
+            vic_cache = &g_vic_cache;
+            strncpy(vic_cache->name, g_vic_name, (CACHE_NAME_LEN - 1));
+            if (config->trace_file)
+                strncpy(vic_cache->trace_file, config->trace_file,
+                        (CACHE_TRACE_FILE_LEN - 1));
+            vic_cache->size = config->victim_size;
+            vic_cache->level = CACHE_LEVEL_L1_VICTIM;
+            vic_cache->blk_size = level->blk_size;
+            vic_cache->repl_plcy = CACHE_REPL_PLCY_LRU;
+            vic_cache->write_plcy = CACHE_WRITE_PLCY_WBWA;
+            vic_cache->hit_latency = config->victim_hit_latency;
+            vic_cache->stats.cache = vic_cache;
+            vic_cache->set_assoc = /* VC is a fully associative cache. */
+                (vic_cache->size / vic_cache->blk_size);
+
+            cache->next_cache = vic_cache;
+            vic_cache->prev_cache = cache;
+            prev = vic_cache;
+        }
     }
 
-    /* Init L2 cache. */
-    if (cache_util_is_l2_present()) {
-        strncpy(l2_cache->name, g_l2_name, (CACHE_NAME_LEN - 1));
-        l2_cache->size = l2_size;
-        l2_cache->level = CACHE_LEVEL_2;
-        l2_cache->set_assoc = l2_set_assoc;
-        l2_cache->blk_size = blk_size;
-        l2_cache->victim_size = 0;      /* No victim cache for L2 */
-        l2_cache->repl_plcy = CACHE_REPL_PLCY_LRU;
-        l2_cache->write_plcy = CACHE_WRITE_PLCY_WBWA;
-        l2_cache->stats.cache = l2_cache;
-        dprint_info("%s init successful\n", CACHE_GET_NAME(l2_cache));
+    /* Now that the hierarchy is in place, set up all the tagstores. */
+    for (iter = 0; iter < config->num_levels; ++iter)
+        cache_tagstore_init(cache_util_get_level(iter + 1),
+                cache_util_get_level_tagstore(iter + 1));
+    if (cache_util_is_victim_present())
+        cache_tagstore_init(&g_vic_cache, &g_vic_cache_ts);
+
+    /* Attach the prefetchers, if any. */
+    for (iter = 0; iter < config->num_levels; ++iter) {
+        level = &config->levels[iter];
+        if (CACHE_PF_NONE != level->pf_type)
+            cache_prefetch_init(cache_util_get_level(iter + 1),
+                    level->pf_type, level->pf_degree);
     }
 
-    /* Set the previous and next caches. */
-    if (cache_util_is_victim_present()) {
-        l1_cache->prev_cache = NULL;
-        l1_cache->next_cache = vic_cache;
-        vic_cache->prev_cache = l1_cache;
-        vic_cache->next_cache = NULL;
-
-        if (cache_util_is_l2_present()) {
-            vic_cache->next_cache = l2_cache;
-            l2_cache->prev_cache = vic_cache;
-            l2_cache->next_cache = NULL;
-        }
-    } else if (cache_util_is_l2_present()) {
-        l1_cache->prev_cache = NULL;
-        l1_cache->next_cache = l2_cache;
-        l2_cache->prev_cache = l1_cache;
-        l2_cache->next_cache = NULL;
-    }
+    dprint_info("%u level cache hierarchy init successful\n",
+            config->num_levels);
 
 exit:
     return;
@@ -233,9 +247,21 @@ cache_tagstore_init(cache_generic_t *cache, cache_tagstore_t *tagstore)
         util_log_base_2(cache->blk_size);
     tagstore->num_index_bits = index_bits = 
         util_log_base_2(num_sets);
-    tagstore->num_tag_bits = tag_bits = (CACHE_ADDR_32BIT_LEN - 
+    tagstore->num_tag_bits = tag_bits = (g_cache_addr_bits - 
             index_bits - blk_offset_bits);
     tagstore->num_blocks_per_set = num_blocks_per_set = cache->set_assoc;
+
+    /*
+     * Set sampling: only every 2^sample_bits th set is simulated and kept,
+     * in a compressed index. Tags and index bits stay the same as for the
+     * full cache.
+     */
+    if (cache->set_sample > 1) {
+        tagstore->num_sample_bits = util_log_base_2(
+                ((cache->set_sample < num_sets) ? cache->set_sample : num_sets));
+        tagstore->num_sets = num_sets =
+            (num_sets >> tagstore->num_sample_bits);
+    }
     tagstore->num_blocks = num_sets * num_blocks_per_set;
 
     /* Allocate memory to store indices, tags and tag data. */ 
@@ -244,12 +270,82 @@ cache_tagstore_init(cache_generic_t *cache, cache_tagstore_t *tagstore)
         calloc(1, (num_sets * sizeof(uint32_t)));
     tagstore->tags = 
         calloc(1, (num_sets * num_blocks_per_set * sizeof (uint32_t)));
+
+    /*
+     * Tags wider than 32 bits keep only the bytes they need above the
+     * first 32 bits in a separate array, e.g. 1 byte for a 38-bit tag.
+     */
+    if (tag_bits > CACHE_TAG_LO_BITS) {
+        tagstore->num_tag_hi_bytes = ((tag_bits - CACHE_TAG_LO_BITS + 7) / 8);
+        tagstore->tags_hi = calloc(1, (num_sets * num_blocks_per_set *
+                    tagstore->num_tag_hi_bytes));
+        if (!tagstore->tags_hi) {
+            dprint("Error: Unable to allocate memory for cache %s tags.\n",
+                    CACHE_GET_NAME(cache));
+            cache_assert(0);
+            goto fatal_exit;
+        }
+    }
     tagstore->tag_data = 
         calloc(1, (num_sets * num_blocks_per_set * 
                     sizeof (*(tagstore->tag_data))));
     tagstore->set_ref_count = calloc(1, (num_sets * sizeof(uint32_t)));
+    tagstore->set_valid_count = calloc(1, (num_sets * sizeof(uint32_t)));
+
+    /*
+     * Recency order of the valid blocks of each set, MRU first, as a
+     * doubly linked list of block IDs; all the lists start out empty.
+     */
+    tagstore->mru_head = malloc(num_sets * sizeof(uint32_t));
+    tagstore->mru_next = malloc(tagstore->num_blocks * sizeof(uint32_t));
+    tagstore->mru_prev = malloc(tagstore->num_blocks * sizeof(uint32_t));
+    if ((!tagstore->mru_head) || (!tagstore->mru_next) ||
+            (!tagstore->mru_prev)) {
+        dprint("Error: Unable to allocate memory for cache %s recency "
+                "lists.\n", CACHE_GET_NAME(cache));
+        cache_assert(0);
+        goto fatal_exit;
+    }
+    memset(tagstore->mru_head, 0xff, (num_sets * sizeof(uint32_t)));
+    memset(tagstore->mru_next, 0xff, (tagstore->num_blocks * sizeof(uint32_t)));
+    memset(tagstore->mru_prev, 0xff, (tagstore->num_blocks * sizeof(uint32_t)));
+
+    /*
+     * The sampled sets are the sampling units, so their refs and misses
+     * are kept apart for the confidence interval of the miss ratio.
+     */
+    if (tagstore->num_sample_bits) {
+        tagstore->sample_refs = calloc(num_sets, sizeof(uint32_t));
+        tagstore->sample_misses = calloc(num_sets, sizeof(uint32_t));
+        if ((!tagstore->sample_refs) || (!tagstore->sample_misses)) {
+            dprint("Error: Unable to allocate memory for cache %s sample "
+                    "stats.\n", CACHE_GET_NAME(cache));
+            cache_assert(0);
+            goto fatal_exit;
+        }
+    }
 
-    if ((!tagstore->index) || (!tagstore->tags) || (!tagstore->tag_data)) {
+    /*
+     * For fully/highly associative caches, keep a hash index of the tags
+     * so that a lookup doesn't have to scan the whole set. The index is
+     * kept at most half full for short probe sequences.
+     */
+    if (g_tag_index_present &&
+            (num_blocks_per_set >= CACHE_TAG_INDEX_MIN_ASSOC)) {
+        tagstore->tag_index_bits = 
+            (util_log_base_2(tagstore->num_blocks) + 2);
+        tagstore->tag_index = calloc((1U << tagstore->tag_index_bits),
+                sizeof(*(tagstore->tag_index)));
+        if (!tagstore->tag_index) {
+            dprint("Error: Unable to allocate memory for cache %s tag "
+                    "index.\n", CACHE_GET_NAME(cache));
+            cache_assert(0);
+            goto fatal_exit;
+        }
+    }
+
+    if ((!tagstore->index) || (!tagstore->tags) || (!tagstore->tag_data) ||
+            (!tagstore->set_valid_count)) {
         dprint("Error: Unable to allocate memory for cache %s tagstore.\n",
                 CACHE_GET_NAME(cache));
         cache_assert(0);
@@ -298,8 +394,12 @@ cache_cleanup(cache_generic_t *cache)
         goto exit;
     }
 
-    /* First cleanup the tagstore and then the actual cache. */
+    /* First cleanup the tagstore and MSHRs and then the actual cache. */
     cache_tagstore_cleanup(cache, cache->tagstore);
+    if (cache->mshr)
+        cache_mshr_cleanup(cache);
+    if (cache->prefetcher)
+        cache_prefetch_cleanup(cache);
     memset(cache, 0, sizeof(*cache));
 
 exit:
@@ -334,6 +434,8 @@ cache_tagstore_cleanup(cache_generic_t *cache, cache_tagstore_t *tagstore)
 
     if (tagstore->tags)
         free(tagstore->tags);
+    if (tagstore->tags_hi)
+        free(tagstore->tags_hi);
 
     if (tagstore->tag_data)
         free(tagstore->tag_data);
@@ -341,6 +443,18 @@ cache_tagstore_cleanup(cache_generic_t *cache, cache_tagstore_t *tagstore)
     if (tagstore->set_ref_count)
         free(tagstore->set_ref_count);
 
+    if (tagstore->set_valid_count)
+        free(tagstore->set_valid_count);
+
+    if (tagstore->tag_index)
+        free(tagstore->tag_index);
+
+    free(tagstore->mru_head);
+    free(tagstore->mru_next);
+    free(tagstore->mru_prev);
+    free(tagstore->sample_refs);
+    free(tagstore->sample_misses);
+
     memset(tagstore, 0, sizeof(*tagstore));
 
 exit:
@@ -437,9 +551,6 @@ cache_get_lfu_block(cache_tagstore_t *tagstore, mem_ref_t *mref,
     uint32_t            num_blocks = 0;
     uint32_t            tag_index = 0;
     uint32_t            min_ref_count = 0;
-#ifdef DBG_ON
-    uint32_t            *tags = NULL;
-#endif /* DBG_ON */
     cache_tag_data_t    *tag_data = NULL;
 
     if ((!tagstore) || (!mref) || (!line)) {
@@ -449,9 +560,6 @@ cache_get_lfu_block(cache_tagstore_t *tagstore, mem_ref_t *mref,
 
     num_blocks = tagstore->num_blocks_per_set;
     tag_index = (line->index * num_blocks);
-#ifdef DBG_ON
-    tags = &tagstore->tags[tag_index];
-#endif /* DBG_ON */
     tag_data = &tagstore->tag_data[tag_index];
 
     for (block_id = 0, min_ref_count = tag_data[block_id].ref_count; 
@@ -466,8 +574,9 @@ cache_get_lfu_block(cache_tagstore_t *tagstore, mem_ref_t *mref,
 #ifdef DBG_ON
     printf("LFU index %u\n", line->index);
     for (block_id = 0; block_id < num_blocks; ++block_id) {
-        printf("    block %u, tag 0x%x, valid %u, ref_count %u\n",
-                block_id, tags[block_id], tag_data[block_id].valid, 
+        printf("    block %u, tag 0x%" PRIx64 ", valid %u, ref_count %u\n",
+                block_id, cache_tagstore_get_tag(tagstore,
+                    (tag_index + block_id)), tag_data[block_id].valid, 
                 tag_data[block_id].ref_count);
     }
     printf("min_block %u, min_ref_count %u\n", min_block_id, min_ref_count);
@@ -480,6 +589,333 @@ error_exit:
 }
 
 
+/***************************************************************************
+ * Name:    cache_tag_index_hash
+ *
+ * Desc:    Hashes <set index, tag> to a slot in the tag index. Fibonacci
+ *          hashing; the top bits of the product are the best mixed.
+ *
+ * Params:
+ *  tagstore    ptr to the cache tagstore
+ *  index       set index of the block
+ *  tag         tag of the block
+ *
+ * Returns: uint32_t
+ *  Home slot of the block in the tag index
+ **************************************************************************/
+static inline uint32_t
+cache_tag_index_hash(cache_tagstore_t *tagstore, uint32_t index,
+        cache_tag_t tag)
+{
+    uint64_t key = ((((uint64_t) index) << 32) ^ tag);
+
+    return (uint32_t) ((key * 0x9E3779B97F4A7C15ULL) >>
+            (64 - tagstore->tag_index_bits));
+}
+
+
+/***************************************************************************
+ * Name:    cache_tag_index_lookup
+ *
+ * Desc:    Looks up a tag in the tag index (open addressing, linear
+ *          probing).
+ *
+ * Params:
+ *  tagstore    ptr to the cache tagstore
+ *  index       set index of the block
+ *  tag         tag of the block
+ *
+ * Returns: int32_t
+ *  ID of the block within the set on a match
+ *  CACHE_RV_ERR if no match is found
+ **************************************************************************/
+static inline int32_t
+cache_tag_index_lookup(cache_tagstore_t *tagstore, uint32_t index,
+        cache_tag_t tag)
+{
+    uint32_t            mask = ((1U << tagstore->tag_index_bits) - 1);
+    uint32_t            slot = cache_tag_index_hash(tagstore, index, tag);
+    cache_tag_index_t   *tag_index = tagstore->tag_index;
+
+    for (; tag_index[slot].block_id; slot = ((slot + 1) & mask)) {
+        if ((tag_index[slot].tag == tag) && (tag_index[slot].index == index))
+            return (tag_index[slot].block_id - 1);
+    }
+    return CACHE_RV_ERR;
+}
+
+
+/***************************************************************************
+ * Name:    cache_tag_index_insert
+ *
+ * Desc:    Adds a block to the tag index.
+ *
+ * Params:
+ *  tagstore    ptr to the cache tagstore
+ *  index       set index of the block
+ *  tag         tag of the block
+ *  block_id    ID of the block within the set
+ *
+ * Returns: Nothing
+ **************************************************************************/
+static inline void
+cache_tag_index_insert(cache_tagstore_t *tagstore, uint32_t index,
+        cache_tag_t tag, uint32_t block_id)
+{
+    uint32_t            mask = ((1U << tagstore->tag_index_bits) - 1);
+    uint32_t            slot = cache_tag_index_hash(tagstore, index, tag);
+    cache_tag_index_t   *tag_index = tagstore->tag_index;
+
+    while (tag_index[slot].block_id)
+        slot = ((slot + 1) & mask);
+
+    tag_index[slot].tag = tag;
+    tag_index[slot].index = index;
+    tag_index[slot].block_id = (block_id + 1);
+    return;
+}
+
+
+/***************************************************************************
+ * Name:    cache_tag_index_remove
+ *
+ * Desc:    Removes a block from the tag index. Entries following the
+ *          removed slot in the probe sequence are shifted back, so that
+ *          the index never needs tombstones.
+ *
+ * Params:
+ *  tagstore    ptr to the cache tagstore
+ *  index       set index of the block
+ *  tag         tag of the block
+ *
+ * Returns: Nothing
+ **************************************************************************/
+static inline void
+cache_tag_index_remove(cache_tagstore_t *tagstore, uint32_t index,
+        cache_tag_t tag)
+{
+    uint32_t            mask = ((1U << tagstore->tag_index_bits) - 1);
+    uint32_t            slot = cache_tag_index_hash(tagstore, index, tag);
+    uint32_t            next = 0;
+    uint32_t            home = 0;
+    cache_tag_index_t   *tag_index = tagstore->tag_index;
+
+    for (; tag_index[slot].block_id; slot = ((slot + 1) & mask)) {
+        if ((tag_index[slot].tag == tag) && (tag_index[slot].index == index))
+            break;
+    }
+
+    if (!tag_index[slot].block_id) {
+        cache_assert(0);
+        return;
+    }
+
+    for (next = ((slot + 1) & mask); tag_index[next].block_id;
+            next = ((next + 1) & mask)) {
+        home = cache_tag_index_hash(tagstore, tag_index[next].index,
+                tag_index[next].tag);
+
+        /* Move the entry back only if its home isn't in (slot, next]. */
+        if (((next - home) & mask) >= ((next - slot) & mask)) {
+            tag_index[slot] = tag_index[next];
+            slot = next;
+        }
+    }
+    tag_index[slot].block_id = 0;
+    return;
+}
+
+
+/***************************************************************************
+ * Name:    cache_tagstore_get_tag
+ *
+ * Desc:    Returns the full tag of a block, putting together its low 32
+ *          bits and the extra bytes of wide tags.
+ *
+ * Params:
+ *  tagstore    ptr to the cache tagstore
+ *  tag_index   index of the block in the tag array
+ *
+ * Returns: cache_tag_t
+ *  Tag of the block
+ **************************************************************************/
+cache_tag_t
+cache_tagstore_get_tag(cache_tagstore_t *tagstore, uint32_t tag_index)
+{
+    uint8_t     iter = 0;
+    uint8_t     *tag_hi = NULL;
+    cache_tag_t tag = tagstore->tags[tag_index];
+
+    tag_hi = &tagstore->tags_hi[tag_index * tagstore->num_tag_hi_bytes];
+    for (iter = 0; iter < tagstore->num_tag_hi_bytes; ++iter)
+        tag |= (((cache_tag_t) tag_hi[iter]) <<
+                (CACHE_TAG_LO_BITS + (8 * iter)));
+    return tag;
+}
+
+
+/***************************************************************************
+ * Name:    cache_tagstore_set_tag
+ *
+ * Desc:    Places a tag in the given block and marks the block valid. All
+ *          tag fills go thru here, so that the valid counts and the tag
+ *          index stay in sync with the tag array.
+ *
+ * Params:
+ *  tagstore    ptr to the cache tagstore
+ *  index       set index of the block
+ *  block_id    ID of the block within the set
+ *  tag         new tag for the block
+ *
+ * Returns: Nothing
+ **************************************************************************/
+void
+cache_tagstore_set_tag(cache_tagstore_t *tagstore, uint32_t index,
+        uint32_t block_id, cache_tag_t tag)
+{
+    uint8_t             iter = 0;
+    uint8_t             *tag_hi = NULL;
+    uint32_t            tag_index = 0;
+    cache_tag_data_t    *tag_data = NULL;
+
+    tag_index = ((index * tagstore->num_blocks_per_set) + block_id);
+    tag_data = &tagstore->tag_data[tag_index];
+
+    if (tag_data->valid) {
+        if (tagstore->tag_index)
+            cache_tag_index_remove(tagstore, index,
+                    cache_tagstore_get_tag(tagstore, tag_index));
+    } else {
+        tagstore->set_valid_count[index] += 1;
+    }
+
+    tagstore->tags[tag_index] = (uint32_t) tag;
+    tag_hi = &tagstore->tags_hi[tag_index * tagstore->num_tag_hi_bytes];
+    for (iter = 0; iter < tagstore->num_tag_hi_bytes; ++iter)
+        tag_hi[iter] = (uint8_t) (tag >> (CACHE_TAG_LO_BITS + (8 * iter)));
+
+    tag_data->valid = 1;
+    tag_data->prefetched = 0;
+    if (tagstore->tag_index)
+        cache_tag_index_insert(tagstore, index, tag, block_id);
+    return;
+}
+
+
+/* A valid block and its age, for sorting the blocks of a tagstore by age */
+typedef struct cache_block_age__ {
+    uint64_t    age;
+    uint32_t    tag_index;
+} cache_block_age_t;
+
+
+/***************************************************************************
+ * Name:    cache_compare_block_age
+ *
+ * Desc:    qsort callback; orders blocks by increasing age.
+ *
+ * Params:
+ *  a, b    ptrs to the cache_block_age_t to compare
+ *
+ * Returns: int
+ *  < 0, 0 or > 0 if a is younger than, as old as or older than b
+ **************************************************************************/
+static int
+cache_compare_block_age(const void *a, const void *b)
+{
+    const cache_block_age_t *loc_a = (const cache_block_age_t *) a;
+    const cache_block_age_t *loc_b = (const cache_block_age_t *) b;
+
+    if (loc_a->age == loc_b->age)
+        return 0;
+    return ((loc_a->age < loc_b->age) ? -1 : 1);
+}
+
+
+/***************************************************************************
+ * Name:    cache_tagstore_rebuild
+ *
+ * Desc:    Recomputes the derived tagstore state (valid block count per set,
+ *          the tag index and the recency lists) from the tag array and tag
+ *          data. Used after the tags are loaded wholesale, e.g. from a
+ *          snapshot. Prefetch marks are dropped; their ready cycles belong
+ *          to the old run.
+ *
+ * Params:
+ *  tagstore    ptr to the cache tagstore
+ *
+ * Returns: Nothing
+ **************************************************************************/
+void
+cache_tagstore_rebuild(cache_tagstore_t *tagstore)
+{
+    uint32_t            index = 0;
+    uint32_t            block_id = 0;
+    uint32_t            tag_index = 0;
+    uint32_t            num_valid = 0;
+    uint32_t            iter = 0;
+    cache_block_age_t   *blocks = NULL;
+
+    if (!tagstore) {
+        cache_assert(0);
+        goto exit;
+    }
+
+    blocks = (cache_block_age_t *)
+        malloc(tagstore->num_blocks * sizeof(*blocks));
+    if (!blocks) {
+        dprint("Error: Unable to allocate memory for tagstore rebuild.\n");
+        cache_assert(0);
+        goto fatal_exit;
+    }
+    memset(tagstore->mru_head, 0xff, (tagstore->num_sets * sizeof(uint32_t)));
+    memset(tagstore->mru_next, 0xff, (tagstore->num_blocks * sizeof(uint32_t)));
+    memset(tagstore->mru_prev, 0xff, (tagstore->num_blocks * sizeof(uint32_t)));
+
+    if (tagstore->tag_index)
+        memset(tagstore->tag_index, 0, ((1U << tagstore->tag_index_bits) *
+                    sizeof(*(tagstore->tag_index))));
+
+    for (index = 0; index < tagstore->num_sets; ++index) {
+        tagstore->set_valid_count[index] = 0;
+        for (block_id = 0; block_id < tagstore->num_blocks_per_set;
+                ++block_id) {
+            tag_index = ((index * tagstore->num_blocks_per_set) + block_id);
+            tagstore->tag_data[tag_index].prefetched = 0;
+            tagstore->tag_data[tag_index].pf_ready_cycle = 0;
+            if (!tagstore->tag_data[tag_index].valid)
+                continue;
+
+            tagstore->set_valid_count[index] += 1;
+            if (tagstore->tag_index)
+                cache_tag_index_insert(tagstore, index,
+                        cache_tagstore_get_tag(tagstore, tag_index), block_id);
+
+            blocks[num_valid].age = tagstore->tag_data[tag_index].age;
+            blocks[num_valid].tag_index = tag_index;
+            num_valid += 1;
+        }
+    }
+
+    /* Touching the blocks from the oldest up leaves each set MRU first. */
+    qsort(blocks, num_valid, sizeof(*blocks), cache_compare_block_age);
+    for (iter = 0; iter < num_valid; ++iter) {
+        tag_index = blocks[iter].tag_index;
+        cache_util_touch_block(tagstore,
+                (tag_index / tagstore->num_blocks_per_set),
+                (tag_index % tagstore->num_blocks_per_set), blocks[iter].age);
+    }
+    free(blocks);
+
+exit:
+    return;
+
+fatal_exit:
+    /* Fatal exit. Quit the program. */
+    exit(-1);
+}
+
+
 /*************************************************************************** 
  * Name:    cache_get_first_invalid_block
  *
@@ -516,14 +952,20 @@ cache_get_first_invalid_block(cache_tagstore_t *tagstore, cache_line_t *line)
     tag_index = (line->index * num_blocks);
     tag_data = &tagstore->tag_data[tag_index];
 
-    for (block_id = 0; block_id < num_blocks; ++block_id) {
-        if (!tag_data[block_id].valid) {
+    /*
+     * Blocks are never invalidated once filled and an invalid block is
+     * always filled in block order. So, the valid blocks of a set are
+     * always blocks 0 thru (set_valid_count - 1) and the first invalid
+     * block is just the valid count.
+     */
+    block_id = tagstore->set_valid_count[line->index];
+    if (block_id < num_blocks) {
+        cache_assert(!tag_data[block_id].valid);
 #ifdef DBG_ON
-            dprint_info("index %u, invalid block %u selected from %s\n", 
-                    line->index, block_id, CACHE_GET_NAME(cache));
+        dprint_info("index %u, invalid block %u selected from %s\n", 
+                line->index, block_id, CACHE_GET_NAME(cache));
 #endif /* DBG_ON */
-            return block_id;
-        }
+        return block_id;
     }
 
 error_exit:
@@ -565,12 +1007,19 @@ cache_does_tag_match(cache_tagstore_t *tagstore, cache_line_t *line)
     tags = &tagstore->tags[tag_index];
     tag_data = &tagstore->tag_data[tag_index];
 
+    /* Highly associative caches have a hash index on the tags. */
+    if (tagstore->tag_index)
+        return cache_tag_index_lookup(tagstore, line->index, line->tag);
+
     /*
      * Go over all the valid blocks for this set and compare the incoming tag
      * with the tag in tagstore. Return ture on a match and false otherwise.
      */
     for (block_id = 0; block_id < num_blocks; ++block_id) {
-        if ((tag_data[block_id].valid) && (tags[block_id] == line->tag))
+        if ((tag_data[block_id].valid) &&
+                (tags[block_id] == (uint32_t) line->tag) &&
+                ((!tagstore->tags_hi) || (line->tag ==
+                    cache_tagstore_get_tag(tagstore, (tag_index + block_id)))))
             return block_id;
     }
 
@@ -585,7 +1034,6 @@ cache_write_to_victim(cache_generic_t *vc, mem_ref_t *write_ref, boolean dirty)
 {
     int32_t             block_id = -1;
     uint32_t            tag_index = 0;
-    uint32_t            *tags = NULL;
     uint64_t            curr_age = 0;
     cache_line_t        line;
     cache_tag_data_t    *tag_data = NULL;
@@ -606,16 +1054,15 @@ cache_write_to_victim(cache_generic_t *vc, mem_ref_t *write_ref, boolean dirty)
         block_id = cache_evict_tag(vc, write_ref, &line);
 
     tag_index = (line.index * vc_ts->num_blocks_per_set);
-    tags = &vc_ts->tags[tag_index];
     tag_data = &vc_ts->tag_data[tag_index];
 
-    curr_age = util_get_curr_time();
-    tags[block_id] = line.tag;
-    tag_data[block_id].valid = 1;
-    tag_data[block_id].age = curr_age;
+    curr_age = util_get_next_age();
+    cache_tagstore_set_tag(vc_ts, line.index, block_id, line.tag);
+    cache_util_touch_block(vc_ts, line.index, block_id, curr_age);
     tag_data[block_id].dirty = dirty;
 
-    dprint_dp("%s, writing from L1, VC TAG %x, INDEX %u, BLOCK %d, DIRTY %u\n",
+    dprint_dp("%s, writing from L1, VC TAG %" PRIx64 ", INDEX %u, BLOCK %d, "
+            "DIRTY %u\n",
             CACHE_GET_NAME(vc), line.tag, line.index, block_id, dirty);
 
 exit:
@@ -643,7 +1090,7 @@ void
 cache_handle_dirty_tag_evicts(cache_generic_t *cache, mem_ref_t *mem_ref, 
         uint32_t block_id)
 {
-    uint16_t            latency = 0;
+    uint32_t            latency = 0;
     uint32_t            tag_index = 0;
     uint32_t            *tags = NULL;
     cache_line_t        line;
@@ -679,10 +1126,12 @@ cache_handle_dirty_tag_evicts(cache_generic_t *cache, mem_ref_t *mem_ref,
          */
         memset(&write_line, 0, sizeof(write_line));
         memset(&write_ref, 0, sizeof(write_ref));
-        write_line.tag = tags[block_id];;
+        write_line.tag = cache_tagstore_get_tag(tagstore,
+                (tag_index + block_id));
         write_line.index = line.index;
         cache_util_encode_mem_addr(tagstore, &write_line, &write_ref);
         write_ref.ref_type = MEM_REF_TYPE_WRITE;
+        write_ref.ref_src = MEM_REF_SRC_WBACK;
 
         if (CACHE_IS_VC(cache->next_cache)) {
             boolean dirty = FALSE;
@@ -693,7 +1142,8 @@ cache_handle_dirty_tag_evicts(cache_generic_t *cache, mem_ref_t *mem_ref,
             goto exit;
         }
 
-        dprint_dp("LRU WRITE TO %s, TAG %x, INDEX %u, BLOCK %d, DIRTY %u\n",
+        dprint_dp("LRU WRITE TO %s, TAG %" PRIx64 ", INDEX %u, BLOCK %d, "
+                "DIRTY %u\n",
             CACHE_GET_NAME(cache->next_cache), line.tag, line.index, block_id, 
             cache_util_is_block_dirty(tagstore, &line, block_id));
 
@@ -825,72 +1275,612 @@ error_exit:
 }
 
 
-/*************************************************************************** 
- * Name:    cache_evict_and_add_tag 
+/***************************************************************************
+ * Name:    cache_write_through
  *
- * Desc:    Core processing routine. It does one (and only one) of the 
- *          following for every memory reference:
- *          1. If the tag is already present, we are done here. Might have to
- *              write thru for a write request if the write policy is set to 
- *              WTNA.
- *          2. If a free block is available, place the tag in that block. 
- *          3. Evict a block (based on the eviction policy set), do a write
- *              back (if evicted block is dirty) and place the incoming tag
- *              on the block.
+ * Desc:    Writes a reference thru to the level below a WTNA cache. The
+ *          victim cache is skipped; it only holds L1 evictions, which are
+ *          never dirty under WTNA.
  *
- *          For all three operations above, we need to update read/write, 
- *          miss/hit counters, valid, dirty (for writes) and age for the block.
+ * Params:
+ *  cache       ptr to the WTNA cache
+ *  mref        ptr to the write reference
+ *  latency     ptr to store the latency of the write at the level below
+ *
+ * Returns: Nothing
+ **************************************************************************/
+static void
+cache_write_through(cache_generic_t *cache, mem_ref_t *mref,
+        uint32_t *latency)
+{
+    mem_ref_t       write_ref;
+    cache_generic_t *next_cache = NULL;
+
+    next_cache = cache->next_cache;
+    if (next_cache && CACHE_IS_VC(next_cache))
+        next_cache = next_cache->next_cache;
+
+    if (next_cache) {
+        memcpy(&write_ref, mref, sizeof(write_ref));
+        write_ref.ref_type = MEM_REF_TYPE_WRITE;
+        cache_evict_and_add_tag(next_cache, &write_ref, latency);
+    } else {
+        *latency = g_cache_mem_latency;
+    }
+    cache->stats.num_blk_mem_traffic += 1;
+    return;
+}
+
+
+/***************************************************************************
+ * Name:    cache_handle_tag_hit
+ *
+ * Desc:    Updates the block state, hit counters and latency for a cache
+ *          hit. Read/write counters are updated by the caller.
  *
  * Params:
- *  in_cache    ptr to cache
- *  mem_ref     ptr to the memory reference (type and address)
+ *  cache       ptr to the cache
+ *  mref        ptr to the memory reference
+ *  line        ptr to the decoded cache line
+ *  block_id    ID of the block which hit
+ *  curr_age    age of this reference
+ *  latency     ptr to store the latency of the reference
  *
- * Returns: Nothing.
+ * Returns: boolean
+ *  TRUE if this is the first use of a prefetched block
+ *  FALSE otherwise
  **************************************************************************/
-void
-cache_evict_and_add_tag(cache_generic_t *cache, mem_ref_t *mref,
-        uint16_t *latency)
+static inline boolean
+cache_handle_tag_hit(cache_generic_t *cache, mem_ref_t *mref,
+        cache_line_t *line, int32_t block_id, uint64_t curr_age,
+        uint32_t *latency)
 {
-    uint8_t             read_flag = FALSE;
-    int32_t             block_id = 0;
-    uint32_t            tag_index = 0;
-    uint32_t            *tags = NULL;
-    uint64_t            curr_age;
-    cache_line_t        line;
+    uint32_t            wt_latency = 0;
     cache_tag_data_t    *tag_data = NULL;
-    cache_tagstore_t    *tagstore = NULL;
 
-    if ((!cache) || (!mref)) {
-        cache_assert(0);
-        goto exit;
-    }
-    tagstore = cache->tagstore;
+    tag_data = &cache->tagstore->tag_data[(line->index * 
+            cache->tagstore->num_blocks_per_set) + block_id];
 
-    /* Fetch the current time to be used for tag age (for LRU). */
-    curr_age = util_get_curr_time(); 
+    /* Hit latencies are totals, as seen by the pipeline. */
+    *latency = cache->hit_latency;
 
-    /* Decode the memmory reference to the current cache's cache line. */
-    memset(&line, 0, sizeof(line));
-    cache_util_decode_mem_addr(tagstore, mref->ref_addr, &line);
+    dprint_dbg("HIT %s\n", CACHE_GET_NAME(cache));
+    dprint_info("cache hit for cache %s, tag 0x%" PRIx64 " at index %u, "
+            "block %u\n",
+            CACHE_GET_NAME(cache), line->tag, line->index, block_id);
+    tag_data->valid = 1;
+    cache_util_touch_block(cache->tagstore, line->index, block_id, curr_age);
+    tag_data->ref_count += 1;
 
-    /* Fetch the appropriate set within the tagstore. */
-    tag_index = (line.index * tagstore->num_blocks_per_set);
-    tags = &tagstore->tags[tag_index];
-    tag_data = &tagstore->tag_data[tag_index];
-    read_flag = (IS_MEM_REF_READ(mref) ? TRUE : FALSE);
+    if (IS_MEM_REF_READ(mref)) {
+        cache->stats.num_read_hits += 1;
+    } else {
+        cache->stats.num_write_hits += 1;
 
-    if (read_flag)
-        cache->stats.num_reads += 1;
-    else
-        cache->stats.num_writes += 1;
+        /* WBWA dirties the block; WTNA writes it thru, off the hit path. */
+        if (CACHE_WRITE_PLCY_WBWA == CACHE_GET_WRITE_POLICY(cache))
+            tag_data->dirty = 1;
+        else
+            cache_write_through(cache, mref, &wt_latency);
+    }
 
-    /*
-     * Notes
-     * =====
-     *  * Victim cache will only contain entries that were missed in
-     *    L1. There can be no entires in victim cache that weren't missed
-     *    by L1 at any given time.
-     *
+    /* First demand use of a prefetched block; wait if it's still coming. */
+    if (tag_data->prefetched && (MEM_REF_SRC_DEMAND == mref->ref_src)) {
+        tag_data->prefetched = 0;
+        cache->stats.num_pf_useful += 1;
+        if (tag_data->pf_ready_cycle > g_cache_cycle) {
+            cache->stats.num_pf_late += 1;
+            if ((tag_data->pf_ready_cycle - g_cache_cycle) > *latency)
+                *latency = (tag_data->pf_ready_cycle - g_cache_cycle);
+        }
+        return TRUE;
+    }
+    return FALSE;
+}
+
+
+/***************************************************************************
+ * Name:    cache_handle_merged_miss
+ *
+ * Desc:    Handles a secondary miss of a non-blocking cache, which merged
+ *          into the MSHR of an outstanding fill. The primary miss has
+ *          already put the block in the tagstore, so only the block state
+ *          is updated, but the reference is counted as a miss. The MSHR
+ *          makes it wait for the fill. Read/write counters are updated by
+ *          the caller.
+ *
+ * Params:
+ *  cache       ptr to the cache
+ *  mref        ptr to the memory reference
+ *  line        ptr to the decoded cache line
+ *  block_id    ID of the block the primary miss was put in
+ *  curr_age    age of this reference
+ *  latency     ptr to store the latency of the reference
+ *
+ * Returns: Nothing
+ **************************************************************************/
+static inline void
+cache_handle_merged_miss(cache_generic_t *cache, mem_ref_t *mref,
+        cache_line_t *line, int32_t block_id, uint64_t curr_age,
+        uint32_t *latency)
+{
+    uint32_t            wt_latency = 0;
+    cache_tag_data_t    *tag_data = NULL;
+
+    tag_data = &cache->tagstore->tag_data[(line->index * 
+            cache->tagstore->num_blocks_per_set) + block_id];
+
+    *latency = cache->hit_latency;
+    cache_util_touch_block(cache->tagstore, line->index, block_id, curr_age);
+    tag_data->ref_count += 1;
+
+    if (IS_MEM_REF_READ(mref)) {
+        cache->stats.num_read_misses += 1;
+    } else {
+        cache->stats.num_write_misses += 1;
+        if (CACHE_WRITE_PLCY_WBWA == CACHE_GET_WRITE_POLICY(cache))
+            tag_data->dirty = 1;
+        else
+            cache_write_through(cache, mref, &wt_latency);
+    }
+    return;
+}
+
+
+/***************************************************************************
+ * Name:    cache_sample_rand
+ *
+ * Desc:    Returns the next number of a deterministic pseudo random
+ *          sequence (xorshift32), so that set sampled runs are repeatable.
+ *
+ * Params:  None
+ *
+ * Returns: uint32_t
+ *  next pseudo random number
+ **************************************************************************/
+static inline uint32_t
+cache_sample_rand(void)
+{
+    g_cache_sample_rand ^= (g_cache_sample_rand << 13);
+    g_cache_sample_rand ^= (g_cache_sample_rand >> 17);
+    g_cache_sample_rand ^= (g_cache_sample_rand << 5);
+    return g_cache_sample_rand;
+}
+
+
+/***************************************************************************
+ * Name:    cache_handle_unsampled_ref
+ *
+ * Desc:    Handles a reference to a set which is not simulated in a set
+ *          sampled cache. The reference hits or misses with the miss ratio
+ *          seen so far in the sampled sets; a miss is passed on to the next
+ *          level like a regular miss, so latencies and the traffic further
+ *          down are extrapolated as well. WTNA writes always go thru.
+ *
+ * Params:
+ *  cache       ptr to the set sampled cache
+ *  mref        ptr to the memory reference
+ *  latency     ptr to store the latency of the reference
+ *
+ * Returns: Nothing
+ **************************************************************************/
+static void
+cache_handle_unsampled_ref(cache_generic_t *cache, mem_ref_t *mref,
+        uint32_t *latency)
+{
+    boolean         miss = TRUE;
+    boolean         wtna = FALSE;
+    uint32_t        wt_latency = 0;
+    mem_ref_t       read_ref;
+    cache_stats_t   *stats = NULL;
+
+    stats = &cache->stats;
+    wtna = ((!IS_MEM_REF_READ(mref)) &&
+            (CACHE_WRITE_PLCY_WTNA == CACHE_GET_WRITE_POLICY(cache)));
+    if (IS_MEM_REF_READ(mref))
+        stats->num_reads += 1;
+    else
+        stats->num_writes += 1;
+
+    /* Scale a 32-bit random # to [0, sampled refs) and compare. */
+    if (stats->num_sampled_refs)
+        miss = (((((uint64_t) cache_sample_rand()) * stats->num_sampled_refs)
+                    >> 32) < stats->num_sampled_misses);
+
+    if (!miss) {
+        *latency = cache->hit_latency;
+        if (IS_MEM_REF_READ(mref))
+            stats->num_read_hits += 1;
+        else
+            stats->num_write_hits += 1;
+        if (wtna)
+            cache_write_through(cache, mref, &wt_latency);
+        return;
+    }
+
+    if (IS_MEM_REF_READ(mref))
+        stats->num_read_misses += 1;
+    else
+        stats->num_write_misses += 1;
+
+    if (wtna) {
+        cache_write_through(cache, mref, latency);
+        return;
+    }
+    stats->num_blk_mem_traffic += 1;
+
+    if (cache->next_cache) {
+        memcpy(&read_ref, mref, sizeof(read_ref));
+        read_ref.ref_type = MEM_REF_TYPE_READ;
+        cache_evict_and_add_tag(cache->next_cache, &read_ref, latency);
+    } else {
+        *latency = g_cache_mem_latency;
+    }
+    return;
+}
+
+
+/***************************************************************************
+ * Name:    cache_handle_tag_miss
+ *
+ * Desc:    Handles a miss to a sampled set: writes a WTNA write miss
+ *          around the cache, swaps with the victim cache on a VC hit, or
+ *          fetches the block from the next level (or memory) into a free
+ *          or evicted block. Read/write and sampled counters are updated
+ *          by the caller.
+ *
+ * Params:
+ *  cache       ptr to the cache
+ *  mref        ptr to the memory reference
+ *  line        ptr to the decoded cache line
+ *  curr_age    age of this reference
+ *  latency     ptr to store the latency of the reference
+ *
+ * Returns: Nothing
+ **************************************************************************/
+static void
+cache_handle_tag_miss(cache_generic_t *cache, mem_ref_t *mref,
+        cache_line_t *line, uint64_t curr_age, uint32_t *latency)
+{
+    uint8_t             read_flag = FALSE;
+    int32_t             block_id = 0;
+    uint32_t            tag_index = 0;
+    boolean             pf_hit = FALSE;
+    cache_generic_t     *next_cache = NULL;
+    cache_tag_data_t    *tag_data = NULL;
+    cache_tagstore_t    *tagstore = NULL;
+
+    tagstore = cache->tagstore;
+    tag_index = (line->index * tagstore->num_blocks_per_set);
+    tag_data = &tagstore->tag_data[tag_index];
+    read_flag = (IS_MEM_REF_READ(mref) ? TRUE : FALSE);
+
+    /* WTNA doesn't allocate on a write miss; the write goes around. */
+    if ((!read_flag) &&
+            (CACHE_WRITE_PLCY_WTNA == CACHE_GET_WRITE_POLICY(cache))) {
+        cache->stats.num_write_misses += 1;
+        cache_write_through(cache, mref, latency);
+        goto exit;
+    }
+
+    /* 
+     * Cache miss! 
+     * Well, life is not always so good..
+     *
+     * In multi level caches, do the following in case of a cache miss:
+     *  1. If the next level in hierarchy is a cache, check if the 
+     *     requested data is present there. If so, bring in the block
+     *     and follow steps 2/3 for placing the block. i.e., find a
+     *     free block or go for replacement.
+     *  2. If the next level is not a cache (i.e., for last level of
+     *     caches, the next level would be main memory), check if there
+     *     are any free blocks. If so, use those blocks for new data.
+     *  3. If there are no free blocks and if the cache is the last level,
+     *     go for cache replacement.
+     *
+     * For all three cases, first find a block to place the to-be-feched
+     * data block. 
+     */
+    if (CACHE_IS_L1(cache))
+        dprint_dbg("MISS %s\n", CACHE_GET_NAME(cache));
+        dprint_dp("MISS %s, TAG %" PRIx64 "\n", CACHE_GET_NAME(cache),
+                line->tag);
+    dprint_info("cache miss for cache %s, tag 0x%" PRIx64 " @ index %u\n",
+            CACHE_GET_NAME(cache), line->tag, line->index);
+    next_cache = cache->next_cache;
+
+    dprint_info("cache %s, index %u, block %d selected for tag 0x%"
+            PRIx64 "\n",
+            CACHE_GET_NAME(cache), line->index, block_id, line->tag);
+
+    /* 
+     * If VC is present, L1 + VC acts as a single entity to the next memory
+     * level. So, some ugly cache specific code.. which I don't like!
+     */
+    if (CACHE_IS_L1(cache)) {
+        if (cache_util_is_victim_present()) {
+            int32_t             vc_block_id = CACHE_RV_ERR;
+            cache_line_t        vc_line;
+            cache_generic_t     *vc = NULL;
+            cache_tagstore_t    *vc_ts = NULL;
+            cache_stats_t       *vc_stats = NULL;
+
+            vc = cache_util_get_vc(); 
+            vc_ts = vc->tagstore;
+            vc_stats = &vc->stats;
+            memset(&vc_line, 0, sizeof(vc_line));
+            cache_util_decode_mem_addr(vc_ts, mref->ref_addr, &vc_line);
+
+            if (read_flag)
+                vc_stats->num_reads += 1;
+            else
+                vc_stats->num_writes += 1;
+
+            vc_block_id = cache_does_tag_match(vc_ts, &vc_line);
+            if (CACHE_RV_ERR != vc_block_id) {
+                uint8_t             tmp_l1_dirty = 0;
+                uint32_t            vc_tag_index = 0;
+                mem_ref_t           l1_old_ref;
+                cache_line_t        l1_old_line;
+                cache_line_t        vc_tmp_line;
+                cache_tag_data_t    *vc_tag_data;
+
+                dprint_dbg("HIT %s, SWAP\n", CACHE_GET_NAME(vc));
+
+                /* 
+                 * Find a block to place the to-be-fetcheed data. Go for 
+                 * LRU block (don't evict, as we are just going to swap it
+                 * with VC), if no free blocks are available.
+                 */
+                block_id = cache_get_first_invalid_block(tagstore, line);
+                if (CACHE_RV_ERR == block_id)
+                    block_id = cache_util_get_lru_block_id(cache->tagstore,
+                            line);
+
+                vc_tag_index = (vc_line.index * vc_ts->num_blocks_per_set);
+                vc_tag_data = &vc_ts->tag_data[vc_tag_index];
+
+                /* 
+                 * Convert the current L1 tag (to be swapped) to 
+                 * VC's line. 
+                 */
+                memset(&l1_old_line, 0, sizeof(l1_old_line));
+                l1_old_line.tag = cache_tagstore_get_tag(tagstore,
+                        (tag_index + block_id));
+                l1_old_line.index = line->index;
+                cache_util_encode_mem_addr(tagstore, 
+                        &l1_old_line, &l1_old_ref);
+                cache_util_decode_mem_addr(vc_ts, 
+                        l1_old_ref.ref_addr, &vc_tmp_line);
+
+                dprint_info("victim cache hit.. swap\n");
+                dprint_info("%s, to swap: T %" PRIx64 ", I %u, B %d, "
+                    "D %u\n", CACHE_GET_NAME(cache), l1_old_line.tag,
+                    line->index,
+                    block_id, tag_data[block_id].dirty);
+                dprint_info("%s, to swap: T %" PRIx64 ", I %u, B %d, "
+                    "D %u\n", CACHE_GET_NAME(vc), vc_line.tag,
+                    vc_tmp_line.index, vc_block_id, 
+                    vc_tag_data[vc_block_id].dirty);
+
+                dprint_dp("addr %" PRIx64 ", l1 tag %" PRIx64 ", vc tag %"
+                    PRIx64 "\n",
+                    l1_old_ref.ref_addr, l1_old_line.tag, vc_tmp_line.tag);
+
+                /* Swap tag data and dirty bits. */
+                cache_tagstore_set_tag(tagstore, line->index, block_id,
+                        line->tag);
+                cache_tagstore_set_tag(vc_ts, vc_line.index, vc_block_id,
+                        vc_tmp_line.tag);
+                
+                tmp_l1_dirty = tag_data[block_id].dirty;
+                tag_data[block_id].dirty = 
+                    vc_tag_data[vc_block_id].dirty;
+                vc_tag_data[vc_block_id].dirty = tmp_l1_dirty;
+                if (!read_flag)
+                    tag_data[block_id].dirty = 1;
+    
+                curr_age = util_get_next_age(); 
+                cache_util_touch_block(tagstore, line->index, block_id,
+                        curr_age);
+                cache_util_touch_block(vc_ts, vc_line.index, vc_block_id,
+                        curr_age);
+
+#ifdef DBG_ON
+                dprint_info("print cache conntents start\n");
+                cache_print_tags(cache, line);
+                cache_print_tags(vc, &vc_tmp_line);
+                dprint_info("print cache conntents end\n");
+#endif /* DBG_ON */
+                vc_stats->num_swaps += 1;
+                *latency = vc->hit_latency;
+                if (read_flag)
+                    vc_stats->num_read_hits += 1;
+                else
+                    vc_stats->num_write_hits += 1;
+
+                goto exit;
+
+            } else {
+                /* VC miss. Move on to the level after VC, if any. */
+                dprint_dbg("MISS %s\n", CACHE_GET_NAME(vc));
+                dprint_dp("MISS %s, TAG %" PRIx64 "\n", 
+                        CACHE_GET_NAME(vc), vc_line.tag);
+                next_cache = vc->next_cache;
+
+                if (read_flag)
+                    vc_stats->num_read_misses += 1;
+                else
+                    vc_stats->num_write_misses += 1;
+            }
+        }
+    }
+
+    /* A stream buffer may have the block already. */
+    if (cache->prefetcher && (MEM_REF_SRC_DEMAND == mref->ref_src))
+        pf_hit = cache_prefetch_stream_lookup(cache, mref, latency);
+
+    /* Check next level cache, if available. */ 
+    if (next_cache) {
+        mem_ref_t       read_ref;
+        /*
+         * Find a block to place the to-be-fetcheed data. Go for
+         * block eviction, if no free blocks are available.
+         */
+        block_id = cache_get_first_invalid_block(tagstore, line);
+        if (CACHE_RV_ERR == block_id)
+            block_id = cache_evict_tag(cache, mref, line);
+
+        /* 
+         * For cache misses, issues a read reference for that address
+         * to the next cache level.
+         */
+        memset(&read_ref, 0, sizeof(read_ref));
+        memcpy(&read_ref, mref, sizeof(read_ref));
+        read_ref.ref_type = MEM_REF_TYPE_READ;
+        dprint_dp("%s, READ FROM %s %" PRIx64 ", %" PRIx64 "\n", 
+                CACHE_GET_NAME(cache), CACHE_GET_NAME(next_cache), 
+                read_ref.ref_addr, line->tag);
+
+        if (!pf_hit) {
+            cache_evict_and_add_tag(next_cache, &read_ref, latency);
+            cache->stats.num_blk_mem_traffic += 1;
+        }
+
+        cache_tagstore_set_tag(tagstore, line->index, block_id, line->tag);
+        cache_util_touch_block(tagstore, line->index, block_id, curr_age);
+        tag_data[block_id].ref_count = 
+            (util_get_block_ref_count(tagstore, line) + 1);
+
+        if (read_flag) {
+            cache->stats.num_read_misses += 1;
+        } else {
+            cache->stats.num_write_misses += 1;
+
+            /* Set the block to be dirty only for WBWA write policy. */
+            if (CACHE_WRITE_PLCY_WBWA == CACHE_GET_WRITE_POLICY(cache))
+                tag_data[block_id].dirty = 1;
+        }
+        dprint_info("%s, tag 0x%" PRIx64 " added to index %u, block %u\n", 
+                CACHE_GET_NAME(cache), line->tag, line->index, block_id);
+    } else {
+        /* If we are here, we are at a total loss for latency. No matter
+         * L1 miss or L2 miss.
+         */
+        if (!pf_hit)
+            *latency = g_cache_mem_latency;
+        /*
+         * Find a block to place the to-be-fetcheed data. Go for
+         * block eviction, if no free blocks are available.
+         */
+        block_id = cache_get_first_invalid_block(tagstore, line);
+        if (CACHE_RV_ERR == block_id)
+            block_id = cache_evict_tag(cache, mref, line);
+
+        /*
+         * We are at the last cache and currently handling a miss. 
+         * Read from memory and place it the previouly found block. 
+         */
+        cache_tagstore_set_tag(tagstore, line->index, block_id, line->tag);
+        if (!pf_hit)
+            cache->stats.num_blk_mem_traffic += 1;
+        cache_util_touch_block(tagstore, line->index, block_id, curr_age);
+        tag_data[block_id].ref_count = 
+            (util_get_block_ref_count(tagstore, line) + 1);
+
+        dprint_dp("%s, READ FROM MEMORY %" PRIx64 ", %" PRIx64 "\n", 
+                CACHE_GET_NAME(cache), mref->ref_addr, line->tag);
+
+        if (read_flag) {
+            cache->stats.num_read_misses += 1;
+        } else {
+            cache->stats.num_write_misses += 1;
+
+            /* Set the block to be dirty only for WBWA write policy. */
+            if (CACHE_WRITE_PLCY_WBWA == CACHE_GET_WRITE_POLICY(cache))
+                tag_data[block_id].dirty = 1;
+        }
+        dprint_info("%s, tag 0x%" PRIx64 " added to index %u, block %u\n", 
+                CACHE_GET_NAME(cache), line->tag, line->index, block_id);
+    }   /* End of last level cache processing */
+
+exit:
+    return;
+}
+
+
+/***************************************************************************
+ * Name:    cache_handle_line
+ *
+ * Desc:    Core processing routine for a decoded memory reference. It does
+ *          one (and only one) of the following for every reference:
+ *          1. If the tag is already present, we are done here. Might have to
+ *              write thru for a write request if the write policy is set to 
+ *              WTNA. A WTNA write miss is written thru as well, and doesn't
+ *              allocate a block.
+ *          2. If a free block is available, place the tag in that block. 
+ *          3. Evict a block (based on the eviction policy set), do a write
+ *              back (if evicted block is dirty) and place the incoming tag
+ *              on the block.
+ *
+ *          For all three operations above, we need to update read/write, 
+ *          miss/hit counters, valid, dirty (for writes) and age for the block.
+ *          The per reference and the batched entry points both come thru
+ *          here, so the read/write and sampled counters live only here.
+ *
+ * Params:
+ *  cache       ptr to cache
+ *  mref        ptr to the memory reference (type and address)
+ *  line        ptr to the decoded cache line of the reference
+ *  block_id    result of cache_does_tag_match for the line; don't care
+ *              for a set which isn't sampled
+ *  merged      TRUE for a secondary miss merged into an outstanding MSHR;
+ *              counted as a miss even though the block is present
+ *  latency     ptr to store the latency of the reference
+ *
+ * Returns: Nothing.
+ **************************************************************************/
+void
+cache_handle_line(cache_generic_t *cache, mem_ref_t *mref, cache_line_t *line,
+        int32_t block_id, boolean merged, uint32_t *latency)
+{
+    uint64_t            curr_age;
+    boolean             pf_train = FALSE;
+    boolean             pf_trigger = TRUE;
+    cache_tagstore_t    *tagstore = NULL;
+
+    if ((!cache) || (!mref) || (!line)) {
+        cache_assert(0);
+        goto exit;
+    }
+    tagstore = cache->tagstore;
+
+    /* Refs to sets outside the sample only get an estimated outcome. */
+    if (!cache_util_is_sampled(tagstore, mref->ref_addr)) {
+        cache_handle_unsampled_ref(cache, mref, latency);
+        goto exit;
+    }
+    cache->stats.num_sampled_refs += 1;
+    if (tagstore->sample_refs)
+        tagstore->sample_refs[line->index] += 1;
+    pf_train = ((cache->prefetcher && (MEM_REF_SRC_DEMAND == mref->ref_src))
+            ? TRUE : FALSE);
+
+    /* Fetch the current time to be used for tag age (for LRU). */
+    curr_age = util_get_next_age(); 
+
+    if (IS_MEM_REF_READ(mref))
+        cache->stats.num_reads += 1;
+    else
+        cache->stats.num_writes += 1;
+
+    /*
+     * Notes
+     * =====
+     *  * Victim cache will only contain entries that were missed in
+     *    L1. There can be no entires in victim cache that weren't missed
+     *    by L1 at any given time.
+     *
      * Possible Operations
      * ===================
      * a.) L1 hit:
@@ -917,7 +1907,7 @@ cache_evict_and_add_tag(cache_generic_t *cache, mem_ref_t *mref,
      *        the counters and return to previous level.
      */
 
-    if (CACHE_RV_ERR != (block_id = cache_does_tag_match(tagstore, &line))) {
+    if ((CACHE_RV_ERR != block_id) && (!merged)) {
         /* 
          * Cache hit!
          * Tag is already present. Just update the counters and go fetch the
@@ -925,269 +1915,67 @@ cache_evict_and_add_tag(cache_generic_t *cache, mem_ref_t *mref,
          *
          * Life is good!
          */
-
-        /* Update the latency based on the cache type. */
-        if (CACHE_LEVEL_1 == cache->level)
-            *latency = (CACHE_L1_HIT_LATENCY);
-        else if (CACHE_LEVEL_2 == cache->level)
-            *latency = (CACHE_L2_HIT_LATENCY);
-
-        dprint_dbg("HIT %s\n", CACHE_GET_NAME(cache));
-        dprint_info("cache hit for cache %s, tag 0x%x at index %u, block %u\n",
-                CACHE_GET_NAME(cache), line.tag, line.index, block_id);
-        tag_data[block_id].valid = 1;
-        tag_data[block_id].age = curr_age;
-        tag_data[block_id].ref_count += 1;
-
-        if (read_flag) {
-            cache->stats.num_read_hits += 1;
-        } else {
-            cache->stats.num_write_hits += 1;
-            
-            /* Set the block to be dirty only for WBWA write policy. */
-            if (CACHE_WRITE_PLCY_WBWA == CACHE_GET_WRITE_POLICY(cache)) {
-                tag_data[block_id].dirty = 1;
-             } else {
-                cache->stats.num_blk_mem_traffic += 1;
-             }
-        }
+        pf_trigger = cache_handle_tag_hit(cache, mref, line, block_id,
+                curr_age, latency);
     } else {
-        cache_generic_t *next_cache = NULL;
-
-        /* 
-         * Cache miss! 
-         * Well, life is not always so good..
-         *
-         * In multi level caches, do the following in case of a cache miss:
-         *  1. If the next level in hierarchy is a cache, check if the 
-         *     requested data is present there. If so, bring in the block
-         *     and follow steps 2/3 for placing the block. i.e., find a
-         *     free block or go for replacement.
-         *  2. If the next level is not a cache (i.e., for last level of
-         *     caches, the next level would be main memory), check if there
-         *     are any free blocks. If so, use those blocks for new data.
-         *  3. If there are no free blocks and if the cache is the last level,
-         *     go for cache replacement.
-         *
-         * For all three cases, first find a block to place the to-be-feched
-         * data block. 
-         */
-        if (CACHE_IS_L1(cache))
-            dprint_dbg("MISS %s\n", CACHE_GET_NAME(cache));
-            dprint_dp("MISS %s, TAG %x\n", CACHE_GET_NAME(cache), line.tag);
-        dprint_info("cache miss for cache %s, tag 0x%x @ index %u\n",
-                CACHE_GET_NAME(cache), line.tag, line.index);
-        next_cache = cache->next_cache;
+        cache->stats.num_sampled_misses += 1;
+        if (tagstore->sample_misses)
+            tagstore->sample_misses[line->index] += 1;
+        if (CACHE_RV_ERR != block_id)
+            cache_handle_merged_miss(cache, mref, line, block_id, curr_age,
+                    latency);
+        else
+            cache_handle_tag_miss(cache, mref, line, curr_age, latency);
+    }
 
-        dprint_info("cache %s, index %u, block %d selected for tag 0x%x\n",
-                CACHE_GET_NAME(cache), line.index, block_id, line.tag);
-
-        /* 
-         * If VC is present, L1 + VC acts as a single entity to the next memory
-         * level. So, some ugly cache specific code.. which I don't like!
-         */
-        if (CACHE_IS_L1(cache)) {
-            if (cache_util_is_victim_present()) {
-                int32_t             vc_block_id = CACHE_RV_ERR;
-                cache_line_t        vc_line;
-                cache_generic_t     *vc = NULL;
-                cache_tagstore_t    *vc_ts = NULL;
-                cache_stats_t       *vc_stats = NULL;
-
-                vc = cache_util_get_vc(); 
-                vc_ts = vc->tagstore;
-                vc_stats = &vc->stats;
-                memset(&vc_line, 0, sizeof(vc_line));
-                cache_util_decode_mem_addr(vc_ts, mref->ref_addr, &vc_line);
-
-                vc_block_id = cache_does_tag_match(vc_ts, &vc_line);
-                if (CACHE_RV_ERR != vc_block_id) {
-                    uint8_t             tmp_l1_dirty = 0;
-                    uint32_t            vc_tag_index = 0;
-                    uint32_t            *vc_tags;
-                    mem_ref_t           l1_old_ref;
-                    cache_line_t        l1_old_line;
-                    cache_line_t        vc_tmp_line;
-                    cache_tag_data_t    *vc_tag_data;
-
-                    dprint_dbg("HIT %s, SWAP\n", CACHE_GET_NAME(vc));
-
-                    /* 
-                     * Find a block to place the to-be-fetcheed data. Go for 
-                     * LRU block (don't evict, as we are just going to swap it
-                     * with VC), if no free blocks are available.
-                     */
-                    block_id = cache_get_first_invalid_block(tagstore, &line);
-                    if (CACHE_RV_ERR == block_id)
-                        block_id = cache_util_get_lru_block_id(cache->tagstore,
-                                &line);
-
-                    vc_tag_index = (vc_line.index * vc_ts->num_blocks_per_set);
-                    vc_tags = &vc_ts->tags[vc_tag_index];
-                    vc_tag_data = &vc_ts->tag_data[vc_tag_index];
-
-                    /* 
-                     * Convert the current L1 tag (to be swapped) to 
-                     * VC's line. 
-                     */
-                    memset(&l1_old_line, 0, sizeof(l1_old_line));
-                    l1_old_line.tag = tags[block_id];
-                    l1_old_line.index = line.index;
-                    cache_util_encode_mem_addr(tagstore, 
-                            &l1_old_line, &l1_old_ref);
-                    cache_util_decode_mem_addr(vc_ts, 
-                            l1_old_ref.ref_addr, &vc_tmp_line);
-
-                    dprint_info("victim cache hit.. swap\n");
-                    dprint_info("%s, to swap: T %x, I %u, B %d, D %u\n",
-                        CACHE_GET_NAME(cache), tags[block_id], line.index,
-                        block_id, tag_data[block_id].dirty);
-                    dprint_info("%s, to swap: T %x, I %u, B %d, D %u\n",
-                        CACHE_GET_NAME(vc), vc_tags[vc_block_id], 
-                        vc_tmp_line.index, vc_block_id, 
-                        vc_tag_data[vc_block_id].dirty);
-
-                    dprint_dp("addr %x, l1 tag %x, vc tag %x\n",
-                        l1_old_ref.ref_addr, l1_old_line.tag, vc_tmp_line.tag);
-
-                    /* Swap tag data and dirty bits. */
-                    tags[block_id] = line.tag;
-                    vc_tags[vc_block_id] = vc_tmp_line.tag;
-                    
-                    tmp_l1_dirty = tag_data[block_id].dirty;
-                    tag_data[block_id].dirty = 
-                        vc_tag_data[vc_block_id].dirty;
-                    vc_tag_data[vc_block_id].dirty = tmp_l1_dirty;
-                    if (!read_flag)
-                        tag_data[block_id].dirty = 1;
-        
-                    curr_age = util_get_curr_time(); 
-                    tag_data[block_id].valid = 1;
-                    tag_data[block_id].age = curr_age;
-                    vc_tag_data[vc_block_id].valid = 1;
-                    vc_tag_data[vc_block_id].age = curr_age;
+    /* Let the prefetcher see the demand reference. */
+    if (pf_train)
+        cache_prefetch_train(cache, mref, pf_trigger);
 
 #ifdef DBG_ON
-                    dprint_info("print cache conntents start\n");
-                    cache_print_tags(cache, &line);
-                    cache_print_tags(vc, &vc_tmp_line);
-                    dprint_info("print cache conntents end\n");
+    cache_print_tags(cache, line);
 #endif /* DBG_ON */
-                    vc_stats->num_swaps += 1;
-                    if (read_flag)
-                        vc_stats->num_read_hits += 1;
-                    else
-                        vc_stats->num_write_hits += 1;
-
-                    goto exit;
-
-                } else {
-                    /* VC miss. Set next cache to L2, if available. */
-                    dprint_dbg("MISS %s\n", CACHE_GET_NAME(vc));
-                    dprint_dp("MISS %s, TAG %x\n", 
-                            CACHE_GET_NAME(vc), vc_line.tag);
-                    next_cache = (cache_util_is_l2_present()) ? 
-                        cache_util_get_l2() : NULL;
-
-                    if (read_flag)
-                        vc_stats->num_read_misses += 1;
-                    else
-                        vc_stats->num_write_misses += 1;
-                }
-            } else {
-                /* VC not present. Set next_cache to L2 if available. */
-                next_cache = (cache_util_is_l2_present()) ? 
-                    cache_util_get_l2() : NULL;
-            }
-        }
-
-        /* Check next level cache, if available. */ 
-        if (next_cache) {
-            mem_ref_t       read_ref;
-            /*
-             * Find a block to place the to-be-fetcheed data. Go for
-             * block eviction, if no free blocks are available.
-             */
-            block_id = cache_get_first_invalid_block(tagstore, &line);
-            if (CACHE_RV_ERR == block_id)
-                block_id = cache_evict_tag(cache, mref, &line);
-
-            /* 
-             * For cache misses, issues a read reference for that address
-             * to the next cache level.
-             */
-            memset(&read_ref, 0, sizeof(read_ref));
-            memcpy(&read_ref, mref, sizeof(read_ref));
-            read_ref.ref_type = MEM_REF_TYPE_READ;
-            dprint_dp("%s, READ FROM %s %x, %x\n", 
-                    CACHE_GET_NAME(cache), CACHE_GET_NAME(next_cache), 
-                    read_ref.ref_addr, line.tag);
 
-            cache_evict_and_add_tag(next_cache, &read_ref, latency);
-
-            tags[block_id] = line.tag;
-            cache->stats.num_blk_mem_traffic += 1;
-            tag_data[block_id].valid = 1;
-            tag_data[block_id].age = curr_age;
-            tag_data[block_id].ref_count = 
-                (util_get_block_ref_count(tagstore, &line) + 1);
-
-            if (read_flag) {
-                cache->stats.num_read_misses += 1;
-            } else {
-                cache->stats.num_write_misses += 1;
+exit:
+    return;
+}
 
-                /* Set the block to be dirty only for WBWA write policy. */
-                if (CACHE_WRITE_PLCY_WBWA == CACHE_GET_WRITE_POLICY(cache))
-                    tag_data[block_id].dirty = 1;
-            }
-            dprint_info("%s, tag 0x%x added to index %u, block %u\n", 
-                    CACHE_GET_NAME(cache), line.tag, line.index, block_id);
-        } else {
-            /* If we are here, we are at a total loss for latency. No matter
-             * L1 miss or L2 miss.
-             */
-            *latency = CACHE_TOTAL_MISS_LATENCY;
-            /*
-             * Find a block to place the to-be-fetcheed data. Go for
-             * block eviction, if no free blocks are available.
-             */
-            block_id = cache_get_first_invalid_block(tagstore, &line);
-            if (CACHE_RV_ERR == block_id)
-                block_id = cache_evict_tag(cache, mref, &line);
 
-            /*
-             * We are at the last cache and currently handling a miss. 
-             * Read from memory and place it the previouly found block. 
-             */
-            tags[block_id] = line.tag;
-            cache->stats.num_blk_mem_traffic += 1;
-            tag_data[block_id].valid = 1;
-            tag_data[block_id].age = curr_age;
-            tag_data[block_id].ref_count = 
-                (util_get_block_ref_count(tagstore, &line) + 1);
+/*************************************************************************** 
+ * Name:    cache_evict_and_add_tag 
+ *
+ * Desc:    Per reference entry point of the cache pipeline, also used
+ *          between the cache levels. Decodes the reference, looks it up
+ *          and hands it to cache_handle_line.
+ *
+ * Params:
+ *  in_cache    ptr to cache
+ *  mem_ref     ptr to the memory reference (type and address)
+ *  latency     ptr to store the latency of the reference
+ *
+ * Returns: Nothing.
+ **************************************************************************/
+void
+cache_evict_and_add_tag(cache_generic_t *cache, mem_ref_t *mref,
+        uint32_t *latency)
+{
+    int32_t         block_id = CACHE_RV_ERR;
+    cache_line_t    line;
 
-            dprint_dp("%s, READ FROM MEMORY %x, %x\n", 
-                    CACHE_GET_NAME(cache), mref->ref_addr, line.tag);
+    if ((!cache) || (!mref)) {
+        cache_assert(0);
+        goto exit;
+    }
 
-            if (read_flag) {
-                cache->stats.num_read_misses += 1;
-            } else {
-                cache->stats.num_write_misses += 1;
+    /* Decode the memmory reference to the current cache's cache line. */
+    memset(&line, 0, sizeof(line));
+    cache_util_decode_mem_addr(cache->tagstore, mref->ref_addr, &line);
+    if (cache_util_is_sampled(cache->tagstore, mref->ref_addr))
+        block_id = cache_does_tag_match(cache->tagstore, &line);
 
-                /* Set the block to be dirty only for WBWA write policy. */
-                if (CACHE_WRITE_PLCY_WBWA == CACHE_GET_WRITE_POLICY(cache))
-                    tag_data[block_id].dirty = 1;
-            }
-            dprint_info("%s, tag 0x%x added to index %u, block %u\n", 
-                    CACHE_GET_NAME(cache), line.tag, line.index, block_id);
-        }   /* End of last level cache processing */
-    }   /* End of cache miss processing */
+    cache_handle_line(cache, mref, &line, block_id, FALSE, latency);
 
 exit:
-#ifdef DBG_ON
-    cache_print_tags(cache, &line);
-#endif /* DBG_ON */
     return;
 }
 
@@ -1195,25 +1983,28 @@ exit:
 /*************************************************************************** 
  * Name:    cache_handle_memory_request 
  *
- * Desc:    Cache processing entry point for the main driver. Decodes the
- *          incoming memory reference into cache understandable data and
- *          calls further cache processing routines.
+ * Desc:    Cache processing entry point for the main driver, one reference
+ *          at a time. Decodes the incoming memory reference into cache
+ *          understandable data and calls further cache processing
+ *          routines; a non-blocking cache takes it thru its MSHRs.
  *
  * Params:
  *  cache   ptr to L1 cache
  *  mref    ptr to incoming memory reference
+ *  latency ptr to store the latency of the reference
  *
  * Returns: boolean
- *  TRUE if all goes well
- *  FALSE otherwise 
+ *  TRUE if the reference was accepted
+ *  FALSE if it has to be retried due to lack of MSHRs, or on errors
  **************************************************************************/
 boolean
 cache_handle_memory_request(cache_generic_t *cache, mem_ref_t *mref,
-        uint16_t *latency)
+        uint32_t *latency)
 {
-    cache_line_t line;
+    int32_t         block_id = CACHE_RV_ERR;
+    cache_line_t    line;
 
-    if ((!cache) || (!mref)) {
+    if ((!cache) || (!mref) || (!latency)) {
         cache_assert(0);
         goto error_exit;
     }
@@ -1224,9 +2015,15 @@ cache_handle_memory_request(cache_generic_t *cache, mem_ref_t *mref,
      */
     memset(&line, 0, sizeof(line));
     cache_util_decode_mem_addr(cache->tagstore, mref->ref_addr, &line);
+    *latency = 0;
+    if (cache->mshr)
+        return cache_mshr_handle_request(cache, mref, &line, latency);
+
+    if (cache_util_is_sampled(cache->tagstore, mref->ref_addr))
+        block_id = cache_does_tag_match(cache->tagstore, &line);
 
     /* Cache pipeline starts here. */
-    cache_evict_and_add_tag(cache, mref, latency);
+    cache_handle_line(cache, mref, &line, block_id, FALSE, latency);
 
     return TRUE;
 
@@ -1234,3 +2031,273 @@ error_exit:
     return FALSE;
 }
 
+
+/***************************************************************************
+ * Name:    cache_set_cycle
+ *
+ * Desc:    Lets the pipeline tell the caches about the current cycle. Only
+ *          the non-blocking (MSHR) path needs a notion of time; the
+ *          blocking path just returns latencies.
+ *
+ * Params:
+ *  cycle   current pipeline cycle
+ *
+ * Returns: Nothing
+ **************************************************************************/
+void
+cache_set_cycle(uint32_t cycle)
+{
+    g_cache_cycle = cycle;
+    return;
+}
+
+
+/***************************************************************************
+ * Name:    cache_batch_init
+ *
+ * Desc:    Allocates a batch of memory references for the batched cache
+ *          access path.
+ *
+ * Params:
+ *  batch   ptr to the batch
+ *  size    max # of references in the batch
+ *
+ * Returns: Nothing
+ **************************************************************************/
+void
+cache_batch_init(cache_batch_t *batch, uint32_t size)
+{
+    if ((!batch) || (!size)) {
+        cache_assert(0);
+        goto exit;
+    }
+
+    memset(batch, 0, sizeof(*batch));
+    batch->mrefs = (mem_ref_t *) calloc(size, sizeof(*batch->mrefs));
+    batch->lines = (cache_line_t *) calloc(size, sizeof(*batch->lines));
+    batch->latencies = (uint32_t *) calloc(size, sizeof(*batch->latencies));
+    batch->accepted = (boolean *) calloc(size, sizeof(*batch->accepted));
+
+    if ((!batch->mrefs) || (!batch->lines) || (!batch->latencies) ||
+            (!batch->accepted)) {
+        dprint("Error: Unable to allocate memory for cache batch.\n");
+        cache_assert(0);
+        goto fatal_exit;
+    }
+    batch->size = size;
+
+exit:
+    return;
+
+fatal_exit:
+    /* Fatal exit. Quit the program. */
+    exit(-1);
+}
+
+
+/***************************************************************************
+ * Name:    cache_batch_cleanup
+ *
+ * Desc:    Frees a batch of memory references.
+ *
+ * Params:
+ *  batch   ptr to the batch
+ *
+ * Returns: Nothing
+ **************************************************************************/
+void
+cache_batch_cleanup(cache_batch_t *batch)
+{
+    if (!batch) {
+        cache_assert(0);
+        goto exit;
+    }
+
+    free(batch->mrefs);
+    free(batch->lines);
+    free(batch->latencies);
+    free(batch->accepted);
+    memset(batch, 0, sizeof(*batch));
+
+exit:
+    return;
+}
+
+
+/***************************************************************************
+ * Name:    cache_handle_memory_batch
+ *
+ * Desc:    Batched entry point for the main driver; handles all the memory
+ *          references issued to the cache in a cycle. All the references
+ *          are decoded and tag matched up front, then each is handed to
+ *          the same cache_handle_line (or, for a non-blocking cache, the
+ *          MSHRs) as a single reference would be, in the given order. So
+ *          the result is exactly the same as calling
+ *          cache_handle_memory_request for each of them in turn.
+ *
+ * Params:
+ *  cache   ptr to L1 cache
+ *  batch   ptr to the batch; mrefs and count are filled in by the caller,
+ *          latencies and accepted are filled in here
+ *
+ * Returns: Nothing
+ **************************************************************************/
+void
+cache_handle_memory_batch(cache_generic_t *cache, cache_batch_t *batch)
+{
+    int32_t             block_id = 0;
+    uint32_t            i = 0;
+    mem_ref_t           *mref = NULL;
+    cache_tagstore_t    *tagstore = NULL;
+
+    if ((!cache) || (!batch)) {
+        cache_assert(0);
+        goto exit;
+    }
+    tagstore = cache->tagstore;
+
+    /* Decode all the references up front; it only depends on geometry. */
+    for (i = 0; i < batch->count; ++i)
+        cache_util_decode_mem_addr(tagstore, batch->mrefs[i].ref_addr,
+                &batch->lines[i]);
+
+    for (i = 0; i < batch->count; ++i) {
+        mref = &batch->mrefs[i];
+        batch->latencies[i] = 0;
+
+        /* Non-blocking caches need the MSHRs for every reference. */
+        if (cache->mshr) {
+            batch->accepted[i] = cache_mshr_handle_request(cache, mref,
+                    &batch->lines[i], &batch->latencies[i]);
+            continue;
+        }
+
+        batch->accepted[i] = TRUE;
+        block_id = CACHE_RV_ERR;
+        if (cache_util_is_sampled(tagstore, mref->ref_addr))
+            block_id = cache_does_tag_match(tagstore, &batch->lines[i]);
+        cache_handle_line(cache, mref, &batch->lines[i], block_id, FALSE,
+                &batch->latencies[i]);
+    }
+
+exit:
+    return;
+}
+
+
+/***************************************************************************
+ * Name:    cache_ctx_init
+ *
+ * Desc:    Sets up the context of a cache hierarchy yet to be built, i.e.,
+ *          the state of the globals before cache_init.
+ *
+ * Params:
+ *  ctx     ptr to the context
+ *
+ * Returns: Nothing
+ **************************************************************************/
+void
+cache_ctx_init(cache_ctx_t *ctx)
+{
+    if (!ctx) {
+        cache_assert(0);
+        goto exit;
+    }
+
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->sample_rand = CACHE_SAMPLE_SEED;
+
+exit:
+    return;
+}
+
+
+/***************************************************************************
+ * Name:    cache_ctx_swap
+ *
+ * Desc:    Swaps the global cache state with the given context, so that
+ *          two cache hierarchies can take turns. The caches and tagstores
+ *          point to each other by their global slots, which stay put; the
+ *          tag arrays, MSHRs and prefetchers go along with their caches.
+ *
+ * Params:
+ *  ctx     ptr to the context put aside
+ *
+ * Returns: Nothing
+ **************************************************************************/
+void
+cache_ctx_swap(cache_ctx_t *ctx)
+{
+    cache_ctx_t tmp;
+
+    if (!ctx) {
+        cache_assert(0);
+        goto exit;
+    }
+
+    tmp.l1_cache = g_l1_cache;
+    tmp.l2_cache = g_l2_cache;
+    tmp.vic_cache = g_vic_cache;
+    tmp.l1_cache_ts = g_l1_cache_ts;
+    tmp.l2_cache_ts = g_l2_cache_ts;
+    tmp.vic_cache_ts = g_vic_cache_ts;
+    memcpy(tmp.lx_caches, g_lx_caches, sizeof(tmp.lx_caches));
+    memcpy(tmp.lx_cache_ts, g_lx_cache_ts, sizeof(tmp.lx_cache_ts));
+    tmp.addr_count = g_addr_count;
+    tmp.cycle = g_cache_cycle;
+    tmp.age = g_cache_age;
+    tmp.sample_rand = g_cache_sample_rand;
+
+    g_l1_cache = ctx->l1_cache;
+    g_l2_cache = ctx->l2_cache;
+    g_vic_cache = ctx->vic_cache;
+    g_l1_cache_ts = ctx->l1_cache_ts;
+    g_l2_cache_ts = ctx->l2_cache_ts;
+    g_vic_cache_ts = ctx->vic_cache_ts;
+    memcpy(g_lx_caches, ctx->lx_caches, sizeof(g_lx_caches));
+    memcpy(g_lx_cache_ts, ctx->lx_cache_ts, sizeof(g_lx_cache_ts));
+    g_addr_count = ctx->addr_count;
+    g_cache_cycle = ctx->cycle;
+    g_cache_age = ctx->age;
+    g_cache_sample_rand = ctx->sample_rand;
+
+    *ctx = tmp;
+
+exit:
+    return;
+}
+
+
+/***************************************************************************
+ * Name:    cache_ctx_get_cache
+ *
+ * Desc:    Returns the copy, in the given context, of a cache of the
+ *          running hierarchy.
+ *
+ * Params:
+ *  ctx     ptr to the context put aside
+ *  cache   ptr to the global slot of the cache
+ *
+ * Returns: cache_generic_t *
+ *  ptr to the same cache in the context
+ *  NULL if the cache has no global slot
+ **************************************************************************/
+cache_generic_t *
+cache_ctx_get_cache(cache_ctx_t *ctx, cache_generic_t *cache)
+{
+    if ((!ctx) || (!cache)) {
+        cache_assert(0);
+        return NULL;
+    }
+
+    if (&g_l1_cache == cache)
+        return &ctx->l1_cache;
+    if (&g_l2_cache == cache)
+        return &ctx->l2_cache;
+    if (&g_vic_cache == cache)
+        return &ctx->vic_cache;
+    if ((cache >= g_lx_caches) &&
+            (cache < (g_lx_caches + (CACHE_MAX_LEVELS - 2))))
+        return &ctx->lx_caches[cache - g_lx_caches];
+    return NULL;
+}
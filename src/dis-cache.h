@@ -23,8 +23,12 @@
 #define CACHE_LEVEL_2           2
 #define CACHE_LEVEL_3           3
 #define CACHE_LEVEL_L1_VICTIM   6
+#define CACHE_MAX_LEVELS        5       /* L1 .. L5; below the VC level */
 #define CACHE_NAME_LEN          24
-#define CACHE_ADDR_32BIT_LEN    32
+#define CACHE_ADDR_MIN_BITS     32
+#define CACHE_ADDR_DEFAULT_BITS 64
+#define CACHE_ADDR_MAX_BITS     64
+#define CACHE_TAG_LO_BITS       32      /* tag bits in the tags array */
 #define CACHE_TRACE_FILE_LEN    256
 
 #define CACHE_REPL_PLCY_LRU     0
@@ -35,14 +39,39 @@
 #define MEM_REF_TYPE_READ       'r'
 #define MEM_REF_TYPE_WRITE      'w'
 
+#define MEM_REF_SRC_DEMAND      0       /* from the pipeline, or its miss */
+#define MEM_REF_SRC_WBACK       1       /* dirty block write back         */
+#define MEM_REF_SRC_PREFETCH    2       /* prefetch fill                  */
+
+#define CACHE_PF_NONE           0
+#define CACHE_PF_NEXT_LINE      1       /* next-line, tagged              */
+#define CACHE_PF_STRIDE         2       /* PC indexed stride              */
+#define CACHE_PF_STREAM         3       /* stream buffers                 */
+#define CACHE_PF_DEFAULT_DEGREE 2
+#define CACHE_PF_MAX_DEGREE     8
+#define CACHE_PF_STRIDE_ENTRIES 64
+#define CACHE_PF_NUM_STREAMS    4
+
 #define CACHE_L1_HIT_LATENCY        5
 #define CACHE_L1_MISS_LATENCY       10
 #define CACHE_L2_HIT_LATENCY        10
 #define CACHE_TOTAL_MISS_LATENCY    20
+#define CACHE_VC_HIT_LATENCY        (CACHE_L1_HIT_LATENCY + 1)
+
+#define CACHE_MSHR_MAX_ENTRIES      1024
+#define CACHE_MSHR_MAX_FILL_INTERVAL 65535 /* fills queue up to 2^26 cycles */
+#define CACHE_TAG_INDEX_MIN_ASSOC   8
+#define CACHE_MRU_NONE              UINT32_MAX  /* end of a recency list */
+#define CACHE_SAMPLE_SEED           0x2545f491
+
+#define CACHE_DUMP_ORDER_WAY        0   /* blocks in way order (TA's) */
+#define CACHE_DUMP_ORDER_MRU        1   /* blocks from MRU to LRU     */
 
 /* Standard typedefs */
 typedef unsigned char uchar;
 typedef unsigned char boolean;
+typedef uint64_t mem_addr_t;            /* memory address, up to 64 bits */
+typedef uint64_t cache_tag_t;           /* tag of a block, decoded       */
 typedef enum cache_rv__ {
     CACHE_RV_ERR = -1,
     CACHE_RV_OK = 0
@@ -51,12 +80,14 @@ typedef enum cache_rv__ {
 /* Memory reference: address and refernce type */
 typedef struct mem_ref__ {
     uint8_t     ref_type;
-    uint32_t    ref_addr;
+    uint8_t     ref_src;                /* MEM_REF_SRC_*            */
+    mem_addr_t  ref_addr;
+    mem_addr_t  ref_pc;                 /* pc of the inst, if any   */
 } mem_ref_t;
 
 /* Cahce line: addr = <tag, index, blk_offset> */
 typedef struct cache_line__ {
-    uint32_t    tag;
+    cache_tag_t tag;
     uint32_t    index;
     uint32_t    offset;
 } cache_line_t;
@@ -66,8 +97,17 @@ typedef struct cache_tag_data__ {
     uint32_t        ref_count;              /* ref. count (LFU)         */
     uint8_t         valid;                  /* valid bit of the block   */
     uint8_t         dirty;                  /* dirty bit of the block   */
+    uint8_t         prefetched;             /* prefetched, not yet used */
+    uint32_t        pf_ready_cycle;         /* prefetch fill done cycle */
 } cache_tag_data_t;
 
+/* Tag index slot; maps <set index, tag> to a block within the set */
+typedef struct cache_tag_index__ {
+    cache_tag_t     tag;                    /* tag of the block         */
+    uint32_t        index;                  /* set index of the block   */
+    uint32_t        block_id;               /* block ID + 1, 0 if empty */
+} cache_tag_index_t;
+
 /* Cache tag store data structure */
 typedef struct cache_tagstore__ {
     void                *cache;                 /* ptr ot parent cache      */
@@ -79,9 +119,21 @@ typedef struct cache_tagstore__ {
     uint8_t             num_offset_bits;        /* # of bits for blk offset */
     uint8_t             *lru_block_id;          /* LRU block within the set */
     uint32_t            *index;                 /* ptr to tag indices       */
-    uint32_t            *tags;                  /* ptr to tag array         */
+    uint32_t            *tags;                  /* ptr to tag array; low
+                                                   32 bits of each tag      */
+    uint8_t             num_tag_hi_bytes;       /* bytes/tag above 32 bits  */
+    uint8_t             *tags_hi;               /* rest of the tags, if any */
     cache_tag_data_t    *tag_data;              /* ptr to tag stats         */
     uint32_t            *set_ref_count;         /* row-wise ref count (LFU) */
+    uint32_t            *set_valid_count;       /* # of valid blocks in set */
+    uint32_t            *mru_head;              /* MRU block of each set    */
+    uint32_t            *mru_next;              /* next block towards LRU   */
+    uint32_t            *mru_prev;              /* next block towards MRU   */
+    uint8_t             tag_index_bits;         /* log2 of tag index size   */
+    cache_tag_index_t   *tag_index;             /* tag -> block hash index  */
+    uint8_t             num_sample_bits;        /* log2 of set sample ratio */
+    uint32_t            *sample_refs;           /* refs, per sampled set    */
+    uint32_t            *sample_misses;         /* misses, per sampled set  */
 } cache_tagstore_t;
 
 /* Cache statistics data structure */
@@ -95,9 +147,70 @@ typedef struct cache_stats__ {
     uint32_t            num_write_misses;       /* # of write misses        */
     uint32_t            num_write_backs;        /* # of write backs         */
     uint32_t            num_blk_mem_traffic;    /* # of blks transferred    */
+    uint32_t            num_sampled_refs;       /* # of refs to sampled sets*/
+    uint32_t            num_sampled_misses;     /* # of misses among those  */
+    uint32_t            num_pf_issued;          /* # of prefetches issued   */
+    uint32_t            num_pf_useful;          /* # used by demand refs    */
+    uint32_t            num_pf_late;            /* useful, but not ready    */
+    uint32_t            num_pf_dropped;         /* already present; dropped */
     void                *cache;                 /* ptr to parent cache      */
 } cache_stats_t;
 
+/* Miss status holding register; one per outstanding block fill */
+typedef struct cache_mshr_entry__ {
+    mem_addr_t          blk_addr;               /* block aligned address    */
+    uint32_t            ready_cycle;            /* cycle the fill is done   */
+    uint32_t            num_merged;             /* # of secondary misses    */
+    uint32_t            next;                   /* next in bucket/free list,
+                                                   entry ID + 1, 0 if none  */
+    uint8_t             valid;                  /* entry in use?            */
+} cache_mshr_entry_t;
+
+/* MSHR file for a non-blocking cache */
+typedef struct cache_mshr__ {
+    uint32_t            num_entries;            /* # of MSHRs               */
+    uint32_t            num_used;               /* # of MSHRs in use        */
+    uint32_t            fill_interval;          /* cycles b/w two fills     */
+    uint32_t            next_fill_cycle;        /* next free fill slot      */
+    uint32_t            num_primary;            /* # of primary misses      */
+    uint32_t            num_secondary;          /* # of merged misses       */
+    uint32_t            num_full_stalls;        /* # of MSHR full stalls    */
+    uint32_t            max_used;               /* peak # of MSHRs in use   */
+    uint32_t            free_head;              /* free list, entry ID + 1  */
+    uint8_t             hash_bits;              /* log2 of # of buckets     */
+    uint32_t            *buckets;               /* blk addr hash, ID + 1    */
+    uint32_t            *heap;                  /* in use IDs, min ready on
+                                                   top                      */
+    cache_mshr_entry_t  *entries;               /* ptr to MSHR entries      */
+} cache_mshr_t;
+
+/* PC indexed stride prefetcher entry */
+typedef struct cache_pf_stride_entry__ {
+    mem_addr_t          pc;                     /* pc of the load           */
+    mem_addr_t          last_addr;              /* last address accessed    */
+    int64_t             stride;                 /* last seen stride         */
+    uint8_t             confidence;             /* 2 bit saturating counter */
+    uint8_t             valid;                  /* entry in use?            */
+} cache_pf_stride_entry_t;
+
+/* Stream buffer; a FIFO of sequential blocks being prefetched */
+typedef struct cache_pf_stream__ {
+    mem_addr_t          blk_addr[CACHE_PF_MAX_DEGREE];
+    uint32_t            ready_cycle[CACHE_PF_MAX_DEGREE];
+    uint32_t            head;                   /* index of the oldest blk  */
+    mem_addr_t          next_blk;               /* next blk to prefetch     */
+    uint64_t            age;                    /* last use (LRU)           */
+    uint8_t             valid;                  /* buffer in use?           */
+} cache_pf_stream_t;
+
+/* Prefetcher attached to a cache */
+typedef struct cache_prefetcher__ {
+    uint8_t             type;                   /* CACHE_PF_*               */
+    uint8_t             degree;                 /* blks per trigger / depth */
+    cache_pf_stride_entry_t stride[CACHE_PF_STRIDE_ENTRIES];
+    cache_pf_stream_t   streams[CACHE_PF_NUM_STREAMS];
+} cache_prefetcher_t;
+
 /* Generic cache data structure */
 typedef struct cache_generic__ {
     char                name[CACHE_NAME_LEN];   /* name - L1, L2..          */
@@ -109,22 +222,85 @@ typedef struct cache_generic__ {
     uint8_t             repl_plcy;              /* replacement policy       */
     uint8_t             write_plcy;             /* write policy             */
     uint32_t            victim_size;            /* victim cache size        */
+    uint16_t            hit_latency;            /* total latency on a hit   */
+    uint32_t            set_sample;             /* simulate 1 in n sets     */
     cache_stats_t       stats;                  /* cache statistics         */
     cache_tagstore_t    *tagstore;              /* associated tagstore      */
+    cache_mshr_t        *mshr;                  /* MSHRs, if non-blocking   */
+    cache_prefetcher_t  *prefetcher;            /* prefetcher, if any       */
     struct cache_generic__ *next_cache;         /* next higher level cache  */
     struct cache_generic__ *prev_cache;         /* prev lower level cache   */
 } cache_generic_t;
 
 
+/* Configuration of one cache level */
+typedef struct cache_level_config__ {
+    uint32_t            size;                   /* total cache size         */
+    uint16_t            set_assoc;              /* level of associativity   */
+    uint32_t            blk_size;               /* cache block size         */
+    uint8_t             repl_plcy;              /* replacement policy       */
+    uint8_t             write_plcy;             /* write policy             */
+    uint16_t            hit_latency;            /* total latency on a hit   */
+    uint8_t             pf_type;                /* prefetcher, CACHE_PF_*   */
+    uint8_t             pf_degree;              /* prefetch degree          */
+} cache_level_config_t;
+
+/* Configuration of the whole cache hierarchy, L1 outwards */
+typedef struct cache_config__ {
+    uint32_t            num_levels;             /* # of cache levels        */
+    cache_level_config_t levels[CACHE_MAX_LEVELS];
+    uint32_t            victim_size;            /* L1 VC size, 0 = no VC    */
+    uint16_t            victim_hit_latency;     /* total latency on VC hit  */
+    uint16_t            mem_latency;            /* total latency to memory  */
+    uint32_t            set_sample;             /* L2+: simulate 1 in n sets*/
+    uint8_t             addr_bits;              /* # of address bits        */
+    const char          *trace_file;            /* trace file name          */
+} cache_config_t;
+
+
+/* Batch of memory references issued to a cache in a cycle */
+typedef struct cache_batch__ {
+    uint32_t            count;                  /* # of refs in the batch   */
+    uint32_t            size;                   /* max # of refs            */
+    mem_ref_t           *mrefs;                 /* refs, in program order   */
+    cache_line_t        *lines;                 /* decoded refs             */
+    uint32_t            *latencies;             /* latency of each ref      */
+    boolean             *accepted;              /* FALSE if ref must retry  */
+} cache_batch_t;
+
+
+/* Global state of a cache hierarchy, to run two of them side by side */
+typedef struct cache_ctx__ {
+    cache_generic_t     l1_cache;
+    cache_generic_t     l2_cache;
+    cache_generic_t     vic_cache;
+    cache_tagstore_t    l1_cache_ts;
+    cache_tagstore_t    l2_cache_ts;
+    cache_tagstore_t    vic_cache_ts;
+    cache_generic_t     lx_caches[CACHE_MAX_LEVELS - 2];
+    cache_tagstore_t    lx_cache_ts[CACHE_MAX_LEVELS - 2];
+    uint32_t            addr_count;
+    uint32_t            cycle;
+    uint64_t            age;
+    uint32_t            sample_rand;
+} cache_ctx_t;
+
+
 /* Externs */
 extern boolean          g_l2_present;
 extern boolean          g_victim_present;
+extern boolean          g_tag_index_present;
 extern cache_generic_t  g_l1_cache;
 extern cache_generic_t  g_l2_cache;
 extern cache_generic_t  g_vic_cache;
 extern cache_tagstore_t g_l1_cache_ts;
 extern cache_tagstore_t g_l2_cache_ts;
 extern cache_tagstore_t g_vic_cache_ts;
+extern cache_generic_t  g_lx_caches[CACHE_MAX_LEVELS - 2];
+extern cache_tagstore_t g_lx_cache_ts[CACHE_MAX_LEVELS - 2];
+extern uint16_t         g_cache_mem_latency;
+extern uint8_t          g_cache_addr_bits;
+extern uint8_t          g_cache_dump_order;
 extern const char       *g_dirty;
 extern const char       *g_l1_name;
 extern const char       *g_l2_name;
@@ -132,12 +308,13 @@ extern const char       *g_vic_name;
 extern const char       *g_read;
 extern const char       *g_write;
 extern uint32_t         g_addr_count;
+extern uint32_t         g_cache_cycle;
+extern uint64_t         g_cache_age;
 
 
 /* Function declarations */
 void
-cache_init(cache_generic_t *l1_cache, cache_generic_t *vic_cache,
-        cache_generic_t *l2_cache, int num_args, char **argv);
+cache_init(const cache_config_t *config);
 void
 cache_cleanup(cache_generic_t *pcache);
 void
@@ -146,7 +323,7 @@ void
 cache_tagstore_cleanup(cache_generic_t *cache, cache_tagstore_t *tagstore);
 boolean
 cache_handle_memory_request(cache_generic_t *cache, mem_ref_t *mem_ref,
-        uint16_t *latency);
+        uint32_t *latency);
 void
 cache_handle_read_request(cache_generic_t *cache, mem_ref_t *mem_ref, 
         cache_line_t *line);
@@ -157,6 +334,13 @@ int32_t
 cache_get_first_invalid_block(cache_tagstore_t *tagstore, cache_line_t *line);
 int32_t
 cache_does_tag_match(cache_tagstore_t *tagstore, cache_line_t *line);
+void
+cache_tagstore_set_tag(cache_tagstore_t *tagstore, uint32_t index,
+        uint32_t block_id, cache_tag_t tag);
+cache_tag_t
+cache_tagstore_get_tag(cache_tagstore_t *tagstore, uint32_t tag_index);
+void
+cache_tagstore_rebuild(cache_tagstore_t *tagstore);
 int32_t
 cache_get_lru_block(cache_tagstore_t *tagstore, mem_ref_t *mref,
         cache_line_t *line);
@@ -169,8 +353,26 @@ void
 cache_handle_dirty_tag_evicts(cache_generic_t *cache, mem_ref_t *mem_ref, 
         uint32_t block_id);
 void
+cache_handle_line(cache_generic_t *cache, mem_ref_t *mem_ref,
+        cache_line_t *line, int32_t block_id, boolean merged,
+        uint32_t *latency);
+void
 cache_evict_and_add_tag(cache_generic_t *cache, mem_ref_t *mem_ref,
-        uint16_t *latency);
+        uint32_t *latency);
+void
+cache_set_cycle(uint32_t cycle);
+void
+cache_batch_init(cache_batch_t *batch, uint32_t size);
+void
+cache_batch_cleanup(cache_batch_t *batch);
+void
+cache_handle_memory_batch(cache_generic_t *cache, cache_batch_t *batch);
+void
+cache_ctx_init(cache_ctx_t *ctx);
+void
+cache_ctx_swap(cache_ctx_t *ctx);
+cache_generic_t *
+cache_ctx_get_cache(cache_ctx_t *ctx, cache_generic_t *cache);
 
 #endif /* DIS_CACHE_H_ */
 
@@ -0,0 +1,128 @@
+/*
+ * ECE 521 - Computer Design Techniques, Fall 2014
+ * Project 3 - Dynamic Instruction Scheduler
+ *
+ * This module writes the per cycle log of the pipeline, for diffing two
+ * engines line by line. At the end of every cycle it writes:
+ *  - A 'C' line with the cycle, the dispatch, issue, exec, LSQ and
+ *    writeback list lengths, and then the reads, read misses, writes, write
+ *    misses and write backs of every cache level, the victim cache swaps
+ *    and the L1 MSHR primary, merged and full stall counts, where present.
+ *  - An 'I' line for each inst done in the cycle, with its IF, ID, IS, EX
+ *    and WB cycles. The engines complete insts of a cycle in different
+ *    orders, so these go by inst number.
+ *
+ * Author: Aravindhan Dhanasekaran <adhanas@ncsu.edu>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "dis.h"
+#include "dis-utils.h"
+#include "dis-pipeline.h"
+#include "dis-cyclelog.h"
+#include "utlist.h"
+
+
+/* Opens the log file, if one was given. */
+bool
+dis_cyclelog_init(struct dis_input *dis)
+{
+    struct dis_cyclelog *log = &dis->cyclelog;
+
+    if (!log->path[0])
+        return TRUE;
+
+    /* Insts are done only from the exec list. */
+    log->done = (struct dis_inst_data **) malloc((dis->n *
+                EXEC_LIST_FACTOR) * sizeof(*log->done));
+    if (!log->done) {
+        dprint("ERROR: Unable to allocate memory for the cycle log.\n");
+        goto error_exit;
+    }
+
+    log->fptr = fopen(log->path, "w");
+    if (!log->fptr) {
+        dprint("ERROR: Unable to open cycle log file %s.\n", log->path);
+        goto error_exit;
+    }
+    fprintf(log->fptr, "# C cycle disp issue exec lsq wback "
+            "[reads rmisses writes wmisses wbacks]... [swaps] "
+            "[primary merged full]\n");
+    fprintf(log->fptr, "# I inst IF ID IS EX WB\n");
+    return TRUE;
+
+error_exit:
+    dis_cyclelog_cleanup(dis);
+    return FALSE;
+}
+
+
+/* Closes the log file. */
+void
+dis_cyclelog_cleanup(struct dis_input *dis)
+{
+    struct dis_cyclelog *log = &dis->cyclelog;
+
+    if (log->fptr) {
+        fclose(log->fptr);
+        log->fptr = NULL;
+    }
+    free(log->done);
+    log->done = NULL;
+    return;
+}
+
+
+/* Logs the state at the end of the current cycle. */
+void
+dis_cyclelog_cycle(struct dis_input *dis)
+{
+    uint32_t                i = 0;
+    uint32_t                j = 0;
+    uint32_t                count = 0;
+    cache_generic_t         *cache = NULL;
+    struct dis_inst_node    *iter = NULL;
+    struct dis_inst_data    *data = NULL;
+    struct dis_cyclelog     *log = &dis->cyclelog;
+    FILE                    *fptr = log->fptr;
+
+    fprintf(fptr, "C %u %u %u %u %u %u", dis_get_cycle_num(),
+            dis_inst_list_get_len(dis, LIST_DISP),
+            dis_inst_list_get_len(dis, LIST_ISSUE),
+            dis_inst_list_get_len(dis, LIST_EXEC),
+            dis_inst_list_get_len(dis, LIST_LSQ),
+            dis_inst_list_get_len(dis, LIST_WBACK));
+    for (cache = dis->l1; cache; cache = cache->next_cache)
+        fprintf(fptr, " %u %u %u %u %u", cache->stats.num_reads,
+                cache->stats.num_read_misses, cache->stats.num_writes,
+                cache->stats.num_write_misses, cache->stats.num_write_backs);
+    if (dis->vc)
+        fprintf(fptr, " %u", dis->vc->stats.num_swaps);
+    if (dis->l1 && dis->l1->mshr)
+        fprintf(fptr, " %u %u %u", dis->l1->mshr->num_primary,
+                dis->l1->mshr->num_secondary,
+                dis->l1->mshr->num_full_stalls);
+    fprintf(fptr, "\n");
+
+    /* The insts which made it to the writeback list this cycle, by inst
+     * number; retire empties the list at the start of every cycle.
+     */
+    DL_FOREACH(dis->list_wback->list, iter) {
+        dis_assert(count < (dis->n * EXEC_LIST_FACTOR));
+        for (j = count++; j && (log->done[j - 1]->num > iter->data->num); --j)
+            log->done[j] = log->done[j - 1];
+        log->done[j] = iter->data;
+    }
+
+    for (i = 0; i < count; ++i) {
+        data = log->done[i];
+        fprintf(fptr, "I %u %u %u %u %u %u\n", data->num,
+                data->cycle[STATE_IF], data->cycle[STATE_ID],
+                data->cycle[STATE_IS], data->cycle[STATE_EX],
+                data->cycle[STATE_WB]);
+    }
+    return;
+}
@@ -0,0 +1,24 @@
+/*
+ * ECE 521 - Computer Design Techniques, Fall 2014
+ * Project 3 - Dynamic Instruction Scheduler
+ *
+ * This module contains the function declarations for the per cycle log of
+ * the pipeline and cache state, which two engines are diffed on.
+ *
+ * Author: Aravindhan Dhanasekaran <adhanas@ncsu.edu>
+ */
+
+#ifndef DIS_CYCLELOG_H_
+#define DIS_CYCLELOG_H_
+
+#include "dis.h"
+
+/* Function declarations */
+bool
+dis_cyclelog_init(struct dis_input *dis);
+void
+dis_cyclelog_cleanup(struct dis_input *dis);
+void
+dis_cyclelog_cycle(struct dis_input *dis);
+
+#endif /* DIS_CYCLELOG_H_ */
@@ -0,0 +1,132 @@
+/*
+ * ECE 521 - Computer Design Techniques, Fall 2014
+ * Project 3 - Dynamic Instruction Scheduler
+ *
+ * This module implements the dataflow limit mode. With an infinite window
+ * and bandwidth, an inst starts as soon as its source regs are written and
+ * finishes its latency later, so the earliest completion cycle of every inst
+ * follows from one pass over the trace, keeping only the cycle at which each
+ * arch reg is written by its latest producer. The longest completion is the
+ * critical path of the trace, and the dataflow limit IPC follows from it.
+ *
+ * Mem insts look up the caches in program order, at their start cycle, and
+ * take the cache latency in place of the type 2 latency; the non-blocking
+ * L1 model needs the cycle loop and is not supported here.
+ *
+ * Author: Aravindhan Dhanasekaran <adhanas@ncsu.edu>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+
+#include "dis.h"
+#include "dis-utils.h"
+#include "dis-pipeline.h"
+#include "dis-cache.h"
+#include "dis-dataflow.h"
+
+
+/* Returns the cycle at which the given source reg is written. */
+static inline uint32_t
+dis_dataflow_get_ready(struct dis_dataflow *df, int32_t reg)
+{
+    return ((REG_NO_VALUE == reg) ? 0 : df->reg_ready[reg]);
+}
+
+
+/*
+ * Looks up the caches for a mem inst starting at the given cycle and
+ * returns the latency.
+ */
+static uint32_t
+dis_dataflow_cache_lookup(struct dis_input *dis, uint32_t start,
+        mem_addr_t pc, mem_addr_t mem_addr, bool mem_write)
+{
+    cache_batch_t *batch = &dis->mem_batch;
+
+    batch->mrefs[0].ref_type = (mem_write ?
+            MEM_REF_TYPE_WRITE : MEM_REF_TYPE_READ);
+    batch->mrefs[0].ref_addr = mem_addr;
+    batch->mrefs[0].ref_src = MEM_REF_SRC_DEMAND;
+    batch->mrefs[0].ref_pc = pc;
+    batch->count = 1;
+
+    cache_set_cycle(start);
+    cache_handle_memory_batch(dis->l1, batch);
+    dis_assert(batch->accepted[0]);
+    return batch->latencies[0];
+}
+
+
+/*
+ * Runs the whole trace in one pass and records the critical path length.
+ * Every inst is numbered as it is read, as in the fetch stage.
+ */
+bool
+dis_dataflow_run(struct dis_input *dis)
+{
+    char                line[TRACE_LINE_LEN];
+    char                mem_op[2];
+    int                 num_fields = 0;
+    int32_t             dreg = 0;
+    int32_t             sreg1 = 0;
+    int32_t             sreg2 = 0;
+    uint32_t            inst_type = 0;
+    uint32_t            start = 0;
+    uint32_t            ready = 0;
+    uint32_t            latency = 0;
+    mem_addr_t          pc = 0;
+    mem_addr_t          mem_addr = 0;
+    struct dis_dataflow *df = NULL;
+
+    if (!dis) {
+        dis_assert(0);
+        goto error_exit;
+    }
+    df = &dis->dataflow;
+
+    memset(df->reg_ready, 0, sizeof(df->reg_ready));
+    df->path_len = 0;
+
+    /* Same trace format as the fetch stage; refer to dis_fetch_sn(). */
+    while (fgets(line, sizeof(line), g_trace_fptr)) {
+        mem_op[0] = 'r';
+        num_fields = sscanf(line, "%" SCNx64 " %u %d %d %d %" SCNx64 " %1s",
+                &pc, &inst_type, &dreg, &sreg1, &sreg2, &mem_addr, mem_op);
+        if (num_fields < 6)
+            continue;
+
+        dis_get_next_inst_num();
+
+        /* Start once both the source regs are written. */
+        start = dis_dataflow_get_ready(df, sreg1);
+        ready = dis_dataflow_get_ready(df, sreg2);
+        if (ready > start)
+            start = ready;
+
+        /* With caches, type 2 insts take the cache latency instead. */
+        latency = g_latency[inst_type];
+        if (mem_addr & ~dis_get_addr_mask(dis))
+            dis_addr_too_wide(dis, mem_addr);
+        if ((TYPE_2 == inst_type) && dis->l1)
+            latency = 0;
+        if (mem_addr && dis->l1) {
+            latency += dis_dataflow_cache_lookup(dis, start, pc, mem_addr,
+                    (('w' == mem_op[0]) || ('W' == mem_op[0]) ||
+                     ('s' == mem_op[0])) ? TRUE : FALSE);
+        }
+
+        if (REG_NO_VALUE != dreg)
+            df->reg_ready[dreg] = (start + latency);
+
+        if ((start + latency) > df->path_len)
+            df->path_len = (start + latency);
+    }
+    return TRUE;
+
+error_exit:
+    return FALSE;
+}
@@ -0,0 +1,20 @@
+/*
+ * ECE 521 - Computer Design Techniques, Fall 2014
+ * Project 3 - Dynamic Instruction Scheduler
+ *
+ * This module contains the function declarations of the dataflow limit mode,
+ * which bounds the IPC of a trace by its true register dependencies alone.
+ *
+ * Author: Aravindhan Dhanasekaran <adhanas@ncsu.edu>
+ */
+
+#ifndef DIS_DATAFLOW_H_
+#define DIS_DATAFLOW_H_
+
+#include "dis.h"
+
+/* Function declarations */
+bool
+dis_dataflow_run(struct dis_input *dis);
+
+#endif /* DIS_DATAFLOW_H_ */
@@ -0,0 +1,208 @@
+/*
+ * ECE 521 - Computer Design Techniques, Fall 2014
+ * Project 3 - Dynamic Instruction Scheduler
+ *
+ * This module checks the fast pipeline engine against the reference one in
+ * lock-step (--engine lockstep). The reference engine runs as a shadow, on
+ * a dis data, trace file pointer, inst counter and cache hierarchy of its
+ * own; these globals are swapped in around its cycles. After every cycle
+ * of the fast engine the shadow runs the same cycle, and then the two are
+ * compared on:
+ *  - The length of each pipeline list.
+ *  - The state, latency and state-cycle history of every inst in flight,
+ *    in program order.
+ *  - The ready bit of every arch reg in the RMT.
+ *  - The LSQ, FU and, with --stall-stats, stall slot counts.
+ *  - The stats of every cache level and the L1 MSHR counts.
+ * The run quits at the first difference, naming the cycle and the field.
+ *
+ * Author: Aravindhan Dhanasekaran <adhanas@ncsu.edu>
+ */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dis.h"
+#include "dis-utils.h"
+#include "dis-pipeline.h"
+#include "dis-lockstep.h"
+#include "dis-cache.h"
+
+/* Reports the first difference between the engines and quits. */
+static void
+dis_lockstep_fail(uint64_t fast, uint64_t ref, const char *fmt, ...)
+{
+    va_list args;
+
+    dprint("ERROR: Engines differ at cycle %u, ", dis_get_cycle_num());
+    va_start(args, fmt);
+    vprintf(fmt, args);
+    va_end(args);
+    dprint(": fast %" PRIu64 ", ref %" PRIu64 ".\n", fast, ref);
+    exit(-1);
+}
+
+/* Compares a field of the two engines; the format names it. */
+#define dis_lockstep_check(fast, ref, ...)                                  \
+    do {                                                                    \
+        if ((uint64_t) (fast) != (uint64_t) (ref))                          \
+            dis_lockstep_fail((fast), (ref), __VA_ARGS__);                  \
+    } while (0)
+
+
+/* Swaps the globals of the running engine with the ones put aside. */
+void
+dis_lockstep_swap(struct dis_input *dis)
+{
+    uint32_t            inst_num = g_inst_num;
+    FILE                *trace_fptr = g_trace_fptr;
+    struct dis_lockstep *ls = &dis->lockstep;
+
+    g_inst_num = ls->inst_num;
+    g_trace_fptr = ls->trace_fptr;
+    ls->inst_num = inst_num;
+    ls->trace_fptr = trace_fptr;
+    cache_ctx_swap(ls->caches);
+    return;
+}
+
+
+/* Compares the insts in flight, in program order. */
+static void
+dis_lockstep_check_insts(struct dis_input *dis, struct dis_input *ref)
+{
+    uint32_t                state = 0;
+    struct dis_inst_data    *a = NULL;
+    struct dis_inst_data    *b = NULL;
+    struct dis_inst_node    *iter = NULL;
+    struct dis_inst_node    *ref_iter = NULL;
+
+    for (iter = dis->list_inst->list, ref_iter = ref->list_inst->list;
+            iter && ref_iter; iter = iter->next, ref_iter = ref_iter->next) {
+        a = iter->data;
+        b = ref_iter->data;
+        dis_lockstep_check(a->num, b->num, "inst in program order");
+        dis_lockstep_check(a->state, b->state, "state of inst %u", a->num);
+        dis_lockstep_check(a->latency, b->latency, "latency of inst %u",
+                a->num);
+        dis_lockstep_check(a->mem_done, b->mem_done,
+                "cache lookup done of inst %u", a->num);
+        dis_lockstep_check(a->mem_fwd, b->mem_fwd,
+                "LSQ forward of inst %u", a->num);
+        for (state = 0; state < STATE_MAX; ++state)
+            dis_lockstep_check(a->cycle[state], b->cycle[state],
+                    "cycle of state %u of inst %u", state, a->num);
+    }
+    return;
+}
+
+
+/* Compares the stats of every cache and the L1 MSHR counts. */
+static void
+dis_lockstep_check_caches(struct dis_input *dis)
+{
+    uint32_t        i = 0;
+    const uint32_t  *a = NULL;
+    const uint32_t  *b = NULL;
+    cache_generic_t *cache = NULL;
+    cache_generic_t *ref_cache = NULL;
+
+    for (cache = dis->l1; cache; cache = cache->next_cache) {
+        ref_cache = cache_ctx_get_cache(dis->lockstep.caches, cache);
+
+        /* The stats are all counters, up to the cache ptr. */
+        a = (const uint32_t *) &cache->stats;
+        b = (const uint32_t *) &ref_cache->stats;
+        for (i = 0; i < (offsetof(cache_stats_t, cache) / sizeof(*a)); ++i)
+            dis_lockstep_check(a[i], b[i], "%s stats counter %u",
+                    cache->name, i);
+
+        if (!cache->mshr)
+            continue;
+        dis_lockstep_check(cache->mshr->num_used, ref_cache->mshr->num_used,
+                "%s MSHRs in use", cache->name);
+        dis_lockstep_check(cache->mshr->num_primary,
+                ref_cache->mshr->num_primary, "%s primary misses",
+                cache->name);
+        dis_lockstep_check(cache->mshr->num_secondary,
+                ref_cache->mshr->num_secondary, "%s merged misses",
+                cache->name);
+        dis_lockstep_check(cache->mshr->num_full_stalls,
+                ref_cache->mshr->num_full_stalls, "%s MSHR full stalls",
+                cache->name);
+        dis_lockstep_check(cache->mshr->next_fill_cycle,
+                ref_cache->mshr->next_fill_cycle, "%s next fill cycle",
+                cache->name);
+    }
+    return;
+}
+
+
+/* Compares the state of the two engines at the end of a cycle. */
+static void
+dis_lockstep_compare(struct dis_input *dis, struct dis_input *ref)
+{
+    uint32_t    i = 0;
+    uint32_t    j = 0;
+
+    for (i = LIST_INST; i <= LIST_LSQ; ++i)
+        dis_lockstep_check(dis_inst_list_get_len(dis, i),
+                dis_inst_list_get_len(ref, i), "length of list %u", i);
+
+    dis_lockstep_check_insts(dis, ref);
+
+    for (i = 0; i < REG_TOTAL; ++i)
+        dis_lockstep_check(dis_is_reg_ready(dis, i), ref->ref_rmt[i].ready,
+                "RMT ready bit of reg %u", i);
+
+    dis_lockstep_check(dis->lsq_stats.num_loads, ref->lsq_stats.num_loads,
+            "LSQ loads");
+    dis_lockstep_check(dis->lsq_stats.num_stores, ref->lsq_stats.num_stores,
+            "LSQ stores");
+    dis_lockstep_check(dis->lsq_stats.num_fwds, ref->lsq_stats.num_fwds,
+            "LSQ forwards");
+    dis_lockstep_check(dis->lsq_stats.num_held, ref->lsq_stats.num_held,
+            "LSQ held loads");
+    dis_lockstep_check(dis->lsq_stats.num_full_stalls,
+            ref->lsq_stats.num_full_stalls, "LSQ full stalls");
+
+    for (i = 0; i < TYPE_MAX; ++i) {
+        dis_lockstep_check(dis->fu[i].num_issued, ref->fu[i].num_issued,
+                "insts issued to FU pool %u", i);
+        dis_lockstep_check(dis->fu[i].num_stalls, ref->fu[i].num_stalls,
+                "stalls of FU pool %u", i);
+    }
+
+    for (i = 0; dis->stalls.on && (i < STALL_STAGE_MAX); ++i) {
+        for (j = 0; j < STALL_MAX; ++j)
+            dis_lockstep_check(dis->stalls.slots[i][j],
+                    ref->stalls.slots[i][j],
+                    "slots of stage %u for stall reason %u", i, j);
+    }
+
+    if (dis->l1)
+        dis_lockstep_check_caches(dis);
+    return;
+}
+
+
+/*
+ * Runs the shadow thru the cycle the fast engine has just run, and
+ * compares the two; quits if they differ.
+ */
+void
+dis_lockstep_cycle(struct dis_input *dis)
+{
+    struct dis_lockstep *ls = &dis->lockstep;
+
+    dis_lockstep_swap(dis);
+    ls->trace_done = dis_cycle_ref(ls->ref, ls->trace_done);
+    dis_lockstep_swap(dis);
+
+    dis_lockstep_compare(dis, ls->ref);
+    return;
+}
@@ -0,0 +1,22 @@
+/*
+ * ECE 521 - Computer Design Techniques, Fall 2014
+ * Project 3 - Dynamic Instruction Scheduler
+ *
+ * This module contains the function declarations for the lock-step check of
+ * the fast pipeline engine against the reference one.
+ *
+ * Author: Aravindhan Dhanasekaran <adhanas@ncsu.edu>
+ */
+
+#ifndef DIS_LOCKSTEP_H_
+#define DIS_LOCKSTEP_H_
+
+#include "dis.h"
+
+/* Function declarations */
+void
+dis_lockstep_swap(struct dis_input *dis);
+void
+dis_lockstep_cycle(struct dis_input *dis);
+
+#endif /* DIS_LOCKSTEP_H_ */
@@ -0,0 +1,188 @@
+/*
+ * ECE 521 - Computer Design Techniques, Fall 2014
+ * Project 3 - Dynamic Instruction Scheduler
+ *
+ * This module records the occupancy of the dispatch list (2N), the issue
+ * list (S), the exec list (5N) and of all the insts in flight at the end of
+ * every cycle. Each queue keeps a histogram with one counter per length, so
+ * one run shows how much of a large S a workload really uses. The time
+ * series file, if asked for, gets the mean lengths over every 'interval'
+ * cycles.
+ *
+ * Author: Aravindhan Dhanasekaran <adhanas@ncsu.edu>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+
+#include "dis.h"
+#include "dis-utils.h"
+#include "dis-pipeline.h"
+#include "dis-occupancy.h"
+
+
+/* Returns the current length of the given queue. */
+static inline uint32_t
+dis_occupancy_get_len(struct dis_input *dis, uint8_t queue)
+{
+    switch (queue) {
+    case OCC_DISP:
+        return dis_inst_list_get_len(dis, LIST_DISP);
+    case OCC_ISSUE:
+        return dis_inst_list_get_len(dis, LIST_ISSUE);
+    case OCC_EXEC:
+        return dis_inst_list_get_len(dis, LIST_EXEC);
+    case OCC_ROB:
+        return (dis_inst_list_get_len(dis, LIST_DISP) +
+                dis_inst_list_get_len(dis, LIST_ISSUE) +
+                dis_inst_list_get_len(dis, LIST_EXEC));
+    default:
+        dis_assert(0);
+        return 0;
+    }
+}
+
+
+/* Writes the mean lengths of the cycles since the last line, if any. */
+static void
+dis_occupancy_flush_series(struct dis_input *dis)
+{
+    uint8_t                 queue = 0;
+    struct dis_occupancy    *occ = &dis->occupancy;
+
+    if (!occ->series || !occ->num_samples)
+        return;
+
+    fprintf(occ->series, "%u", (dis_get_cycle_num() + 1 - occ->num_samples));
+    for (queue = 0; queue < OCC_MAX; ++queue) {
+        fprintf(occ->series, " %.2f",
+                ((double) occ->sum[queue] / (double) occ->num_samples));
+        occ->sum[queue] = 0;
+    }
+    fprintf(occ->series, "\n");
+    occ->num_samples = 0;
+    return;
+}
+
+
+/*
+ * Sizes the histograms off S and N and opens the time series file, if one
+ * was given.
+ */
+bool
+dis_occupancy_init(struct dis_input *dis)
+{
+    uint8_t                 queue = 0;
+    struct dis_occupancy    *occ = &dis->occupancy;
+
+    if (!occ->on)
+        return TRUE;
+
+    occ->size[OCC_DISP] = (2 * dis->n);
+    occ->size[OCC_ISSUE] = dis->s;
+    occ->size[OCC_EXEC] = (dis->n * EXEC_LIST_FACTOR);
+    occ->size[OCC_ROB] = (occ->size[OCC_DISP] + occ->size[OCC_ISSUE] +
+            occ->size[OCC_EXEC]);
+
+    for (queue = 0; queue < OCC_MAX; ++queue) {
+        occ->hist[queue] = (uint64_t *) calloc((occ->size[queue] + 1),
+                sizeof(*occ->hist[queue]));
+        if (!occ->hist[queue]) {
+            dprint("ERROR: Unable to allocate memory for the occupancy "
+                    "histograms.\n");
+            goto error_exit;
+        }
+    }
+
+    if (occ->series_path[0]) {
+        occ->series = fopen(occ->series_path, "w");
+        if (!occ->series) {
+            dprint("ERROR: Unable to open occupancy file %s.\n",
+                    occ->series_path);
+            goto error_exit;
+        }
+        fprintf(occ->series, "# cycle disp issue exec rob; mean of %u "
+                "cycles\n", occ->interval);
+    }
+    return TRUE;
+
+error_exit:
+    dis_occupancy_cleanup(dis);
+    return FALSE;
+}
+
+
+/* Frees the histograms and closes the time series file. */
+void
+dis_occupancy_cleanup(struct dis_input *dis)
+{
+    uint8_t                 queue = 0;
+    struct dis_occupancy    *occ = &dis->occupancy;
+
+    for (queue = 0; queue < OCC_MAX; ++queue) {
+        free(occ->hist[queue]);
+        occ->hist[queue] = NULL;
+    }
+
+    if (occ->series) {
+        fclose(occ->series);
+        occ->series = NULL;
+    }
+    return;
+}
+
+
+/* Records the queue lengths at the end of the current cycle. */
+void
+dis_occupancy_sample(struct dis_input *dis)
+{
+    uint8_t                 queue = 0;
+    uint32_t                len = 0;
+    struct dis_occupancy    *occ = &dis->occupancy;
+
+    for (queue = 0; queue < OCC_MAX; ++queue) {
+        len = dis_occupancy_get_len(dis, queue);
+        dis_assert(len <= occ->size[queue]);
+        occ->hist[queue][len] += 1;
+        if (occ->series)
+            occ->sum[queue] += len;
+    }
+    occ->num_cycles += 1;
+
+    if (occ->series && (++occ->num_samples == occ->interval))
+        dis_occupancy_flush_series(dis);
+    return;
+}
+
+
+/* Writes out the last, partial, time series line; called once at the end. */
+void
+dis_occupancy_finish(struct dis_input *dis)
+{
+    dis_occupancy_flush_series(dis);
+    return;
+}
+
+
+/*
+ * Returns the smallest length the queue stayed at or below for percent% of
+ * the cycles.
+ */
+uint32_t
+dis_occupancy_get_percentile(struct dis_input *dis, uint8_t queue,
+        uint32_t percent)
+{
+    uint32_t                len = 0;
+    uint64_t                seen = 0;
+    struct dis_occupancy    *occ = &dis->occupancy;
+
+    for (len = 0; len < occ->size[queue]; ++len) {
+        seen += occ->hist[queue][len];
+        if ((seen * 100) >= (occ->num_cycles * percent))
+            break;
+    }
+    return len;
+}
@@ -0,0 +1,30 @@
+/*
+ * ECE 521 - Computer Design Techniques, Fall 2014
+ * Project 3 - Dynamic Instruction Scheduler
+ *
+ * This module contains the function declarations for recording the per cycle
+ * occupancy of the dispatch, issue and exec lists and of all the insts in
+ * flight, as histograms and as an optional time series file.
+ *
+ * Author: Aravindhan Dhanasekaran <adhanas@ncsu.edu>
+ */
+
+#ifndef DIS_OCCUPANCY_H_
+#define DIS_OCCUPANCY_H_
+
+#include "dis.h"
+
+/* Function declarations */
+bool
+dis_occupancy_init(struct dis_input *dis);
+void
+dis_occupancy_cleanup(struct dis_input *dis);
+void
+dis_occupancy_sample(struct dis_input *dis);
+void
+dis_occupancy_finish(struct dis_input *dis);
+uint32_t
+dis_occupancy_get_percentile(struct dis_input *dis, uint8_t queue,
+        uint32_t percent);
+
+#endif /* DIS_OCCUPANCY_H_ */
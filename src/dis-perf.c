@@ -0,0 +1,245 @@
+/*
+ * ECE 521 - Computer Design Techniques, Fall 2014
+ * Project 3 - Dynamic Instruction Scheduler
+ *
+ * This module reads the host hardware counters (instructions, cycles, cache
+ * misses and branch misses) around the main loop with perf_event_open on
+ * Linux. The counters go in one group, so the PMU schedules them together
+ * and their ratios come from the same samples. When the PMU multiplexes
+ * the group, the counts are scaled up by the time enabled over the time
+ * running; a group which never ran is reported as n/a. Counters which the
+ * host or its perf_event_paranoid setting does not allow are left out of
+ * the group, and reported as n/a; the wall clock time is always there.
+ *
+ * Author: Aravindhan Dhanasekaran <adhanas@ncsu.edu>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif /* __linux__ */
+
+#include "dis.h"
+#include "dis-utils.h"
+#include "dis-pipeline.h"
+#include "dis-perf.h"
+
+#ifdef __linux__
+static const uint64_t g_perf_configs[PERF_MAX] = {
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_MISSES};
+#endif /* __linux__ */
+
+
+/* Returns the wall clock time in nanoseconds. */
+static uint64_t
+dis_perf_get_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (((uint64_t) ts.tv_sec * 1000000000ULL) + ts.tv_nsec);
+}
+
+
+/*
+ * Opens a user space only counter of this process in the given group, or
+ * as the leader of a new one (group -1); -1 if not allowed. Only the leader
+ * starts out disabled; the rest follow it.
+ */
+static int
+dis_perf_open(uint32_t counter, int group)
+{
+#ifdef __linux__
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = g_perf_configs[counter];
+    attr.disabled = ((group < 0) ? 1 : 0);
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = (PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+            PERF_FORMAT_TOTAL_TIME_RUNNING);
+    return (int) syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+#else
+    return -1;
+#endif /* __linux__ */
+}
+
+
+/* Closes the counters, if still open; the leader goes last. */
+static void
+dis_perf_close(struct dis_input *dis)
+{
+    uint32_t        counter = 0;
+    struct dis_perf *perf = &dis->perf;
+
+    for (counter = 0; counter < PERF_MAX; ++counter) {
+#ifdef __linux__
+        if ((perf->fd[counter] >= 0) && (perf->fd[counter] != perf->leader))
+            close(perf->fd[counter]);
+#endif /* __linux__ */
+        perf->fd[counter] = -1;
+    }
+#ifdef __linux__
+    if (perf->leader >= 0)
+        close(perf->leader);
+#endif /* __linux__ */
+    perf->leader = -1;
+    perf->num_open = 0;
+    return;
+}
+
+
+/*
+ * Opens all the counters it can as one group, the first one allowed
+ * leading, and starts them and the wall clock.
+ */
+void
+dis_perf_start(struct dis_input *dis)
+{
+    uint32_t        counter = 0;
+    struct dis_perf *perf = &dis->perf;
+
+    perf->leader = -1;
+    perf->num_open = 0;
+    for (counter = 0; counter < PERF_MAX; ++counter) {
+        perf->fd[counter] = dis_perf_open(counter, perf->leader);
+        if (perf->fd[counter] < 0)
+            continue;
+        if (perf->leader < 0)
+            perf->leader = perf->fd[counter];
+        perf->order[perf->num_open++] = counter;
+    }
+
+#ifdef __linux__
+    if (perf->leader >= 0) {
+        ioctl(perf->leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(perf->leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+#endif /* __linux__ */
+    perf->start_ns = dis_perf_get_ns();
+    return;
+}
+
+
+/*
+ * Stops the counters and the wall clock and reads the group: the # of
+ * counters, the time enabled and running, and then the counts, in the
+ * order the counters joined the group.
+ */
+void
+dis_perf_stop(struct dis_input *dis)
+{
+    uint32_t        i = 0;
+    uint64_t        buf[3 + PERF_MAX];
+    struct dis_perf *perf = &dis->perf;
+
+    perf->elapsed_ns = (dis_perf_get_ns() - perf->start_ns);
+    perf->running = 0;
+    for (i = 0; i < PERF_MAX; ++i)
+        perf->valid[i] = FALSE;
+
+#ifdef __linux__
+    if (perf->leader < 0)
+        goto exit;
+
+    ioctl(perf->leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    if (((ssize_t) ((3 + perf->num_open) * sizeof(buf[0])) !=
+                read(perf->leader, buf, sizeof(buf))) ||
+            (buf[0] != perf->num_open) || !buf[1] || !buf[2])
+        goto exit;
+
+    /* Multiplexed; scale up to the time enabled. */
+    perf->running = ((double) buf[2] / (double) buf[1]);
+    for (i = 0; i < perf->num_open; ++i) {
+        perf->count[perf->order[i]] = (uint64_t)
+            ((double) buf[3 + i] / perf->running);
+        perf->valid[perf->order[i]] = TRUE;
+    }
+
+exit:
+#endif /* __linux__ */
+    dis_perf_close(dis);
+    return;
+}
+
+
+/* Prints a counter, or n/a if it could not be read. */
+static void
+dis_perf_print_count(struct dis_perf *perf, const char *name,
+        uint32_t counter)
+{
+    if (perf->valid[counter])
+        dprint(" %-26s = %" PRIu64 "\n", name, perf->count[counter]);
+    else
+        dprint(" %-26s = n/a\n", name);
+    return;
+}
+
+
+/*
+ * Prints the host counters and what they mean for the simulator: host IPC,
+ * simulated insts per host second and host cache misses per simulated inst.
+ * The peak RSS comes along, for the benchmark harness.
+ */
+void
+dis_perf_print(struct dis_input *dis)
+{
+    double          num_insts = (double) dis_get_inst_num();
+    double          secs = 0.0;
+    struct rusage   usage;
+    struct dis_perf *perf = &dis->perf;
+
+    secs = ((double) perf->elapsed_ns / 1e9);
+
+    dprint("HOST PERFORMANCE\n");
+    dis_perf_print_count(perf, "host instructions", PERF_INSTRUCTIONS);
+    dis_perf_print_count(perf, "host cycles", PERF_CYCLES);
+    dis_perf_print_count(perf, "host cache misses", PERF_CACHE_MISSES);
+    dis_perf_print_count(perf, "host branch misses", PERF_BRANCH_MISSES);
+    if (perf->running > 0.0)
+        dprint(" %-26s = %.1f%%%s\n", "host counters running",
+                (perf->running * 100), ((perf->running < 1.0) ?
+                    ", counts scaled" : ""));
+    else
+        dprint(" %-26s = n/a\n", "host counters running");
+    dprint(" %-26s = %.6f\n", "host seconds", secs);
+
+    if (perf->valid[PERF_INSTRUCTIONS] && perf->valid[PERF_CYCLES] &&
+            perf->count[PERF_CYCLES])
+        dprint(" %-26s = %.2f\n", "host IPC",
+                ((double) perf->count[PERF_INSTRUCTIONS] /
+                 (double) perf->count[PERF_CYCLES]));
+    else
+        dprint(" %-26s = n/a\n", "host IPC");
+
+    if (secs > 0.0)
+        dprint(" %-26s = %.0f\n", "sim insts per host second",
+                (num_insts / secs));
+
+    if (perf->valid[PERF_CACHE_MISSES] && num_insts)
+        dprint(" %-26s = %.4f\n", "host LLC misses per inst",
+                ((double) perf->count[PERF_CACHE_MISSES] / num_insts));
+    else
+        dprint(" %-26s = n/a\n", "host LLC misses per inst");
+
+    /* Peak RSS of the whole run, in KB on Linux. */
+    if (!getrusage(RUSAGE_SELF, &usage))
+        dprint(" %-26s = %ld\n", "host peak RSS (KB)", usage.ru_maxrss);
+    return;
+}
@@ -0,0 +1,24 @@
+/*
+ * ECE 521 - Computer Design Techniques, Fall 2014
+ * Project 3 - Dynamic Instruction Scheduler
+ *
+ * This module contains the function declarations for measuring the
+ * simulator itself with the host hardware counters, around the main loop.
+ *
+ * Author: Aravindhan Dhanasekaran <adhanas@ncsu.edu>
+ */
+
+#ifndef DIS_PERF_H_
+#define DIS_PERF_H_
+
+#include "dis.h"
+
+/* Function declarations */
+void
+dis_perf_start(struct dis_input *dis);
+void
+dis_perf_stop(struct dis_input *dis);
+void
+dis_perf_print(struct dis_input *dis);
+
+#endif /* DIS_PERF_H_ */
@@ -11,7 +11,8 @@
 #ifndef DIS_PIPELINE_PRI_H_
 #define DIS_PIPELINE_PRI_H_
 
-extern uint32_t g_reg_name;
+/* Forces inlining where the callers pass in constants, e.g. S and N. */
+#define DIS_ALWAYS_INLINE   inline __attribute__((always_inline))
 
 /* Inline functions */
 /* Set the given state to the given inst. */
@@ -68,6 +69,9 @@ dis_inst_list_increment_len(struct dis_input *dis, uint8_t list)
     case LIST_WBACK:
         dis->list_wback->len += 1;
         return;
+    case LIST_LSQ:
+        dis->list_lsq->len += 1;
+        return;
     default:
         dis_assert(0);
         return;
@@ -100,6 +104,10 @@ dis_inst_list_decrement_len(struct dis_input *dis, uint8_t list)
         if (dis->list_wback->len)
             dis->list_wback->len -= 1;
         return;
+    case LIST_LSQ:
+        if (dis->list_lsq->len)
+            dis->list_lsq->len -= 1;
+        return;
     default:
         dis_assert(0);
         return;
@@ -107,20 +115,26 @@ dis_inst_list_decrement_len(struct dis_input *dis, uint8_t list)
 }
 
 
-/* Checks whether the given list is full (TRUE) or not (FALSE). */
+/*
+ * Checks whether the given list of a pipeline with scheduling queue size s
+ * and width n is full (TRUE) or not (FALSE). The cycle kernels pass in
+ * constants for s and n, so that the bounds fold into immediates.
+ */
 static inline bool
-dis_is_list_full(struct dis_input *dis, uint8_t list)
+dis_is_list_full_sn(struct dis_input *dis, uint8_t list, const uint32_t s,
+        const uint32_t n)
 {
     switch (list) {
     case LIST_INST:
         return TRUE;
     case LIST_DISP:
-        return ((dis_inst_list_get_len(dis, LIST_DISP) >= (2 * dis->n)));
+        return ((dis_inst_list_get_len(dis, LIST_DISP) >= (2 * n)));
     case LIST_ISSUE:
-        return ((dis_inst_list_get_len(dis, LIST_ISSUE) >= dis->s));
+        return ((dis_inst_list_get_len(dis, LIST_ISSUE) >= s));
     case LIST_EXEC:
-        //return ((dis_inst_list_get_len(dis, LIST_EXEC) >= dis->n));
-        return ((dis_inst_list_get_len(dis, LIST_EXEC) >= (dis->n * 5)));
+        return ((dis_inst_list_get_len(dis, LIST_EXEC) >= (n * EXEC_LIST_FACTOR)));
+    case LIST_LSQ:
+        return ((dis_inst_list_get_len(dis, LIST_LSQ) >= dis->lsq_size));
     default:
         dis_assert(0);
         return TRUE;
@@ -128,6 +142,14 @@ dis_is_list_full(struct dis_input *dis, uint8_t list)
 }
 
 
+/* Checks whether the given list is full (TRUE) or not (FALSE). */
+static inline bool
+dis_is_list_full(struct dis_input *dis, uint8_t list)
+{
+    return dis_is_list_full_sn(dis, list, dis->s, dis->n);
+}
+
+
 /* Checks whether an inst could be added to the given list. */
 static inline bool
 dis_can_push_on_list(struct dis_input *dis, uint8_t list)
@@ -141,6 +163,8 @@ dis_can_push_on_list(struct dis_input *dis, uint8_t list)
         return !dis_is_list_full(dis, LIST_ISSUE);
     case LIST_EXEC:
         return !dis_is_list_full(dis, LIST_EXEC);
+    case LIST_LSQ:
+        return !dis_is_list_full(dis, LIST_LSQ);
     default:
         dis_assert(0);
         return FALSE;
@@ -148,11 +172,36 @@ dis_can_push_on_list(struct dis_input *dis, uint8_t list)
 }
 
 
-/* Returns a new register name. */
+/* Returns a free register name. */
 static inline uint32_t
-dis_get_new_reg_name(void)
+dis_get_new_reg_name(struct dis_input *dis)
+{
+    uint32_t name = 0;
+
+    dis_assert(dis->prf.num_free);
+    name = dis->prf.free_list[--dis->prf.num_free];
+    dis->prf.num_deps[name] = 0;
+    return name;
+}
+
+
+/* Charges the given # of slots of a stage to a stall reason. */
+static inline void
+dis_stall_count(struct dis_input *dis, uint8_t stage, uint8_t reason,
+        uint32_t slots)
+{
+    dis->stalls.slots[stage][reason] += slots;
+    return;
+}
+
+
+/* Puts a dead register name back on the free list. */
+static inline void
+dis_free_reg_name(struct dis_input *dis, uint32_t name)
 {
-    return ++g_reg_name;
+    dis_assert(dis->prf.num_free < dis->prf.num_regs);
+    dis->prf.free_list[dis->prf.num_free++] = name;
+    return;
 }
 
 
@@ -164,28 +213,130 @@ dis_reg_set_ready_bit(struct dis_input *dis, uint16_t regno)
         dis_assert(0);
         goto exit;
     }
-    dis->rmt[regno]->ready = TRUE;
+    dis->rmt[regno] |= RMT_READY_BIT;
 
 exit:
     return;
 }
 
 
-/* Assigns a new name to the register and clears the ready bit. */
+/*
+ * Assigns a new name to the register and clears the ready bit. The old name
+ * is dead if its producer is done already; else it is freed on completion.
+ */
 static inline void
 dis_rename_reg(struct dis_input *dis, uint16_t regno, bool dreg)
 {
+    uint32_t old_entry = 0;
+
     if (!dis_is_reg_valid(regno)) {
         dis_assert(0);
         return;
     }
 
-    dis->rmt[regno]->name = dis_get_new_reg_name();
-    dis->rmt[regno]->cycle = dis_get_cycle_num();
-    if (dreg)
-        dis->rmt[regno]->ready = FALSE;
+    old_entry = dis->rmt[regno];
+    dis->rmt[regno] = (dis_get_new_reg_name(dis) |
+            (dreg ? 0 : (old_entry & RMT_READY_BIT)));
+    if (old_entry & RMT_READY_BIT)
+        dis_free_reg_name(dis, (old_entry & RMT_NAME_MASK));
     return;
 }
 
+
+
+/*
+ * Makes the select key of an inst from its policy priority; the lower, the
+ * sooner it issues. The critical path policy goes by the # of insts which
+ * dispatched waiting on this one till it became ready.
+ */
+static inline uint64_t
+dis_select_make_key(struct dis_input *dis, struct dis_inst_data *data,
+        uint32_t num_deps)
+{
+    uint64_t prio = 0;
+
+    switch (dis->select) {
+    case SELECT_LOADS_FIRST:
+        prio = (((TYPE_2 == data->type) && !data->mem_write) ? 0 : 1);
+        break;
+
+    case SELECT_LONGEST_LATENCY:
+        prio = (FU_MAX_LATENCY - g_latency[data->type]);
+        break;
+
+    case SELECT_CRITICAL_PATH:
+        prio = (UINT32_MAX - num_deps);
+        break;
+
+    default:
+        break;
+    }
+    return ((prio << 32) | data->num);
+}
+
+
+/* Computes the select key of an inst as it goes on the ready heap. */
+static inline uint64_t
+dis_select_get_key(struct dis_input *dis, struct dis_inst_node *node)
+{
+    return dis_select_make_key(dis, node->data,
+            (dis_is_reg_valid(node->data->dreg) ?
+             dis->prf.num_deps[node->dreg.name] : 0));
+}
+
+
+/* Puts an inst on the ready heap, by the select key it already has. */
+static inline void
+dis_ready_insert(struct dis_input *dis, struct dis_inst_node *node)
+{
+    uint32_t                pos = 0;
+    struct dis_ready_heap   *heap = &dis->ready;
+
+    dis_assert(heap->count < heap->size);
+    for (pos = heap->count++; pos; pos = ((pos - 1) / 2)) {
+        if (heap->nodes[(pos - 1) / 2]->data->sel_key < node->data->sel_key)
+            break;
+        heap->nodes[pos] = heap->nodes[(pos - 1) / 2];
+    }
+    heap->nodes[pos] = node;
+    return;
+}
+
+
+/* Puts an inst of the issue list which just became ready on the heap. */
+static inline void
+dis_ready_push(struct dis_input *dis, struct dis_inst_node *node)
+{
+    node->data->sel_key = dis_select_get_key(dis, node);
+    dis_ready_insert(dis, node);
+    return;
+}
+
+
+/* Takes the ready inst with the lowest select key off the ready heap. */
+static inline struct dis_inst_node *
+dis_ready_pop(struct dis_input *dis)
+{
+    uint32_t                pos = 0;
+    uint32_t                child = 0;
+    struct dis_inst_node    *top = NULL;
+    struct dis_inst_node    *last = NULL;
+    struct dis_ready_heap   *heap = &dis->ready;
+
+    top = heap->nodes[0];
+    last = heap->nodes[--heap->count];
+    for (pos = 0; (child = ((2 * pos) + 1)) < heap->count; pos = child) {
+        if (((child + 1) < heap->count) &&
+                (heap->nodes[child + 1]->data->sel_key <
+                 heap->nodes[child]->data->sel_key))
+            child += 1;
+        if (last->data->sel_key < heap->nodes[child]->data->sel_key)
+            break;
+        heap->nodes[pos] = heap->nodes[child];
+    }
+    heap->nodes[pos] = last;
+    return top;
+}
+
 #endif /* DIS_PIPELINE_PRI_H_ */
 
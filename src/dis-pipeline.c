@@ -18,11 +18,12 @@
 #include "dis-print.h"
 #include "dis-pipeline.h"
 #include "dis-pipeline-pri.h"
+#include "dis-sched.h"
+#include "dis-prof.h"
 #include "dis-cache.h"
 #include "utlist.h"
 
 /* Private globals. */
-uint32_t    g_reg_name = 0;     /* running register name for renames    */
 uint8_t     g_latency[] = {     /* cycle latency based on inst type     */
                     LATENCY_TYPE_0,
                     LATENCY_TYPE_1,
@@ -30,14 +31,17 @@ uint8_t     g_latency[] = {     /* cycle latency based on inst type     */
 
 
 /*
- * Retire stage. Go over the main inst list and print out the entries
- * in WB stage. Finally remove them from the list.
+ * Retire stage. The insts which reached WB stage since the last cycle leave
+ * the writeback list; the cycle log has seen them by now. Then the done
+ * insts at the head of the inst list are printed and freed, in program
+ * order, so the memory held stays bounded by the window and not by the
+ * trace length. The writeback list length still counts all the done insts.
  */
 bool
 dis_retire(struct dis_input *dis)
 {
-    struct dis_inst_node    *tmp = NULL;
     struct dis_inst_node    *iter = NULL;
+    struct dis_inst_node    *tmp = NULL;
 
     if (!dis) {
         dis_assert(0);
@@ -45,22 +49,30 @@ dis_retire(struct dis_input *dis)
     }
 
     DL_FOREACH_SAFE(dis->list_wback->list, iter, tmp) {
-        if (STATE_WB != dis_inst_get_state(iter)) {
-            dis_assert(0);
-            continue;
-        }
-
-#if 0
-        DL_DELETE(dis->list_inst->list, iter);
-        dis_inst_list_decrement_len(dis, LIST_ISSUE);
-#endif
+        dis_assert(STATE_WB == dis_inst_get_state(iter));
+        DL_DELETE(dis->list_wback->list, iter);
+        free(iter);
+    }
 
+    /* The LSQ head is never done, so no inst freed here is in the LSQ or
+     * newer than its head; see dis_lsq_get_store.
+     */
+    while ((iter = dis->list_inst->list) &&
+            (STATE_WB == dis_inst_get_state(iter))) {
         dprint_info("inst %u, WB-->NA, inst(%u)-->inst(%u), cycle %u\n",
             iter->data->num, dis_inst_list_get_len(dis, LIST_INST),
-            dis_inst_list_get_len(dis, LIST_INST), dis_get_cycle_num());
+            (dis_inst_list_get_len(dis, LIST_INST) - 1),
+            dis_get_cycle_num());
 
-        /* DAN_TODO: Fix this. */
-        //free(iter);
+#ifndef GRAPH_ON
+        /* A lock-step shadow only runs to be compared. */
+        if (!dis->lockstep.shadow)
+            dis_print_inst_retire(dis, iter);
+#endif /* !GRAPH_ON */
+        DL_DELETE(dis->list_inst->list, iter);
+        dis_inst_list_decrement_len(dis, LIST_INST);
+        free(iter->data);
+        free(iter);
     }
     return TRUE;
 
@@ -69,22 +81,200 @@ error_exit:
 }
 
 
-/* Put the give inst on writeback list. */
+/* Moves the given inst from the exec list to the writeback list. */
 static bool
 dis_wback_push_inst(struct dis_input *dis, struct dis_inst_node *inst)
+{
+    DL_DELETE(dis->list_exec->list, inst);
+    dis_inst_list_decrement_len(dis, LIST_EXEC);
+
+    DL_APPEND(dis->list_wback->list, inst);
+    dis_inst_list_increment_len(dis, LIST_WBACK);
+
+    return TRUE;
+}
+
+
+/*
+ * Returns the bucket slot of the youngest store in the LSQ to the word of
+ * the given address; the slot is NULL if there is none.
+ */
+static inline struct dis_inst_node **
+dis_lsq_get_word(struct dis_input *dis, mem_addr_t addr)
+{
+    mem_addr_t              word = (addr & LSQ_WORD_MASK);
+    struct dis_inst_node    **slot = NULL;
+
+    slot = &dis->lsq_words[((word >> 2) ^ (word >> 14)) &
+        dis->lsq_words_mask];
+    while (*slot && ((*slot)->data->mem_addr & LSQ_WORD_MASK) != word)
+        slot = &(*slot)->link;
+    return slot;
+}
+
+
+/*
+ * Returns the youngest store still in the LSQ, older than the given mem
+ * inst and to its word. Stores leave the LSQ as they complete, out of
+ * order, so the chain may run thru a few which have left already. Done
+ * insts older than the LSQ head may be freed, and so are not followed.
+ */
+static inline struct dis_inst_data *
+dis_lsq_get_store(struct dis_input *dis, struct dis_inst_data *data)
+{
+    uint32_t                oldest = dis->list_lsq->list->data->num;
+    struct dis_inst_data    *store = data;
+
+    do {
+        if (!store->lsq_store || (store->lsq_store_num < oldest))
+            return NULL;
+        store = store->lsq_store;
+    } while (!store->lsq_node);
+    return store;
+}
+
+
+/* Notes the youngest older store to the word of the given mem inst. */
+static inline void
+dis_lsq_set_store(struct dis_inst_data *data, struct dis_inst_data *store)
+{
+    data->lsq_store = store;
+    data->lsq_store_num = (store ? store->num : 0);
+    return;
+}
+
+
+/*
+ * Puts the given mem inst at the tail of the LSQ, i.e., in program order.
+ * Both loads and stores note the youngest older store to their word; a
+ * store then becomes the youngest one to it.
+ */
+static void
+dis_lsq_push_inst(struct dis_input *dis, struct dis_inst_data *data)
 {
     struct dis_inst_node *node = NULL;
+    struct dis_inst_node **slot = NULL;
 
     node = (struct dis_inst_node *) calloc(1, sizeof(*node));
-    node->data = inst->data;
+    node->data = data;
+    data->lsq_node = node;
+
+    DL_APPEND(dis->list_lsq->list, node);
+    dis_inst_list_increment_len(dis, LIST_LSQ);
+
+    slot = dis_lsq_get_word(dis, data->mem_addr);
+    dis_lsq_set_store(data, (*slot ? (*slot)->data : NULL));
+    if (data->mem_write) {
+        node->link = (*slot ? (*slot)->link : NULL);
+        *slot = node;
+        dis->lsq_stats.num_stores += 1;
+    } else {
+        dis->lsq_stats.num_loads += 1;
+    }
+    return;
+}
 
-    DL_APPEND(dis->list_wback->list, node);
-    dis_inst_list_increment_len(dis, LIST_WBACK);
 
+/*
+ * Removes the given mem inst from the LSQ. If it was the youngest store to
+ * its word, the youngest older one still in the LSQ takes its place.
+ */
+static void
+dis_lsq_remove_inst(struct dis_input *dis, struct dis_inst_data *data)
+{
+    struct dis_inst_node *node = data->lsq_node;
+    struct dis_inst_node **slot = NULL;
+    struct dis_inst_data *older = NULL;
+
+    if (data->mem_write) {
+        slot = dis_lsq_get_word(dis, data->mem_addr);
+        if (*slot == node) {
+            older = dis_lsq_get_store(dis, data);
+            dis_lsq_set_store(data, older);
+            if (older) {
+                older->lsq_node->link = node->link;
+                *slot = older->lsq_node;
+            } else {
+                *slot = node->link;
+            }
+        }
+    }
+
+    DL_DELETE(dis->list_lsq->list, node);
+    dis_inst_list_decrement_len(dis, LIST_LSQ);
+    free(node);
+    data->lsq_node = NULL;
+    return;
+}
+
+
+/*
+ * Memory disambiguation for a load about to issue. All addresses are known
+ * from the trace, so only the youngest older store to the same word
+ * matters:
+ *  1. It hasn't issued yet; hold the load (FALSE).
+ *  2. It has issued; the load takes its data from the LSQ (TRUE, mem_fwd).
+ *  3. There is none; the load goes to the cache (TRUE).
+ */
+static bool
+dis_lsq_can_issue(struct dis_input *dis, struct dis_inst_node *inst)
+{
+    struct dis_inst_data    *data = inst->data;
+    struct dis_inst_data    *store = NULL;
+
+    if (!data->lsq_node || data->mem_write)
+        return TRUE;
+
+    store = dis_lsq_get_store(dis, data);
+    dis_lsq_set_store(data, store);
+    if (!store)
+        return TRUE;
+
+    if (STATE_EX > store->state) {
+        dis->lsq_stats.num_held += 1;
+        return FALSE;
+    }
+
+    /* Without caches, mem insts have fixed latencies anyway. */
+    if (dis->l1)
+        data->mem_fwd = TRUE;
     return TRUE;
 }
 
 
+/*
+ * Checks if the pool of the inst type has a unit free this cycle (TRUE) or
+ * not (FALSE); unlimited pools always have one.
+ */
+static inline bool
+dis_fu_is_free(struct dis_input *dis, struct dis_inst_node *inst)
+{
+    struct dis_fu_pool *pool = &dis->fu[inst->data->type];
+
+    if (!pool->count || (pool->free_at[pool->head] <= dis_get_cycle_num()))
+        return TRUE;
+
+    pool->num_stalls += 1;
+    return FALSE;
+}
+
+
+/* Takes the unit which frees up first for an issuing inst. */
+static inline void
+dis_fu_take(struct dis_input *dis, struct dis_inst_node *inst)
+{
+    struct dis_fu_pool *pool = &dis->fu[inst->data->type];
+
+    pool->num_issued += 1;
+    if (!pool->count)
+        return;
+
+    pool->free_at[pool->head] = (dis_get_cycle_num() + pool->ii);
+    pool->head = ((pool->head + 1) % pool->count);
+    return;
+}
+
+
 /* Checks if the inst has lived thru all its latency cycles (TRUE) or not. */
 static inline bool
 dis_execute_is_over(struct dis_input *dis, struct dis_inst_node *inst)
@@ -95,39 +285,141 @@ dis_execute_is_over(struct dis_input *dis, struct dis_inst_node *inst)
 }
 
 
-/* Do a cache lookup on the given memory address. */
+/*
+ * Puts an exec list inst with a known latency on the completion wheel, in
+ * the slot of its completion cycle. Latencies longer than the wheel just go
+ * around it.
+ */
+static inline void
+dis_exec_wheel_insert(struct dis_input *dis, struct dis_inst_node *inst)
+{
+    uint32_t slot = ((inst->data->cycle[STATE_EX] + inst->data->latency) &
+            (EXEC_WHEEL_SIZE - 1));
+
+    inst->link = dis->wheel[slot];
+    dis->wheel[slot] = inst;
+    return;
+}
+
+
+/* Checks if the exec list inst still has to get its data from L1 (TRUE). */
+static inline bool
+dis_exec_is_mem_pending(struct dis_input *dis, struct dis_inst_node *inst)
+{
+    return ((inst->data->mem_addr && dis->l1 && !inst->data->mem_done) ?
+            TRUE : FALSE);
+}
+
+
+/* Adds the cache reference of the given mem inst to the batch. */
+static inline void
+dis_exec_batch_add(cache_batch_t *batch, struct dis_inst_data *data)
+{
+    dis_assert(batch->count < batch->size);
+    batch->mrefs[batch->count].ref_type = (data->mem_write ?
+            MEM_REF_TYPE_WRITE : MEM_REF_TYPE_READ);
+    batch->mrefs[batch->count].ref_addr = data->mem_addr;
+    batch->mrefs[batch->count].ref_src = MEM_REF_SRC_DEMAND;
+    batch->mrefs[batch->count].ref_pc = data->pc;
+    batch->count += 1;
+    return;
+}
+
+
+/*
+ * Do the cache lookups of all the memory insts in the exec list which
+ * haven't got their data yet, as one batch in exec list order. Loads read
+ * and stores write L1; loads forwarded from the LSQ are already done. Insts whose
+ * reference a non-blocking cache could not take this cycle (all MSHRs busy)
+ * are left with mem_done unset and retry in the next cycle; each such stall
+ * cycle is added to the inst latency. These insts are kept on their own
+ * list, in exec list order, and move to the completion wheel once done.
+ */
 static void
-dis_exec_cache_lookup(struct dis_input *dis, struct dis_inst_node *inst)
+dis_exec_cache_lookup(struct dis_input *dis)
 {
-    mem_ref_t   mref;
-    uint16_t    cache_latency = 0;
+    uint32_t                i = 0;
+    cache_batch_t           *batch = NULL;
+    struct dis_inst_node    *iter = NULL;
+    struct dis_inst_node    *next = NULL;
+    struct dis_inst_node    **prev = NULL;
 
-    if (!inst) {
-        dis_assert(0);
-        goto error_exit;
-    }
+    batch = &dis->mem_batch;
+    batch->count = 0;
 
-    if (!inst->data->mem_addr) {
-        dis_assert(0);
-        goto error_exit;
-    }
+    for (iter = dis->mem_pending; iter; iter = iter->link)
+        dis_exec_batch_add(batch, iter->data);
 
-    memset(&mref, 0, sizeof(mref));
-    mref.ref_type = MEM_REF_TYPE_READ;
-    mref.ref_addr = inst->data->mem_addr;
+    if (!batch->count)
+        return;
 
-    cache_handle_memory_request(dis->l1, &mref, &cache_latency);
-    dprint_info("inst %u, cache latency %u, cycle %u\n",
-        inst->data->num, cache_latency, dis_get_cycle_num());
+    cache_handle_memory_batch(dis->l1, batch);
 
-    /* Add the cache latency to the execute latency of the inst. */
-    inst->data->latency += cache_latency;
+    /* Same walk as above, so the i-th mem inst owns the i-th ref. */
+    prev = &dis->mem_pending;
+    for (iter = dis->mem_pending; iter; iter = next) {
+        next = iter->link;
 
-error_exit:
+        if (!batch->accepted[i]) {
+            dprint_info("inst %u, no free MSHR, cycle %u\n",
+                iter->data->num, dis_get_cycle_num());
+            iter->data->latency += 1;
+            prev = &iter->link;
+        } else {
+            dprint_info("inst %u, cache latency %u, cycle %u\n",
+                iter->data->num, batch->latencies[i], dis_get_cycle_num());
+
+            /* Add the cache latency to the execute latency of the inst. */
+            iter->data->latency += batch->latencies[i];
+            iter->data->mem_done = TRUE;
+
+            *prev = next;
+            dis_exec_wheel_insert(dis, iter);
+        }
+        i += 1;
+    }
+    dis->mem_pending_tail = prev;
     return;
 }
 
 
+/*
+ * Checks whether all the operands are ready (TRUE) or not (FALSE) for a
+ * given inst.
+ */
+static inline bool
+dis_issue_are_operands_ready(struct dis_input *dis, struct dis_inst_node *inst)
+{
+    bool rv = TRUE;
+
+    if (dis_sched_is_matrix(dis))
+        return dis_sched_is_ready(dis, inst->data);
+
+#ifdef DBG_ON
+        dprint_info("inst %u, sreg1 %u ready %u, sreg2 %u ready %u, cycle %u\n",
+            inst->data->num, inst->sreg1.rnum, inst->sreg1.ready,
+            inst->sreg2.rnum, inst->sreg2.ready, dis_get_cycle_num());
+#endif /* DBG_ON */
+
+    if (dis_is_reg_valid(inst->sreg1.rnum)) {
+        if (!inst->sreg1.ready) {
+            dprint_info("sreg1 not ready\n");
+            rv = FALSE;
+        }
+    }
+
+    if (dis_is_reg_valid(inst->sreg2.rnum)) {
+        if (!inst->sreg2.ready) {
+            dprint_info("sreg2 not ready\n");
+            rv = FALSE;
+        }
+    }
+
+    dprint_info("returning %u\n", rv);
+    return rv;
+}
+
+
 /* 
  * Update the reg ready bit in RMT and wakeup waiting insts in issue list
  * on an inst completion.
@@ -137,15 +429,16 @@ dis_exec_update_regs(struct dis_input *dis, struct dis_inst_node *inst)
 {
     uint16_t                dreg = 0;
     uint32_t                dreg_name = 0;
-    struct dis_inst_node    *iter = NULL;
+    struct dis_reg_data     *sreg = NULL;
 
     /* The given inst has finished execution. We need to update the dreg in
      * RMT and other inst in IS stage that may be waiting on this dreg.
      * If dreg is valid (i.e., not -1), do the following:
      *  1. Set the ready bit of the dreg in RMT.
-     *  2. Go over the issue list and see if any of the insts is waiting on 
-     *     this dreg (i.e. issue_list.src1 == dreg || issue_list.src2 == dreg)
-     *     for all nodes in issue list). If so, set the private ready bit(s).
+     *  2. Set the private ready bit of all the issue list sregs waiting on
+     *     this dreg name; they are chained off the name at dispatch.
+     *  3. If a younger inst has renamed the dreg already, nobody can refer
+     *     to this name anymore; free it.
      */
 
     dreg = inst->data->dreg;
@@ -161,50 +454,83 @@ dis_exec_update_regs(struct dis_input *dis, struct dis_inst_node *inst)
                 inst->data->num, dreg, dreg_name, dis_get_cycle_num());
         }
 
-        DL_FOREACH(dis->list_issue->list, iter) {
-            if ((iter->sreg1.name == dreg_name) && (!iter->sreg1.ready)) {
-                iter->sreg1.ready = 1;
-                dprint_info("inst %u, sreg1 %u/%u, wakeup, cycle %u\n",
-                    iter->data->num, iter->sreg1.rnum, iter->sreg1.name,
-                    dis_get_cycle_num());
-            }
-
-            if ((iter->sreg2.name == dreg_name) && (!iter->sreg2.ready)) {
-                iter->sreg2.ready = 1;
-                dprint_info("inst %u, sreg2 %u/%u, wakeup, cycle %u\n",
-                    iter->data->num, iter->sreg2.rnum, iter->sreg2.name,
-                    dis_get_cycle_num());
+        /* The matrix engine wakes up the consumers by a column clear. */
+        if (dis_sched_is_matrix(dis)) {
+            dis_sched_wakeup(dis, inst->data);
+        } else {
+            for (sreg = dis->prf.waiters[dreg_name]; sreg; sreg = sreg->next) {
+                sreg->ready = 1;
+                dprint_info("sreg %u/%u, wakeup, cycle %u\n",
+                    sreg->rnum, sreg->name, dis_get_cycle_num());
+                if (dis_issue_are_operands_ready(dis, sreg->owner))
+                    dis_ready_push(dis, sreg->owner);
             }
+            dis->prf.waiters[dreg_name] = NULL;
         }
+
+        if (dreg_name != dis_get_reg_name(dis, dreg))
+            dis_free_reg_name(dis, dreg_name);
     }
     return;
 }
 
 
-/* Put the give inst on exec list, provided the list has room. */
-static bool
+/*
+ * Moves the given inst from the issue list to the exec list; the caller
+ * checks for room. Mem insts which still have to look up L1 wait on the
+ * pending list, the rest go on the completion wheel.
+ */
+static void
 dis_exec_push_inst(struct dis_input *dis, struct dis_inst_node *inst)
 {
-    if (dis_can_push_on_list(dis, LIST_EXEC)) {
-        struct dis_inst_node *node = NULL;
+    dprint_info("inst %u, EX IS-->EX, sreg1 %u/%u, sreg2 %u/%u, dreg %u/%u\n",
+        inst->data->num, inst->sreg1.rnum, inst->sreg1.name,
+        inst->sreg2.rnum, inst->sreg2.name,
+        inst->dreg.rnum, inst->dreg.name);
+
+    DL_DELETE(dis->list_issue->list, inst);
+    dis_inst_list_decrement_len(dis, LIST_ISSUE);
+
+    DL_APPEND(dis->list_exec->list, inst);
+    dis_inst_list_increment_len(dis, LIST_EXEC);
+
+    if (dis_exec_is_mem_pending(dis, inst)) {
+        inst->link = NULL;
+        *dis->mem_pending_tail = inst;
+        dis->mem_pending_tail = &inst->link;
+    } else {
+        dis_exec_wheel_insert(dis, inst);
+    }
+    return;
+}
 
-        node = (struct dis_inst_node *) calloc(1, sizeof(*node));
-        node->data = inst->data;
 
-        memcpy(&node->sreg1, &inst->sreg1, sizeof(node->sreg1));
-        memcpy(&node->sreg2, &inst->sreg2, sizeof(node->sreg2));
-        memcpy(&node->dreg, &inst->dreg, sizeof(node->dreg));
+/*
+ * Moves a done inst from the exec list to the writeback list, wakes up its
+ * consumers and frees its LSQ entry.
+ */
+static void
+dis_exec_complete_inst(struct dis_input *dis, struct dis_inst_node *inst)
+{
+    /* Done with this inst. Change state to WB and move it from the
+     * exec list to the writeback list.
+     */
+    dis_inst_set_state(inst, STATE_WB);
+    dis_inst_set_cycle(inst, STATE_WB);
+    dis_wback_push_inst(dis, inst);
+
+    dprint_info("inst %u, EX-->WB, exec(%u)-->wback(%u), cycle %u\n",
+            inst->data->num, dis_inst_list_get_len(dis, LIST_EXEC),
+            dis_inst_list_get_len(dis, LIST_WBACK),
+            dis_get_cycle_num());
 
-        dprint_info("inst %u, EX IS-->EX, sreg1 %u/%u, sreg2 %u/%u, dreg %u/%u\n",
-            inst->data->num, node->sreg1.rnum, node->sreg1.name,
-            node->sreg2.rnum, node->sreg2.name,
-            node->dreg.rnum, node->dreg.name);
+    /* Update this inst dreg ready bit and wakeup waiting insts. */ 
+    dis_exec_update_regs(dis, inst);
 
-        DL_APPEND(dis->list_exec->list, node);
-        dis_inst_list_increment_len(dis, LIST_EXEC);
-        return TRUE;
-    }
-    return FALSE;
+    /* Mem insts leave the LSQ once done. */
+    if (inst->data->lsq_node)
+        dis_lsq_remove_inst(dis, inst->data);
+    return;
 }
 
 
@@ -216,48 +542,41 @@ dis_exec_push_inst(struct dis_input *dis, struct dis_inst_node *inst)
 bool
 dis_execute(struct dis_input *dis)
 {
-    struct dis_inst_node    *tmp = NULL;
+    uint32_t                slot = 0;
+    struct dis_inst_node    *next = NULL;
     struct dis_inst_node    *iter = NULL;
+    PROF_VAR(ticks);
 
     if (!dis) {
         dis_assert(0);
         goto error_exit;
     }
 
-    DL_FOREACH_SAFE(dis->list_exec->list, iter, tmp) {
-        /* Do a cache lookup for memory insts. */
-        if (iter->data->mem_addr && dis->l1) {
-            /* Cache lookups only when the inst is exectued for the first
-             * time.
-             */
-            if ((dis_get_cycle_num() - 1) ==
-                    dis_inst_get_state_cycle(iter, STATE_EX)) {
-                dis_exec_cache_lookup(dis, iter);
-            }
-        }
-
-        if (dis_execute_is_over(dis, iter)) {
-            /* Done with this inst. Change state to WB and remove it from the
-             * exec list.
-             */
-            dis_inst_set_state(iter, STATE_WB);
-            dis_inst_set_cycle(iter, STATE_WB);
-            dis_wback_push_inst(dis, iter);
-
-            DL_DELETE(dis->list_exec->list, iter);
-            dis_inst_list_decrement_len(dis, LIST_EXEC);
-
-            dprint_info("inst %u, EX-->WB, exec(%u)-->wback(%u), cycle %u\n",
-                    iter->data->num, dis_inst_list_get_len(dis, LIST_EXEC),
-                    dis_inst_list_get_len(dis, LIST_WBACK),
-                    dis_get_cycle_num());
-
-            /* Update this inst dreg ready bit and wakeup waiting insts. */ 
-            dis_exec_update_regs(dis, iter);
+    /* Cache lookups only when the inst is exectued for the first time, or
+     * till a non-blocking cache accepts the reference.
+     */
+    if (dis->l1) {
+        PROF_START(ticks);
+        cache_set_cycle(dis_get_cycle_num());
+        dis_exec_cache_lookup(dis);
+        PROF_STOP(PROF_CACHE, ticks);
+    }
 
-            /* Free the memory allocated for the inst that was just deleted. */
-            free(iter);
+    /* Only the insts in this cycle's wheel slot may be done; the ones with
+     * latencies longer than the wheel go back for another round.
+     */
+    slot = (dis_get_cycle_num() & (EXEC_WHEEL_SIZE - 1));
+    iter = dis->wheel[slot];
+    dis->wheel[slot] = NULL;
+    for (; iter; iter = next) {
+        next = iter->link;
+
+        if (!dis_execute_is_over(dis, iter)) {
+            iter->link = dis->wheel[slot];
+            dis->wheel[slot] = iter;
+            continue;
         }
+        dis_exec_complete_inst(dis, iter);
     }
     return TRUE;
 
@@ -267,36 +586,67 @@ error_exit:
 
 
 /*
- * Checks whether all the operands are ready (TRUE) or not (FALSE) for a
- * given inst.
+ * Issues a ready inst which got past the structural hazards: takes its
+ * functional unit and moves it to the exec list.
  */
-static inline bool
-dis_issue_are_operands_ready(struct dis_input *dis, struct dis_inst_node *inst)
+static inline void
+dis_issue_inst(struct dis_input *dis, struct dis_inst_node *inst)
 {
-    bool rv = TRUE;
+    dis_fu_take(dis, inst);
 
-#ifdef DBG_ON
-        dprint_info("inst %u, sreg1 %u ready %u, sreg2 %u ready %u, cycle %u\n",
-            inst->data->num, inst->sreg1.rnum, inst->sreg1.ready,
-            inst->sreg2.rnum, inst->sreg2.ready, dis_get_cycle_num());
-#endif /* DBG_ON */
+    /* Change states and push the inst onto exec list. */
+    dis_inst_set_state(inst, STATE_EX);
+    dis_inst_set_cycle(inst, STATE_EX);
 
-    if (dis_is_reg_valid(inst->sreg1.rnum)) {
-        if (!inst->sreg1.ready) {
-            dprint_info("sreg1 not ready\n");
-            rv = FALSE;
-        }
+    /* Forwarded loads skip the cache. */
+    if (inst->data->mem_fwd) {
+        inst->data->latency += LSQ_FWD_LATENCY;
+        inst->data->mem_done = TRUE;
+        dis->lsq_stats.num_fwds += 1;
     }
 
-    if (dis_is_reg_valid(inst->sreg2.rnum)) {
-        if (!inst->sreg2.ready) {
-            dprint_info("sreg2 not ready\n");
-            rv = FALSE;
-        }
-    }
+    if (dis_sched_is_matrix(dis))
+        dis_sched_issue(dis, inst->data);
 
-    dprint_info("returning %u\n", rv);
-    return rv;
+    dis_exec_push_inst(dis, inst);
+
+    dprint_info("inst %u, IS-->EX, issue(%u)-->exec(%u), cycle %u\n",
+            inst->data->num, dis_inst_list_get_len(dis, LIST_ISSUE),
+            dis_inst_list_get_len(dis, LIST_EXEC),
+            dis_get_cycle_num());
+    return;
+}
+
+
+/*
+ * Charges the issue slots left over to why the issue loop stopped: no room
+ * in the exec list, or no ready inst left but the held ones; the rest of
+ * the issue list, if any, waits on operands.
+ */
+static DIS_ALWAYS_INLINE void
+dis_issue_count_stalls(struct dis_input *dis, const uint32_t s,
+        const uint32_t n, uint32_t num_issued, uint32_t num_held)
+{
+    uint32_t i = num_issued;
+    uint32_t num_held_slots = 0;
+
+    dis_stall_count(dis, STALL_STAGE_ISSUE, STALL_USED, i);
+    if ((i < n) && dis_is_list_full_sn(dis, LIST_EXEC, s, n)) {
+        dis_stall_count(dis, STALL_STAGE_ISSUE, STALL_EXEC_FULL, (n - i));
+    } else if (i < n) {
+        if (num_held > (n - i))
+            num_held_slots = (n - i);
+        else
+            num_held_slots = num_held;
+        dis_stall_count(dis, STALL_STAGE_ISSUE, STALL_STRUCTURAL,
+                num_held_slots);
+        dis_stall_count(dis, STALL_STAGE_ISSUE,
+                ((dis_inst_list_get_len(dis, LIST_ISSUE) > num_held) ?
+                 STALL_OPERANDS : (dis->stalls.trace_done ?
+                     STALL_TRACE_DONE : STALL_STARVED)),
+                (n - i - num_held_slots));
+    }
+    return;
 }
 
 
@@ -306,63 +656,65 @@ dis_issue_are_operands_ready(struct dis_input *dis, struct dis_inst_node *inst)
  * ready. It can move upto 'n' instrctions or as long as the exection
  * stage can accept newer instrctions.
  */
-bool
-dis_issue(struct dis_input *dis)
+static DIS_ALWAYS_INLINE bool
+dis_issue_sn(struct dis_input *dis, const uint32_t s, const uint32_t n)
 {
-    uint8_t                 i = 0;
-    struct dis_inst_node    *tmp = NULL;
+    uint32_t                i = 0;
+    uint32_t                h = 0;
+    uint32_t                num_held = 0;
     struct dis_inst_node    *iter = NULL;
-    struct dis_inst_node    *list = NULL;
+    struct dis_inst_node    **held = NULL;
 
     if (!dis) {
         dis_assert(0);
         goto error_exit;
     }
-    list = dis->list_issue->list;
 
-    /* Issue list processing outline:
-     *  1. For each inst in the issue list, check if all of their operands are
-     *     ready and if the inst can be pushed onto the exec list (room
-     *     availability in exec list). If so, do the following:
+    /* Issue processing outline:
+     *  1. Insts are put on the ready heap when their last operand wakes up
+     *     (or at dispatch, if there was nothing to wait for), so the oldest
+     *     ready inst is always on top. Take them, oldest first, off the
+     *     heap and the held insts, as long as the exec list has room and
+     *     fewer than 'n' have gone. For each:
      *          - Change the state of the inst to EX.
      *          - Update the state-cycle history map of the inst.
-     *          - Push the inst to the exec list and increment its length.
-     *          - Remove the inst from the issue list and decrement its length.
-     *          - Continue with the next inst.
+     *          - Move the inst from the issue list to the exec list.
+     *  2. Insts with no free functional unit, and mem insts which the LSQ
+     *     holds back, are held, so they do not block younger ready insts.
+     *     The held insts stay sorted by their select key, off the heap, and
+     *     are merged back in with it next cycle.
      */
-    DL_FOREACH_SAFE(list, iter, tmp) {
-        if (STATE_IS != dis_inst_get_state(iter)) {
-            dis_assert(0);
+    held = dis->held_next;
+    while ((i < n) && !dis_is_list_full_sn(dis, LIST_EXEC, s, n) &&
+            ((h < dis->num_held) || dis->ready.count)) {
+        if ((h < dis->num_held) && (!dis->ready.count ||
+                    (dis->held[h]->data->sel_key <
+                     dis->ready.nodes[0]->data->sel_key)))
+            iter = dis->held[h++];
+        else
+            iter = dis_ready_pop(dis);
+        dis_assert(STATE_IS == dis_inst_get_state(iter));
+
+        /* Structural hazards first; the LSQ check may forward. */
+        if (!dis_fu_is_free(dis, iter) || !dis_lsq_can_issue(dis, iter)) {
+            held[num_held++] = iter;
             continue;
         }
-
-        if (dis_can_push_on_list(dis, LIST_EXEC) &&
-                dis_issue_are_operands_ready(dis, iter) && i < dis->n) {
-            /* Change states and push the inst onto exec list. */
-            dis_inst_set_state(iter, STATE_EX);
-            dis_inst_set_cycle(iter, STATE_EX);
-        
-            dprint_info("inst %u, IS IS-->EX, sreg1 %u/%u, sreg2 %u/%u, dreg %u/%u\n",
-            iter->data->num, iter->sreg1.rnum, iter->sreg1.name,
-            iter->sreg2.rnum, iter->sreg2.name,
-            iter->dreg.rnum, iter->dreg.name);
-
-            dis_exec_push_inst(dis, iter);
-            i += 1;
-
-            /* Delete the inst from issue list. */
-            DL_DELETE(dis->list_issue->list, iter);
-            dis_inst_list_decrement_len(dis, LIST_ISSUE);
-
-            dprint_info("inst %u, IS-->EX, issue(%u)-->exec(%u), cycle %u\n",
-                    iter->data->num, dis_inst_list_get_len(dis, LIST_ISSUE),
-                    dis_inst_list_get_len(dis, LIST_EXEC),
-                    dis_get_cycle_num());
-
-            /* Free the memory allocated for the inst that was just deleted. */
-            free(iter);
-        }
+        dis_issue_inst(dis, iter);
+        i += 1;
     }
+
+    if (dis->stalls.on)
+        dis_issue_count_stalls(dis, s, n, i, num_held);
+
+    /* The held insts not tried this cycle are younger than all the ones
+     * which were, so the merge stays in key order.
+     */
+    while (h < dis->num_held)
+        held[num_held++] = dis->held[h++];
+    dis->held_next = dis->held;
+    dis->held = held;
+    dis->num_held = num_held;
     return TRUE;
 
 error_exit:
@@ -370,55 +722,77 @@ error_exit:
 }
 
 
-/* Lookup the RMT and update sregs name in resv. station, if required. */
-static void
-dis_dispatch_rename_sreg(struct dis_input *dis, struct dis_inst_node *inst)
+/* Chains a pending sreg of an issue list node off its producer's name. */
+static inline void
+dis_dispatch_add_waiter(struct dis_input *dis, struct dis_inst_node *node,
+        struct dis_reg_data *sreg)
 {
-#ifdef DBG_ON
-    uint32_t old_reg_name = 0;
-#endif /* DBG_ON */
-
-    /* For a valid sreg (i.e., register is not -1), lookup the RMT.
-     *      - If ready bit is set, just move on. No renaming.
-     *      - If ready bit is not set, assign a unique name to the reg in
-     *        the RMT and clear the ready bit.
-     */
-    if (dis_is_reg_valid(inst->data->sreg1) &&
-            !dis_is_reg_ready(dis, inst->data->sreg1)) {
-#ifdef DBG_ON
-        old_reg_name = inst->sreg1.name;
-#endif /* DBG_ON */
-        inst->sreg1.name = dis_get_reg_name(dis, inst->data->sreg1);
-        dprint_info("inst %u, sreg1 %u/%u->%u, cycle %u\n",
-            inst->data->num, inst->data->sreg1, old_reg_name, inst->sreg1.name,
-            dis_get_cycle_num());
-    }
+    if (!dis_is_reg_valid(sreg->rnum) || sreg->ready)
+        return;
 
-    if (dis_is_reg_valid(inst->data->sreg2) &&
-            !dis_is_reg_ready(dis, inst->data->sreg2)) {
-#ifdef DBG_ON
-        old_reg_name = inst->sreg2.name;
-#endif /* DBG_ON */
-        inst->sreg2.name = dis_get_reg_name(dis, inst->data->sreg2);
-        dprint_info("inst %u, sreg2 %u/%u->%u, cycle %u\n",
-            inst->data->num, inst->data->sreg2, old_reg_name, inst->sreg2.name,
-            dis_get_cycle_num());
-    }
+    sreg->owner = node;
+    sreg->next = dis->prf.waiters[sreg->name];
+    dis->prf.waiters[sreg->name] = sreg;
     return;
 }
 
-/* Renames the registers in the inst as required. */
-static void
-dis_dispatch_rename_dreg(struct dis_input *dis, struct dis_inst_node *inst)
+
+/* Fills an issue list node reg from the current RMT entry of the reg. */
+static inline void
+dis_dispatch_read_rmt(struct dis_input *dis, struct dis_reg_data *reg,
+        uint16_t regno)
 {
-    if (dis_is_reg_valid(inst->data->dreg)) {
-        dis_rename_reg(dis, inst->data->dreg, TRUE);
-        inst->dreg.name = dis_get_reg_name(dis, inst->data->dreg);
+    uint32_t entry = dis->rmt[regno];
 
-        dprint_info("inst %u, dreg rename, ", inst->data->num);
-#ifdef DBG_ON
-        dis_print_rmt(dis, inst->data->dreg);
-#endif /* DBG_ON */
+    reg->rnum = regno;
+    reg->name = (entry & RMT_NAME_MASK);
+    reg->ready = ((entry & RMT_READY_BIT) ? TRUE : FALSE);
+    reg->next = NULL;
+    return;
+}
+
+
+/* Counts a pending sreg against its producer, for the select policies. */
+static inline void
+dis_dispatch_count_dep(struct dis_input *dis, struct dis_reg_data *sreg)
+{
+    if (dis_is_reg_valid(sreg->rnum) && !sreg->ready)
+        dis->prf.num_deps[sreg->name] += 1;
+    return;
+}
+
+
+/*
+ * Renames a group of dispatching insts, oldest first, in one pass over the
+ * flat RMT. Each inst reads its sregs before renaming its dreg, and a
+ * younger inst of the group reads the names written by the older ones, so
+ * dependencies within the group need no extra checks.
+ */
+static void
+dis_dispatch_rename_group(struct dis_input *dis, struct dis_inst_node **group,
+        uint32_t count)
+{
+    uint32_t                i = 0;
+    struct dis_inst_node    *node = NULL;
+    struct dis_inst_data    *data = NULL;
+
+    for (i = 0; i < count; ++i) {
+        node = group[i];
+        data = node->data;
+
+        dis_dispatch_read_rmt(dis, &node->sreg1, data->sreg1);
+        dis_dispatch_read_rmt(dis, &node->sreg2, data->sreg2);
+        dis_dispatch_count_dep(dis, &node->sreg1);
+        dis_dispatch_count_dep(dis, &node->sreg2);
+
+        if (dis_is_reg_valid(data->dreg)) {
+            dis_rename_reg(dis, data->dreg, TRUE);
+            dprint_info("inst %u, dreg rename, ", data->num);
+#ifdef DBG_ON
+            dis_print_rmt(dis, data->dreg);
+#endif /* DBG_ON */
+        }
+        dis_dispatch_read_rmt(dis, &node->dreg, data->dreg);
     }
     return;
 }
@@ -444,12 +818,18 @@ dis_dispatch_push_inst(struct dis_input *dis, struct dis_inst_node *inst)
 
 /*
  * Dispatch stage of the pipeline. This has 1 cycle delay for inst in IF state
- * and moves the inst in ID state to issue list.
+ * and moves the inst in ID state to issue list. The group buffer has room
+ * for the whole dispatch list.
  */
-bool
-dis_dispatch(struct dis_input *dis)
+static DIS_ALWAYS_INLINE bool
+dis_dispatch_sn(struct dis_input *dis, const uint32_t s, const uint32_t n,
+        struct dis_inst_node **group)
 {
-    struct dis_inst_node    *tmp = NULL;
+    uint32_t                i = 0;
+    uint32_t                count = 0;
+    uint32_t                room = 0;
+    uint32_t                lsq_room = 0;
+    uint8_t                 stall = 0;
     struct dis_inst_node    *iter = NULL;
     struct dis_inst_node    *node = NULL;
 
@@ -458,55 +838,86 @@ dis_dispatch(struct dis_input *dis)
         goto error_exit;
     }
 
-    /* First move as many inst as possile from ID to IS, then onto issue
-     * list and remove them from dispatch list.
+    /* First pick the insts in ID state which the issue list (and the LSQ,
+     * for mem insts) has room for, oldest first.
      */
-    DL_FOREACH_SAFE(dis->list_disp->list, iter, tmp) {
+    room = (!dis_is_list_full_sn(dis, LIST_ISSUE, s, n) ?
+            (s - dis_inst_list_get_len(dis, LIST_ISSUE)) : 0);
+    lsq_room = (dis_can_push_on_list(dis, LIST_LSQ) ?
+            (dis->lsq_size - dis_inst_list_get_len(dis, LIST_LSQ)) : 0);
+
+    stall = (dis->stalls.trace_done ? STALL_TRACE_DONE : STALL_STARVED);
+    DL_FOREACH(dis->list_disp->list, iter) {
         if (STATE_ID != dis_inst_get_state(iter))
             continue;
 
-        if (dis_can_push_on_list(dis, LIST_ISSUE)) {
-
-            /* Change the state to IS. */
-            dis_inst_set_state(iter, STATE_IS);
-            iter->data->cycle[STATE_IS] = dis_get_cycle_num();
-            
-            /* Allocate new node for pushing onto issue list. */
-            node = (struct dis_inst_node *) calloc(1, sizeof(*node));
-            node->data = iter->data;
-
-            /* Now, rename the sreg and update it in the new node too. */
-            dis_dispatch_rename_sreg(dis, iter);
-            memcpy(&node->sreg1, dis->rmt[iter->data->sreg1], 
-                    sizeof(node->sreg1));
-            memcpy(&node->sreg2, dis->rmt[iter->data->sreg2], 
-                    sizeof(node->sreg2));
-
-            /* Rename the dreg and update it in the new node too. */
-            dis_dispatch_rename_dreg(dis, iter);
-            memcpy(&node->dreg, dis->rmt[iter->data->dreg], 
-                    sizeof(node->dreg));
-
-            /* Now, push the new node onto the issue list. */
-            DL_APPEND(dis->list_issue->list, node);
-            dis_inst_list_increment_len(dis, LIST_ISSUE);
-
-            /* Finally, remove this from this inst from dispatch list. */
-            DL_DELETE(dis->list_disp->list, iter);
-            dis_inst_list_decrement_len(dis, LIST_DISP);
-
-            dprint_info("inst %u, ID-->IS, disp(%u)-->issue(%u), cycle %u\n",
-                    iter->data->num, dis_inst_list_get_len(dis, LIST_DISP),
-                    dis_inst_list_get_len(dis, LIST_ISSUE),
-                    dis_get_cycle_num());
-
-            /* Free the memory allocated for the inst that was just deleted. */
-            free(iter);
+        if (count == room) {
+            stall = STALL_SCHED_FULL;
+            break;
         }
+
+        /* Mem insts need an LSQ entry; keep them in program order. */
+        if (iter->data->mem_addr) {
+            if (!lsq_room) {
+                dis->lsq_stats.num_full_stalls += 1;
+                stall = STALL_LSQ_FULL;
+                break;
+            }
+            lsq_room -= 1;
+        }
+
+        group[count++] = iter;
     }
 
-    /* Sort the issue list in the order of inst in trce file. */
-    DL_SORT(dis->list_issue->list, dis_cb_cmp);
+    /* Up to the whole dispatch list may go in a cycle; only N slots are
+     * accounted for.
+     */
+    if (dis->stalls.on) {
+        dis_stall_count(dis, STALL_STAGE_DISPATCH, STALL_USED,
+                ((count < n) ? count : n));
+        if (count < n)
+            dis_stall_count(dis, STALL_STAGE_DISPATCH, stall, (n - count));
+    }
+
+    /* Rename the whole group in one go. */
+    dis_dispatch_rename_group(dis, group, count);
+
+    /* Then move the nodes themselves off the dispatch list and onto the
+     * issue list.
+     */
+    for (i = 0; i < count; ++i) {
+        node = group[i];
+        DL_DELETE(dis->list_disp->list, node);
+        dis_inst_list_decrement_len(dis, LIST_DISP);
+
+        /* Change the state to IS. */
+        dis_inst_set_state(node, STATE_IS);
+        node->data->cycle[STATE_IS] = dis_get_cycle_num();
+
+        if (dis_sched_is_matrix(dis)) {
+            dis_sched_insert(dis, node);
+        } else {
+            dis_dispatch_add_waiter(dis, node, &node->sreg1);
+            dis_dispatch_add_waiter(dis, node, &node->sreg2);
+        }
+
+        /* Now, push the new node onto the issue list; it is appended in
+         * program order, so the list needs no sorting.
+         */
+        DL_APPEND(dis->list_issue->list, node);
+        dis_inst_list_increment_len(dis, LIST_ISSUE);
+
+        if (dis_issue_are_operands_ready(dis, node))
+            dis_ready_push(dis, node);
+
+        if (node->data->mem_addr)
+            dis_lsq_push_inst(dis, node->data);
+
+        dprint_info("inst %u, ID-->IS, disp(%u)-->issue(%u), cycle %u\n",
+                node->data->num, dis_inst_list_get_len(dis, LIST_DISP),
+                dis_inst_list_get_len(dis, LIST_ISSUE),
+                dis_get_cycle_num());
+    }
 
     /* Now, move the inst in IF state to ID state. */
     DL_FOREACH(dis->list_disp->list, iter) {
@@ -527,23 +938,184 @@ error_exit:
 }
 
 
+/*
+ * Sets up the RMT and the physical register names. Every arch reg starts
+ * out mapped to the name of its own number, ready; the rest are free. A name
+ * is live while it is mapped in the RMT or its producer is still in the
+ * issue or exec list, which bounds the names needed by the window rather
+ * than the trace length.
+ * The rest of the per-stage bookkeeping is sized off S and N here too.
+ */
+bool
+dis_prf_init(struct dis_input *dis)
+{
+    uint32_t        i = 0;
+    uint32_t        num_words = 0;
+    struct dis_prf  *prf = &dis->prf;
+
+    prf->num_regs = (REG_TOTAL + dis->s + (dis->n * EXEC_LIST_FACTOR) +
+            PRF_EXTRA_REGS);
+    prf->free_list = (uint32_t *) malloc(prf->num_regs *
+            sizeof(*prf->free_list));
+    prf->waiters = (struct dis_reg_data **) calloc(prf->num_regs,
+            sizeof(*prf->waiters));
+    prf->num_deps = (uint32_t *) calloc(prf->num_regs,
+            sizeof(*prf->num_deps));
+
+    /* A dispatch group is at most the whole dispatch list; the ready heap
+     * and the held back insts are at most the whole issue list. The LSQ
+     * holds at most the issue and exec lists.
+     */
+    dis->rename_group = (struct dis_inst_node **) malloc((2 * dis->n) *
+            sizeof(*dis->rename_group));
+    dis->ready.size = dis->s;
+    dis->ready.count = 0;
+    dis->ready.nodes = (struct dis_inst_node **) malloc(dis->s *
+            sizeof(*dis->ready.nodes));
+    dis->held = (struct dis_inst_node **) malloc(dis->s * sizeof(*dis->held));
+    dis->held_next = (struct dis_inst_node **) malloc(dis->s *
+            sizeof(*dis->held_next));
+    dis->num_held = 0;
+    num_words = 1;
+    while (num_words < (dis->s + (dis->n * EXEC_LIST_FACTOR)))
+        num_words <<= 1;
+    dis->lsq_words = (struct dis_inst_node **) calloc(num_words,
+            sizeof(*dis->lsq_words));
+    dis->lsq_words_mask = (num_words - 1);
+    dis->mem_pending = NULL;
+    dis->mem_pending_tail = &dis->mem_pending;
+    if (!prf->free_list || !prf->waiters || !prf->num_deps ||
+            !dis->rename_group ||
+            !dis->ready.nodes || !dis->held || !dis->held_next ||
+            !dis->lsq_words) {
+        dprint("ERROR: Unable to allocate memory for the register file.\n");
+        dis_prf_cleanup(dis);
+        return FALSE;
+    }
+
+    /* The invalid reg (-1) is never ready and never renamed. */
+    for (i = 0; i < REG_TOTAL; ++i)
+        dis->rmt[i] = (RMT_READY_BIT | i);
+    dis->rmt[REG_TOTAL] = 0;
+
+    /* Same for the reference engine RMT. */
+    memset(dis->ref_rmt, 0, sizeof(dis->ref_rmt));
+    for (i = 0; i <= REG_TOTAL; ++i) {
+        dis->ref_rmt[i].rnum = i;
+        dis->ref_rmt[i].name = i;
+        dis->ref_rmt[i].ready = (i < REG_TOTAL);
+    }
+
+    /* Free list is a stack; hand out the low names first. */
+    prf->num_free = 0;
+    for (i = prf->num_regs; i > REG_TOTAL; --i)
+        prf->free_list[prf->num_free++] = (i - 1);
+    return TRUE;
+}
+
+
+/* Frees the physical register names. */
+void
+dis_prf_cleanup(struct dis_input *dis)
+{
+    free(dis->prf.free_list);
+    free(dis->prf.waiters);
+    free(dis->prf.num_deps);
+    free(dis->rename_group);
+    free(dis->ready.nodes);
+    free(dis->held);
+    free(dis->held_next);
+    free(dis->lsq_words);
+    dis->prf.free_list = NULL;
+    dis->prf.waiters = NULL;
+    dis->prf.num_deps = NULL;
+    dis->rename_group = NULL;
+    dis->ready.nodes = NULL;
+    dis->held = NULL;
+    dis->held_next = NULL;
+    dis->lsq_words = NULL;
+    return;
+}
+
+
+/*
+ * Sets up the functional unit pools given on the command line. All the units
+ * are free to begin with; a pool latency replaces the default latency of
+ * its inst type, but mem insts still take the cache latency with caches on.
+ */
+bool
+dis_fu_init(struct dis_input *dis)
+{
+    uint32_t            type = 0;
+    struct dis_fu_pool  *pool = NULL;
+
+    for (type = 0; type < TYPE_MAX; ++type) {
+        pool = &dis->fu[type];
+        if (pool->latency)
+            g_latency[type] = pool->latency;
+        if (!pool->ii)
+            pool->ii = 1;
+        if (!pool->count)
+            continue;
+
+        pool->free_at = (uint32_t *) calloc(pool->count,
+                sizeof(*pool->free_at));
+        if (!pool->free_at) {
+            dprint("ERROR: Unable to allocate memory for the functional "
+                    "units.\n");
+            dis_fu_cleanup(dis);
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+
+/* Frees the functional unit pools. */
+void
+dis_fu_cleanup(struct dis_input *dis)
+{
+    uint32_t type = 0;
+
+    for (type = 0; type < TYPE_MAX; ++type) {
+        free(dis->fu[type].free_at);
+        dis->fu[type].free_at = NULL;
+    }
+    return;
+}
+
+
+/*
+ * Quits on a trace address wider than the address bits simulated; masking
+ * it would silently alias distinct blocks.
+ */
+void
+dis_addr_too_wide(struct dis_input *dis, mem_addr_t addr)
+{
+    dprint("ERROR: Trace address 0x%" PRIx64 " is wider than %u bits; "
+            "rerun with a larger --addr-bits.\n", addr, dis->addr_bits);
+    exit(-1);
+}
+
+
 /*
  * Fetch instructions from tracefile and push them onto main inst list
  * and then onto dispatch list. All constraints given in section 5.2.4 in
  * docs/pa2_spec.pdf apply.
  */
-bool
-dis_fetch(struct dis_input *dis)
+static DIS_ALWAYS_INLINE bool
+dis_fetch_sn(struct dis_input *dis, const uint32_t s, const uint32_t n)
 {
-    char newline = '\n';
-    int  fscanf_rv = 0;
+    char        line[TRACE_LINE_LEN];
+    char        mem_op[2];
+    int         num_fields = 0;
     int32_t     dreg = 0;
     int32_t     sreg1 = 0;
     int32_t     sreg2 = 0;
     uint32_t    inst_type = 0;
     uint32_t    inst_i = 0;
-    uint32_t    pc = 0;
-    uint32_t    mem_addr = 0;
+    mem_addr_t  pc = 0;
+    mem_addr_t  mem_addr = 0;
 
     struct dis_inst_data *new_inst = NULL;
     struct dis_inst_node *new_inst_node = NULL;
@@ -554,21 +1126,26 @@ dis_fetch(struct dis_input *dis)
     }
 
     /* Each trace entry is of the format:
-     * <PC> <inst-type> <dst-reg> <src-reg-1> <src-reg-2> <mem-addr>
+     * <PC> <inst-type> <dst-reg> <src-reg-1> <src-reg-2> <mem-addr> [r|w]
      *
-     * Refer to section 3 in docs/pa2_spec.pdf for more.
+     * Refer to section 3 in docs/pa2_spec.pdf for more. The last column is
+     * an extension; mem insts without it are loads.
      */
 
     for (inst_i = 0;
-            ((inst_i < dis->n) && (dis_can_push_on_list(dis, LIST_DISP)));
+            ((inst_i < n) && (!dis_is_list_full_sn(dis, LIST_DISP, s, n)));
             ++inst_i) {
         /* DAN_TODO: Check for other fetch conditions here. */
-        fscanf_rv = fscanf(g_trace_fptr, "%x %u %d %d %d %x%c",
-            &pc, &inst_type, &dreg, &sreg1, &sreg2, &mem_addr, &newline);
+        mem_op[0] = 'r';
+        do {
+            /* Return if there are no more entries to fetch. */
+            if (!fgets(line, sizeof(line), g_trace_fptr))
+                goto trace_done;
 
-        /* Return if there are no more entries to fetch. */
-        if (EOF == fscanf_rv)
-            goto error_exit;
+            num_fields = sscanf(line, "%" SCNx64 " %u %d %d %d %" SCNx64
+                    " %1s", &pc, &inst_type, &dreg, &sreg1, &sreg2, &mem_addr,
+                    mem_op);
+        } while (num_fields < 6);
 
         /* Create and add the fetched inst to the inst list. */
         new_inst = (struct dis_inst_data *) calloc(1, sizeof(*new_inst));
@@ -579,7 +1156,11 @@ dis_fetch(struct dis_input *dis)
         new_inst->dreg = (REG_NO_VALUE == dreg) ? REG_INVALID_VALUE : dreg;
         new_inst->sreg1 = (REG_NO_VALUE == sreg1) ? REG_INVALID_VALUE : sreg1;
         new_inst->sreg2 = (REG_NO_VALUE == sreg2) ? REG_INVALID_VALUE : sreg2;
+        if (mem_addr & ~dis_get_addr_mask(dis))
+            dis_addr_too_wide(dis, mem_addr);
         new_inst->mem_addr = mem_addr;
+        new_inst->mem_write = (mem_addr && (('w' == mem_op[0]) ||
+                    ('W' == mem_op[0]) || ('s' == mem_op[0]))) ? TRUE : FALSE;
 
         /* If cache is enabled, the latency for type2 insts are based on the
          * cachee lookup results. So, set it to 0 here.
@@ -613,10 +1194,577 @@ dis_fetch(struct dis_input *dis)
             goto error_exit;
         }
     }
-    DL_SORT(dis->list_disp->list, dis_cb_cmp);
+
+    if (dis->stalls.on) {
+        dis_stall_count(dis, STALL_STAGE_FETCH, STALL_USED, inst_i);
+        dis_stall_count(dis, STALL_STAGE_FETCH, STALL_DISP_FULL, (n - inst_i));
+    }
     return TRUE;
 
+trace_done:
+    if (dis->stalls.on) {
+        dis->stalls.trace_done = TRUE;
+        dis_stall_count(dis, STALL_STAGE_FETCH, STALL_USED, inst_i);
+        dis_stall_count(dis, STALL_STAGE_FETCH, STALL_TRACE_DONE,
+                (n - inst_i));
+    }
 error_exit:
     return FALSE;
 }
 
+
+/* Generic pipeline stages, for any S and N. */
+bool
+dis_issue(struct dis_input *dis)
+{
+    return dis_issue_sn(dis, dis->s, dis->n);
+}
+
+
+bool
+dis_dispatch(struct dis_input *dis)
+{
+    return dis_dispatch_sn(dis, dis->s, dis->n, dis->rename_group);
+}
+
+
+bool
+dis_fetch(struct dis_input *dis)
+{
+    return dis_fetch_sn(dis, dis->s, dis->n);
+}
+
+
+/*
+ * One cycle of the pipeline, from retire to fetch. Returns whether the
+ * trace is done.
+ */
+static DIS_ALWAYS_INLINE bool
+dis_cycle_sn(struct dis_input *dis, bool trace_done, const uint32_t s,
+        const uint32_t n, struct dis_inst_node **group)
+{
+    PROF_VAR(ticks);
+
+    PROF_START(ticks);
+    dis_retire(dis);
+    PROF_STOP(PROF_RETIRE, ticks);
+
+    PROF_START(ticks);
+    dis_execute(dis);
+    PROF_STOP(PROF_EXECUTE, ticks);
+
+    PROF_START(ticks);
+    dis_issue_sn(dis, s, n);
+    PROF_STOP(PROF_ISSUE, ticks);
+
+    PROF_START(ticks);
+    dis_dispatch_sn(dis, s, n, group);
+    PROF_STOP(PROF_DISPATCH, ticks);
+
+    /* Done fetching all the insts from the trace file. No more fetch
+     * stages. The tracefile will be closed as part of cleanup.
+     */
+    PROF_START(ticks);
+    if (!trace_done && !dis_fetch_sn(dis, s, n))
+        trace_done = TRUE;
+    else if (trace_done && dis->stalls.on)
+        dis_stall_count(dis, STALL_STAGE_FETCH, STALL_TRACE_DONE, n);
+    PROF_STOP(PROF_FETCH, ticks);
+    return trace_done;
+}
+
+
+/* Generic cycle kernel; S and N are read from the dis data. */
+bool
+dis_cycle_generic(struct dis_input *dis, bool trace_done)
+{
+    return dis_cycle_sn(dis, trace_done, dis->s, dis->n, dis->rename_group);
+}
+
+
+/*
+ * Reference engine. It keeps the baseline pipeline, to check the fast one
+ * against (see dis-lockstep.c): every stage walks the plain linked lists.
+ * Regs are renamed to the number of their producer inst, a tag which is
+ * never reused, and producers wake up their consumers by comparing tags
+ * over the whole issue list. The LSQ is a list searched backwards for
+ * older stores, every unit of an FU pool is scanned for a free one, and
+ * L1 takes one reference at a time. Only the trace parsing of fetch, the
+ * retire stage and the issue stall accounting are shared with the fast
+ * engine.
+ */
+
+/* Checks if both the sregs of the inst have their values (TRUE). */
+static inline bool
+dis_ref_is_ready(struct dis_inst_node *inst)
+{
+    if (dis_is_reg_valid(inst->sreg1.rnum) && !inst->sreg1.ready)
+        return FALSE;
+    if (dis_is_reg_valid(inst->sreg2.rnum) && !inst->sreg2.ready)
+        return FALSE;
+    return TRUE;
+}
+
+
+/*
+ * Select key of an inst which just became ready. For the critical path
+ * policy, its waiting consumers are counted off the issue list.
+ */
+static uint64_t
+dis_ref_select_key(struct dis_input *dis, struct dis_inst_node *inst)
+{
+    uint32_t                num = inst->data->num;
+    uint32_t                num_deps = 0;
+    struct dis_inst_node    *iter = NULL;
+
+    if ((SELECT_CRITICAL_PATH == dis->select) &&
+            dis_is_reg_valid(inst->data->dreg)) {
+        DL_FOREACH(dis->list_issue->list, iter) {
+            if (dis_is_reg_valid(iter->sreg1.rnum) && !iter->sreg1.ready &&
+                    (num == iter->sreg1.name))
+                num_deps += 1;
+            if (dis_is_reg_valid(iter->sreg2.rnum) && !iter->sreg2.ready &&
+                    (num == iter->sreg2.name))
+                num_deps += 1;
+        }
+    }
+    return dis_select_make_key(dis, inst->data, num_deps);
+}
+
+
+/* Appends a mem inst to the LSQ. */
+static void
+dis_ref_lsq_push_inst(struct dis_input *dis, struct dis_inst_data *data)
+{
+    struct dis_inst_node *node = NULL;
+
+    node = (struct dis_inst_node *) calloc(1, sizeof(*node));
+    node->data = data;
+    data->lsq_node = node;
+
+    DL_APPEND(dis->list_lsq->list, node);
+    dis_inst_list_increment_len(dis, LIST_LSQ);
+
+    if (data->mem_write)
+        dis->lsq_stats.num_stores += 1;
+    else
+        dis->lsq_stats.num_loads += 1;
+    return;
+}
+
+
+/* Removes a done mem inst from the LSQ. */
+static void
+dis_ref_lsq_remove_inst(struct dis_input *dis, struct dis_inst_data *data)
+{
+    DL_DELETE(dis->list_lsq->list, data->lsq_node);
+    dis_inst_list_decrement_len(dis, LIST_LSQ);
+    free(data->lsq_node);
+    data->lsq_node = NULL;
+    return;
+}
+
+
+/*
+ * Memory disambiguation for a load, by searching the LSQ backwards from it
+ * for the youngest older store to the same word. The load is held (FALSE)
+ * if that store hasn't issued yet, and forwarded from it if it has.
+ */
+static bool
+dis_ref_lsq_can_issue(struct dis_input *dis, struct dis_inst_node *inst)
+{
+    mem_addr_t              word = (inst->data->mem_addr & LSQ_WORD_MASK);
+    struct dis_inst_node    *iter = inst->data->lsq_node;
+
+    if (!iter || inst->data->mem_write)
+        return TRUE;
+
+    while (iter != dis->list_lsq->list) {
+        iter = iter->prev;
+        if (!iter->data->mem_write ||
+                ((iter->data->mem_addr & LSQ_WORD_MASK) != word))
+            continue;
+
+        if (STATE_EX > iter->data->state) {
+            dis->lsq_stats.num_held += 1;
+            return FALSE;
+        }
+        if (dis->l1)
+            inst->data->mem_fwd = TRUE;
+        return TRUE;
+    }
+    return TRUE;
+}
+
+
+/*
+ * Looks for a unit of the inst type pool which is free this cycle, by
+ * scanning all of them; unlimited pools always have one.
+ */
+static bool
+dis_ref_fu_find(struct dis_input *dis, struct dis_inst_node *inst,
+        uint32_t *unit)
+{
+    struct dis_fu_pool *pool = &dis->fu[inst->data->type];
+
+    if (!pool->count)
+        return TRUE;
+
+    for (*unit = 0; *unit < pool->count; *unit += 1) {
+        if (pool->free_at[*unit] <= dis_get_cycle_num())
+            return TRUE;
+    }
+    pool->num_stalls += 1;
+    return FALSE;
+}
+
+
+/* Issues a ready inst on the given unit, onto the exec list. */
+static void
+dis_ref_issue_inst(struct dis_input *dis, struct dis_inst_node *inst,
+        uint32_t unit)
+{
+    struct dis_fu_pool *pool = &dis->fu[inst->data->type];
+
+    pool->num_issued += 1;
+    if (pool->count)
+        pool->free_at[unit] = (dis_get_cycle_num() + pool->ii);
+
+    dis_inst_set_state(inst, STATE_EX);
+    dis_inst_set_cycle(inst, STATE_EX);
+
+    /* Forwarded loads skip the cache. */
+    if (inst->data->mem_fwd) {
+        inst->data->latency += LSQ_FWD_LATENCY;
+        inst->data->mem_done = TRUE;
+        dis->lsq_stats.num_fwds += 1;
+    }
+
+    DL_DELETE(dis->list_issue->list, inst);
+    dis_inst_list_decrement_len(dis, LIST_ISSUE);
+    DL_APPEND(dis->list_exec->list, inst);
+    dis_inst_list_increment_len(dis, LIST_EXEC);
+    return;
+}
+
+
+/*
+ * Looks up L1 for a mem inst of the exec list, as a single reference. If a
+ * non-blocking L1 has no MSHR for it, it retries next cycle, a cycle later.
+ */
+static void
+dis_ref_cache_lookup(struct dis_input *dis, struct dis_inst_node *inst)
+{
+    uint32_t    latency = 0;
+    mem_ref_t   mref;
+
+    memset(&mref, 0, sizeof(mref));
+    mref.ref_type = (inst->data->mem_write ?
+            MEM_REF_TYPE_WRITE : MEM_REF_TYPE_READ);
+    mref.ref_addr = inst->data->mem_addr;
+    mref.ref_src = MEM_REF_SRC_DEMAND;
+    mref.ref_pc = inst->data->pc;
+
+    if (!cache_handle_memory_request(dis->l1, &mref, &latency)) {
+        inst->data->latency += 1;
+        return;
+    }
+    inst->data->latency += latency;
+    inst->data->mem_done = TRUE;
+    return;
+}
+
+
+/*
+ * Writes back a done inst: sets the ready bit of its dreg, unless a younger
+ * inst has renamed the reg since, and wakes up the issue list sregs with
+ * its tag.
+ */
+static void
+dis_ref_complete_inst(struct dis_input *dis, struct dis_inst_node *inst)
+{
+    uint32_t                num = inst->data->num;
+    bool                    woken = FALSE;
+    struct dis_inst_node    *iter = NULL;
+
+    dis_inst_set_state(inst, STATE_WB);
+    dis_inst_set_cycle(inst, STATE_WB);
+    dis_wback_push_inst(dis, inst);
+
+    if (dis_is_reg_valid(inst->data->dreg)) {
+        if (num == dis->ref_rmt[inst->data->dreg].name)
+            dis->ref_rmt[inst->data->dreg].ready = TRUE;
+
+        DL_FOREACH(dis->list_issue->list, iter) {
+            woken = FALSE;
+            if (dis_is_reg_valid(iter->sreg1.rnum) && !iter->sreg1.ready &&
+                    (num == iter->sreg1.name)) {
+                iter->sreg1.ready = TRUE;
+                woken = TRUE;
+            }
+            if (dis_is_reg_valid(iter->sreg2.rnum) && !iter->sreg2.ready &&
+                    (num == iter->sreg2.name)) {
+                iter->sreg2.ready = TRUE;
+                woken = TRUE;
+            }
+            if (woken && dis_ref_is_ready(iter))
+                iter->data->sel_key = dis_ref_select_key(dis, iter);
+        }
+    }
+
+    if (inst->data->lsq_node)
+        dis_ref_lsq_remove_inst(dis, inst->data);
+    return;
+}
+
+
+/* Execute stage of the reference engine. */
+static void
+dis_ref_execute(struct dis_input *dis)
+{
+    struct dis_inst_node    *iter = NULL;
+    struct dis_inst_node    *tmp = NULL;
+
+    if (dis->l1) {
+        cache_set_cycle(dis_get_cycle_num());
+        DL_FOREACH(dis->list_exec->list, iter) {
+            if (dis_exec_is_mem_pending(dis, iter))
+                dis_ref_cache_lookup(dis, iter);
+        }
+    }
+
+    DL_FOREACH_SAFE(dis->list_exec->list, iter, tmp) {
+        if (!dis_exec_is_mem_pending(dis, iter) &&
+                dis_execute_is_over(dis, iter))
+            dis_ref_complete_inst(dis, iter);
+    }
+    return;
+}
+
+
+/*
+ * Issue stage of the reference engine. The ready insts are gathered from
+ * the issue list, by select key, and then tried in that order.
+ */
+static void
+dis_ref_issue(struct dis_input *dis)
+{
+    uint32_t                i = 0;
+    uint32_t                j = 0;
+    uint32_t                unit = 0;
+    uint32_t                count = 0;
+    uint32_t                num_held = 0;
+    struct dis_inst_node    *iter = NULL;
+    struct dis_inst_node    **ready = dis->ready.nodes;
+
+    /* Insertion sort; the issue list is mostly in key order already. */
+    DL_FOREACH(dis->list_issue->list, iter) {
+        if (!dis_ref_is_ready(iter))
+            continue;
+
+        for (j = count++; j && (ready[j - 1]->data->sel_key >
+                    iter->data->sel_key); --j)
+            ready[j] = ready[j - 1];
+        ready[j] = iter;
+    }
+
+    for (j = 0; (j < count) && (i < dis->n) &&
+            !dis_is_list_full(dis, LIST_EXEC); ++j) {
+        iter = ready[j];
+        if (!dis_ref_fu_find(dis, iter, &unit) ||
+                !dis_ref_lsq_can_issue(dis, iter)) {
+            num_held += 1;
+            continue;
+        }
+        dis_ref_issue_inst(dis, iter, unit);
+        i += 1;
+    }
+
+    if (dis->stalls.on)
+        dis_issue_count_stalls(dis, dis->s, dis->n, i, num_held);
+    return;
+}
+
+
+/* Reads the current mapping of a reg into an issue list node reg. */
+static inline void
+dis_ref_read_rmt(struct dis_input *dis, struct dis_reg_data *reg,
+        uint16_t regno)
+{
+    reg->rnum = regno;
+    reg->name = dis->ref_rmt[regno].name;
+    reg->ready = dis->ref_rmt[regno].ready;
+    return;
+}
+
+
+/*
+ * Dispatch stage of the reference engine. Insts in ID state move to the
+ * issue list one at a time, oldest first, each renamed as it goes, till
+ * the issue list or, for mem insts, the LSQ is full. Then the insts in IF
+ * state move to ID.
+ */
+static void
+dis_ref_dispatch(struct dis_input *dis)
+{
+    uint32_t                count = 0;
+    uint8_t                 stall = 0;
+    struct dis_inst_node    *iter = NULL;
+    struct dis_inst_node    *tmp = NULL;
+    struct dis_inst_data    *data = NULL;
+
+    stall = (dis->stalls.trace_done ? STALL_TRACE_DONE : STALL_STARVED);
+    DL_FOREACH_SAFE(dis->list_disp->list, iter, tmp) {
+        if (STATE_ID != dis_inst_get_state(iter))
+            continue;
+
+        if (dis_is_list_full(dis, LIST_ISSUE)) {
+            stall = STALL_SCHED_FULL;
+            break;
+        }
+
+        data = iter->data;
+        if (data->mem_addr && dis_is_list_full(dis, LIST_LSQ)) {
+            dis->lsq_stats.num_full_stalls += 1;
+            stall = STALL_LSQ_FULL;
+            break;
+        }
+
+        /* Sregs first, so an inst reading its own dreg waits on the older
+         * producer.
+         */
+        dis_ref_read_rmt(dis, &iter->sreg1, data->sreg1);
+        dis_ref_read_rmt(dis, &iter->sreg2, data->sreg2);
+        if (dis_is_reg_valid(data->dreg)) {
+            dis->ref_rmt[data->dreg].name = data->num;
+            dis->ref_rmt[data->dreg].ready = FALSE;
+        }
+        dis_ref_read_rmt(dis, &iter->dreg, data->dreg);
+
+        DL_DELETE(dis->list_disp->list, iter);
+        dis_inst_list_decrement_len(dis, LIST_DISP);
+        dis_inst_set_state(iter, STATE_IS);
+        dis_inst_set_cycle(iter, STATE_IS);
+        DL_APPEND(dis->list_issue->list, iter);
+        dis_inst_list_increment_len(dis, LIST_ISSUE);
+
+        if (data->mem_addr)
+            dis_ref_lsq_push_inst(dis, data);
+        count += 1;
+    }
+
+    if (dis->stalls.on) {
+        dis_stall_count(dis, STALL_STAGE_DISPATCH, STALL_USED,
+                ((count < dis->n) ? count : dis->n));
+        if (count < dis->n)
+            dis_stall_count(dis, STALL_STAGE_DISPATCH, stall,
+                    (dis->n - count));
+    }
+
+    /* The ready ones get their select key once all of them are in, so
+     * that the consumers among them count.
+     */
+    DL_FOREACH(dis->list_issue->list, iter) {
+        if ((dis_get_cycle_num() == iter->data->cycle[STATE_IS]) &&
+                dis_ref_is_ready(iter))
+            iter->data->sel_key = dis_ref_select_key(dis, iter);
+    }
+
+    DL_FOREACH(dis->list_disp->list, iter) {
+        if (STATE_IF != dis_inst_get_state(iter))
+            continue;
+
+        dis_inst_set_state(iter, STATE_ID);
+        dis_inst_set_cycle(iter, STATE_ID);
+    }
+    return;
+}
+
+
+/* Cycle function of the reference engine. */
+bool
+dis_cycle_ref(struct dis_input *dis, bool trace_done)
+{
+    dis_retire(dis);
+    dis_ref_execute(dis);
+    dis_ref_issue(dis);
+    dis_ref_dispatch(dis);
+
+    if (!trace_done && !dis_fetch(dis))
+        trace_done = TRUE;
+    else if (trace_done && dis->stalls.on)
+        dis_stall_count(dis, STALL_STAGE_FETCH, STALL_TRACE_DONE, dis->n);
+    return trace_done;
+}
+
+
+/*
+ * Cycle kernels specialized for the (S, N) pairs of the standard sweep. S
+ * and N are constants here, so all the queue bounds and the issue width
+ * fold into immediates and the rename group is a fixed size array. The
+ * pipeline lists are linked lists, so the walks themselves stay loops.
+ */
+#define DIS_CYCLE_KERNEL(S, N)                                              \
+static bool                                                                 \
+dis_cycle_##S##_##N(struct dis_input *dis, bool trace_done)                 \
+{                                                                           \
+    struct dis_inst_node *group[2 * (N)];                                   \
+                                                                            \
+    return dis_cycle_sn(dis, trace_done, (S), (N), group);                  \
+}
+
+#define DIS_CYCLE_KERNELS_S(X, S)                                           \
+    X(S, 1) X(S, 2) X(S, 4) X(S, 8) X(S, 16)
+
+#define DIS_CYCLE_KERNELS(X)                                                \
+    DIS_CYCLE_KERNELS_S(X, 8)                                               \
+    DIS_CYCLE_KERNELS_S(X, 16)                                              \
+    DIS_CYCLE_KERNELS_S(X, 32)                                              \
+    DIS_CYCLE_KERNELS_S(X, 64)                                              \
+    DIS_CYCLE_KERNELS_S(X, 128)                                             \
+    DIS_CYCLE_KERNELS_S(X, 256)
+
+DIS_CYCLE_KERNELS(DIS_CYCLE_KERNEL)
+
+#define DIS_CYCLE_KERNEL_ENTRY(S, N)    {(S), (N), dis_cycle_##S##_##N},
+
+static const struct dis_cycle_kernel {
+    uint32_t            s;
+    uint32_t            n;
+    dis_cycle_fn_t      fn;
+} g_dis_cycle_kernels[] = {
+    DIS_CYCLE_KERNELS(DIS_CYCLE_KERNEL_ENTRY)
+};
+
+
+/*
+ * Picks the cycle kernel for the configured S and N; the generic one if
+ * there is no specialized kernel for them.
+ */
+dis_cycle_fn_t
+dis_get_cycle_kernel(struct dis_input *dis)
+{
+    uint32_t i = 0;
+
+    for (i = 0; i < (sizeof(g_dis_cycle_kernels) /
+                sizeof(g_dis_cycle_kernels[0])); ++i) {
+        if ((g_dis_cycle_kernels[i].s == dis->s) &&
+                (g_dis_cycle_kernels[i].n == dis->n))
+            return g_dis_cycle_kernels[i].fn;
+    }
+    return dis_cycle_generic;
+}
+
+
+/* Returns the pipeline engine of the given name; ENGINE_INVALID if none. */
+uint8_t
+dis_engine_get_type(const char *name)
+{
+    if (!strcmp(name, "fast"))
+        return ENGINE_FAST;
+    if (!strcmp(name, "ref"))
+        return ENGINE_REF;
+    if (!strcmp(name, "lockstep"))
+        return ENGINE_LOCKSTEP;
+    return ENGINE_INVALID;
+}
@@ -11,6 +11,9 @@
 #ifndef DIS_PIPELINE_H_
 #define DIS_PIPELINE_H_
 
+/* Externs */
+extern uint8_t g_latency[];
+
 /* Inline functions */
 /* Returns the length of the given list. */
 static inline uint32_t
@@ -27,6 +30,8 @@ dis_inst_list_get_len(struct dis_input *dis, uint8_t list)
         return dis->list_exec->len;
     case LIST_WBACK:
         return dis->list_wback->len;
+    case LIST_LSQ:
+        return dis->list_lsq->len;
     default:
         dis_assert(0);
         return 0;
@@ -80,7 +85,7 @@ dis_is_reg_valid(uint16_t regno)
 static inline bool
 dis_is_reg_ready(struct dis_input *dis, uint16_t regno)
 {
-    return (((dis_is_reg_valid(regno)) && (dis->rmt[regno]->ready))
+    return (((dis_is_reg_valid(regno)) && (dis->rmt[regno] & RMT_READY_BIT))
             ? TRUE : FALSE);
 }
 
@@ -90,18 +95,17 @@ static inline uint32_t
 dis_get_reg_name(struct dis_input *dis, uint16_t regno)
 {
     if (dis_is_reg_valid(regno))
-        return dis->rmt[regno]->name;
+        return (dis->rmt[regno] & RMT_NAME_MASK);
     return 0;
 }
 
 
-/* Returns the cycle # when the reg was renamed last. */
-static inline uint32_t
-dis_get_reg_cycle(struct dis_input *dis, uint16_t regno)
+/* Returns the mask for the address bits simulated, e.g. 0xffffffff. */
+static inline mem_addr_t
+dis_get_addr_mask(struct dis_input *dis)
 {
-    if (dis_is_reg_valid(regno))
-        return dis->rmt[regno]->cycle;
-    return 0;
+    return ((dis->addr_bits < CACHE_ADDR_MAX_BITS) ?
+            ((((mem_addr_t) 1) << dis->addr_bits) - 1) : ~((mem_addr_t) 0));
 }
 
 
@@ -136,5 +140,34 @@ dis_execute(struct dis_input *dis);
 bool
 dis_retire(struct dis_input *dis);
 
+typedef bool (*dis_cycle_fn_t)(struct dis_input *dis, bool trace_done);
+
+dis_cycle_fn_t
+dis_get_cycle_kernel(struct dis_input *dis);
+
+bool
+dis_cycle_generic(struct dis_input *dis, bool trace_done);
+
+bool
+dis_cycle_ref(struct dis_input *dis, bool trace_done);
+
+uint8_t
+dis_engine_get_type(const char *name);
+
+bool
+dis_prf_init(struct dis_input *dis);
+
+void
+dis_prf_cleanup(struct dis_input *dis);
+
+bool
+dis_fu_init(struct dis_input *dis);
+
+void
+dis_fu_cleanup(struct dis_input *dis);
+
+void
+dis_addr_too_wide(struct dis_input *dis, mem_addr_t addr);
+
 #endif /* DIS_PIPELINE_H_ */
 
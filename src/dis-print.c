@@ -11,23 +11,35 @@
 
 #include <stdio.h>
 #include <stdint.h>
+#include <inttypes.h>
+#include <unistd.h>
 
 #include "dis.h"
 #include "dis-utils.h"
 #include "dis-print.h"
 #include "dis-pipeline.h"
+#include "dis-occupancy.h"
 #include "dis-cache-print.h"
 #include "utlist.h"
 
 const char *inst_states[] = {"IF", "ID", "IS", "EX", "WB"};
+const char *stall_reasons[] = {"used", "dispatch queue full",
+    "scheduler full", "LSQ full", "operand wait", "exec list full",
+    "FU busy or load held", "starved", "trace exhausted"};
+
+/* Output writer of the per inst lines, fed as the insts retire. */
+static struct dis_out g_inst_out;
 
 
 /*
  * Pretty prints the stats (inum, type, stage start cycle and duration) of
- * the given inst in TAs format.
+ * the given inst in TAs format, i.e.,
+ * "%u fu{%u} src{%d,%d} dst{%d} IF{%u,%u} ID{%u,%u} IS{%u,%u} EX{%u,%u}
+ * WB{%u,%u}\n", thru the output writer.
  */
 inline void
-dis_print_inst_entry_stats(struct dis_input *dis, struct dis_inst_node *inst)
+dis_print_inst_entry_stats(struct dis_input *dis, struct dis_out *out,
+        struct dis_inst_node *inst)
 {
     int16_t sreg1, sreg2, dreg;
     struct dis_inst_data *data = inst->data;
@@ -36,46 +48,268 @@ dis_print_inst_entry_stats(struct dis_input *dis, struct dis_inst_node *inst)
     sreg2 = (dis_is_reg_valid(data->sreg2) ? data->sreg2 : -1);
     dreg = (dis_is_reg_valid(data->dreg) ? data->dreg : -1);
 
-    dprint("%u fu{%u} src{%d,%d} dst{%d} ",
-        data->num, data->type, sreg1, sreg2, dreg);
-    dprint("IF{%u,%u} ID{%u,%u} IS{%u,%u} EX{%u,%u} WB{%u,%u}\n",
-        data->cycle[STATE_IF], data->cycle[STATE_ID] - data->cycle[STATE_IF],
-        data->cycle[STATE_ID], data->cycle[STATE_IS] - data->cycle[STATE_ID],
-        data->cycle[STATE_IS], data->cycle[STATE_EX] - data->cycle[STATE_IS],
-        data->cycle[STATE_EX], data->cycle[STATE_WB] - data->cycle[STATE_EX],
-        data->cycle[STATE_WB], 1);
+    dis_out_reserve(out, DIS_OUT_LINE_MAX);
+    dis_out_u32(out, data->num);
+    dis_out_lit(out, " fu{");
+    dis_out_u32(out, data->type);
+    dis_out_lit(out, "} src{");
+    dis_out_i32(out, sreg1);
+    dis_out_lit(out, ",");
+    dis_out_i32(out, sreg2);
+    dis_out_lit(out, "} dst{");
+    dis_out_i32(out, dreg);
+    dis_out_lit(out, "} IF{");
+    dis_out_u32(out, data->cycle[STATE_IF]);
+    dis_out_lit(out, ",");
+    dis_out_u32(out, data->cycle[STATE_ID] - data->cycle[STATE_IF]);
+    dis_out_lit(out, "} ID{");
+    dis_out_u32(out, data->cycle[STATE_ID]);
+    dis_out_lit(out, ",");
+    dis_out_u32(out, data->cycle[STATE_IS] - data->cycle[STATE_ID]);
+    dis_out_lit(out, "} IS{");
+    dis_out_u32(out, data->cycle[STATE_IS]);
+    dis_out_lit(out, ",");
+    dis_out_u32(out, data->cycle[STATE_EX] - data->cycle[STATE_IS]);
+    dis_out_lit(out, "} EX{");
+    dis_out_u32(out, data->cycle[STATE_EX]);
+    dis_out_lit(out, ",");
+    dis_out_u32(out, data->cycle[STATE_WB] - data->cycle[STATE_EX]);
+    dis_out_lit(out, "} WB{");
+    dis_out_u32(out, data->cycle[STATE_WB]);
+    dis_out_lit(out, ",1}\n");
 
     return;
 }
 
 
 /*
- * Pretty prints the insts (as in program order) stats in TAs format.
+ * Prints the load/store queue stats: loads and stores seen, loads fed by
+ * store-to-load forwarding and the cycles loads were held for an older
+ * store to the same word.
  */
-inline void
-dis_print_inst_stats(struct dis_input *dis)
+static void
+dis_print_lsq_stats(struct dis_input *dis)
 {
-    struct dis_inst_node *iter = NULL;
+    struct dis_lsq_stats *stats = &dis->lsq_stats;
+
+    dprint("LOAD/STORE QUEUE\n");
+    dprint("a. number of loads : %u\n", stats->num_loads);
+    dprint("b. number of stores : %u\n", stats->num_stores);
+    dprint("c. number of forwarded loads : %u\n", stats->num_fwds);
+    dprint("d. load cycles held for older stores : %u\n", stats->num_held);
+    dprint("e. dispatch stalls, LSQ full : %u\n", stats->num_full_stalls);
+    dprint("\n");
+    return;
+}
 
-    /* First, sort and print all instruction entries with timing info. */
-    DL_SORT(dis->list_wback->list, dis_cb_cmp);
-    DL_FOREACH(dis->list_wback->list, iter)
-        dis_print_inst_entry_stats(dis, iter);
+
+/* Prints the configured functional unit pools and their stats. */
+static void
+dis_print_fu_stats(struct dis_input *dis)
+{
+    uint32_t            type = 0;
+    bool                header = FALSE;
+    struct dis_fu_pool  *pool = NULL;
+
+    for (type = 0; type < TYPE_MAX; ++type) {
+        pool = &dis->fu[type];
+        if (!pool->count && !pool->latency)
+            continue;
+
+        if (!header) {
+            dprint("FUNCTIONAL UNITS\n");
+            header = TRUE;
+        }
+        if (pool->count)
+            dprint("type %u : %u units, latency %u, ii %u\n", type,
+                    pool->count, g_latency[type], pool->ii);
+        else
+            dprint("type %u : unlimited units, latency %u\n", type,
+                    g_latency[type]);
+        dprint("a. number of insts issued : %u\n", pool->num_issued);
+        dprint("b. ready inst cycles held for a unit : %u\n",
+                pool->num_stalls);
+    }
+
+    if (header)
+        dprint("\n");
+    return;
+}
+
+
+/*
+ * Prints where the fetch, dispatch and issue slots went and the CPI stack.
+ * Every cycle has N issue slots, so the issue slots charged to a reason,
+ * over N times the # of insts, add up to the CPI.
+ */
+static void
+dis_print_stall_stats(struct dis_input *dis)
+{
+    uint32_t    reason = 0;
+    uint64_t    (*slots)[STALL_MAX] = dis->stalls.slots;
+    double      per_inst = 0.0;
+
+    dprint("STALLS\n");
+    dprint("a. slots per stage (fetch / dispatch / issue)\n");
+    for (reason = 0; reason < STALL_MAX; ++reason) {
+        if (!slots[STALL_STAGE_FETCH][reason] &&
+                !slots[STALL_STAGE_DISPATCH][reason] &&
+                !slots[STALL_STAGE_ISSUE][reason])
+            continue;
+        dprint("   %-22s = %" PRIu64 " / %" PRIu64 " / %" PRIu64 "\n",
+                stall_reasons[reason], slots[STALL_STAGE_FETCH][reason],
+                slots[STALL_STAGE_DISPATCH][reason],
+                slots[STALL_STAGE_ISSUE][reason]);
+    }
+
+    dprint("b. CPI stack, by issue slots\n");
+    per_inst = (1.0 / ((double) dis->n * (double) dis_get_inst_num()));
+    for (reason = 0; reason < STALL_MAX; ++reason) {
+        if (!slots[STALL_STAGE_ISSUE][reason])
+            continue;
+        dprint("   %-22s = %.4f\n",
+                ((STALL_USED == reason) ? "base" : stall_reasons[reason]),
+                ((double) slots[STALL_STAGE_ISSUE][reason] * per_inst));
+    }
+    dprint("   %-22s = %.4f\n", "CPI",
+            ((double) (dis_get_cycle_num() + 1) /
+             (double) dis_get_inst_num()));
+    dprint("\n");
+    return;
+}
+
+
+/*
+ * Prints the occupancy of each queue: mean, percentiles, max and the cycles
+ * spent full, and then a histogram over OCC_HIST_BINS equal bins of the
+ * queue capacity.
+ */
+static void
+dis_print_occupancy_stats(struct dis_input *dis)
+{
+    const char              *names[] = {"dispatch list", "issue list",
+                                "exec list", "in flight"};
+    uint8_t                 queue = 0;
+    uint32_t                len = 0;
+    uint32_t                max = 0;
+    uint32_t                bin = 0;
+    uint32_t                bin_size = 0;
+    uint64_t                count = 0;
+    double                  mean = 0.0;
+    struct dis_occupancy    *occ = &dis->occupancy;
+
+    if (!occ->num_cycles)
+        return;
+
+    dprint("OCCUPANCY\n");
+    for (queue = 0; queue < OCC_MAX; ++queue) {
+        mean = 0.0;
+        max = 0;
+        for (len = 0; len <= occ->size[queue]; ++len) {
+            if (!occ->hist[queue][len])
+                continue;
+            mean += ((double) len * (double) occ->hist[queue][len]);
+            max = len;
+        }
+        mean /= (double) occ->num_cycles;
+
+        dprint("%s (size %u) : mean %.2f, p50 %u, p90 %u, p99 %u, max %u, "
+                "full %.2f%%\n", names[queue], occ->size[queue], mean,
+                dis_occupancy_get_percentile(dis, queue, 50),
+                dis_occupancy_get_percentile(dis, queue, 90),
+                dis_occupancy_get_percentile(dis, queue, 99), max,
+                ((100.0 * (double) occ->hist[queue][occ->size[queue]]) /
+                 (double) occ->num_cycles));
+
+        bin_size = ((occ->size[queue] + OCC_HIST_BINS) / OCC_HIST_BINS);
+        for (bin = 0; (bin * bin_size) <= occ->size[queue]; ++bin) {
+            count = 0;
+            for (len = (bin * bin_size); (len < ((bin + 1) * bin_size)) &&
+                    (len <= occ->size[queue]); ++len)
+                count += occ->hist[queue][len];
+            dprint("   %6u - %-6u : %6.2f%%\n", (bin * bin_size), (len - 1),
+                    ((100.0 * (double) count) / (double) occ->num_cycles));
+        }
+    }
+    dprint("\n");
+    return;
+}
+
+
+/* Prints the contents and stats of the whole cache hierarchy, if any. */
+static void
+dis_print_cache_stats(struct dis_input *dis)
+{
+    cache_generic_t *cache = NULL;
 
     /* Print L1 cache data, if present. */
     if (dis->l1) {
         cache_print_cache_data(dis->l1);
 
-        /* Print L2 cache data, if present. */
-        if (dis->l2) {
+        /* Print L1 MSHR data, if non-blocking. */
+        if (dis->l1->mshr) {
+            dprint("\n");
+            cache_print_mshr_stats(dis->l1);
+        }
+
+        /* Print the rest of the hierarchy (VC, L2 ..), if present. */
+        for (cache = dis->l1->next_cache; cache; cache = cache->next_cache) {
             dprint("\n");
-            cache_print_cache_data(dis->l2);
+            cache_print_cache_data(cache);
         }
 
         dprint("\n");
     }
+    return;
+}
 
 
+/* Sets up the output writer for the per inst lines, before the run. */
+void
+dis_print_inst_init(struct dis_input *dis)
+{
+    dis_out_init(&g_inst_out, STDOUT_FILENO);
+    return;
+}
+
+
+/* Prints the line of an inst as it retires, i.e., in program order. */
+void
+dis_print_inst_retire(struct dis_input *dis, struct dis_inst_node *inst)
+{
+    dis_print_inst_entry_stats(dis, &g_inst_out, inst);
+    return;
+}
+
+
+/*
+ * Pretty prints the insts (as in program order) stats in TAs format.
+ */
+inline void
+dis_print_inst_stats(struct dis_input *dis)
+{
+    /* First, the instruction entries with timing info; they went to the
+     * output writer as they retired.
+     */
+    dis_out_flush(&g_inst_out);
+
+    dis_print_cache_stats(dis);
+
+    /* LSQ data, only for traces with stores. */
+    if (dis->lsq_stats.num_stores)
+        dis_print_lsq_stats(dis);
+
+    /* Functional unit pools, only if any were given. */
+    dis_print_fu_stats(dis);
+
+    /* Queue occupancy, if asked for. */
+    if (dis->occupancy.on)
+        dis_print_occupancy_stats(dis);
+
+    /* Stall reasons and the CPI stack, if asked for. */
+    if (dis->stalls.on)
+        dis_print_stall_stats(dis);
+
     /* Now, the scheduler configuration. */
     dprint("CONFIGURATION\n");
     dprint(" superscalar bandwidth (N) = %u\n", dis->n);
@@ -94,6 +328,24 @@ dis_print_inst_stats(struct dis_input *dis)
 }
 
 
+/* Prints the dataflow limit of the trace; S and N play no part in it. */
+void
+dis_print_dataflow_stats(struct dis_input *dis)
+{
+    uint32_t path_len = dis->dataflow.path_len;
+
+    dis_print_cache_stats(dis);
+
+    dprint("DATAFLOW LIMIT\n");
+    dprint(" number of instructions = %u\n", dis_get_inst_num());
+    dprint(" critical path length   = %u\n", path_len);
+    dprint(" IPC                    = %.2f\n",
+            (path_len ? ((double) dis_get_inst_num() / (double) path_len) :
+             0.0));
+    return;
+}
+
+
 void
 dis_print_inst_graph_data(struct dis_input *dis)
 {
@@ -150,6 +402,13 @@ dis_print_list(struct dis_input *dis, uint8_t list_type)
         list = dis->list_wback->list;
         break;
 
+    case LIST_LSQ:
+        dprint("\n");
+        dprint("lsq list\n");
+        dprint("--------\n");
+        list = dis->list_lsq->list;
+        break;
+
     default:
         dis_assert(0);
         goto exit;
@@ -163,8 +422,8 @@ dis_print_list(struct dis_input *dis, uint8_t list_type)
         sreg2 = (REG_INVALID_VALUE == iter->data->sreg2) ? 
             REG_NO_VALUE : iter->data->sreg2;
 
-        dprint("inum %5u, pc 0x%x, dreg %3d/%d, sreg1 %3d/%d, sreg2 %3d/%d, "    \
-                "mem_addr 0x%08x, state %s, ",
+        dprint("inum %5u, pc 0x%" PRIx64 ", dreg %3d/%d, sreg1 %3d/%d, "      \
+                "sreg2 %3d/%d, mem_addr 0x%08" PRIx64 ", state %s, ",
                 iter->data->num, iter->data->pc, dreg, iter->dreg.name, 
                 sreg1, iter->sreg1.name, sreg2, iter->sreg2.name,
                 iter->data->mem_addr, inst_states[iter->data->state]);
@@ -184,13 +443,11 @@ static inline void
 dis_print_rmt_entry(struct dis_input *dis, uint16_t regno, bool format)
 {
     if (format) {
-        dprint("reg %3u, name %5u, ready %u, cycle %5u\n",
-            regno, dis_get_reg_name(dis, regno), dis_is_reg_ready(dis, regno),
-            dis_get_reg_cycle(dis, regno));
+        dprint("reg %3u, name %5u, ready %u\n",
+            regno, dis_get_reg_name(dis, regno), dis_is_reg_ready(dis, regno));
     } else {
-        dprint("reg %u, name %u, ready %u, cycle %u\n",
-            regno, dis_get_reg_name(dis, regno), dis_is_reg_ready(dis, regno),
-            dis_get_reg_cycle(dis, regno));
+        dprint("reg %u, name %u, ready %u\n",
+            regno, dis_get_reg_name(dis, regno), dis_is_reg_ready(dis, regno));
     }
     return;
 }
@@ -220,6 +477,8 @@ dis_print_rmt(struct dis_input *dis, int16_t regno)
 void
 dis_print_input_data(struct dis_input *dis)
 {
+    cache_generic_t *cache = NULL;
+
     if (!dis) {
         dis_assert(0);
         goto exit;
@@ -230,20 +489,14 @@ dis_print_input_data(struct dis_input *dis)
     dprint("    s: %u\n", dis->s);
     dprint("    n: %u\n", dis->n);
 
-    if (dis->l1) {
-        dprint("    l1 size: %u\n", dis->l1->size);
-        dprint("    l1 set assoc: %u\n", dis->l1->set_assoc);
-        dprint("    l1 block size: %u\n", dis->l1->blk_size);
-    } else {
+    if (!dis->l1)
         dprint("    l1 not present\n");
-    }
 
-    if (dis->l2) {
-        dprint("    l2 size: %u\n", dis->l2->size);
-        dprint("    l2 set assoc: %u\n", dis->l2->set_assoc);
-        dprint("    l2 block size: %u\n", dis->l2->blk_size);
-    } else {
-        dprint("    l2 not present\n");
+    for (cache = dis->l1; cache; cache = cache->next_cache) {
+        dprint("    %s size: %u\n", cache->name, cache->size);
+        dprint("    %s set assoc: %u\n", cache->name, cache->set_assoc);
+        dprint("    %s block size: %u\n", cache->name, cache->blk_size);
+        dprint("    %s hit latency: %u\n", cache->name, cache->hit_latency);
     }
 
     dprint("    tracefile: %s\n", dis->tracefile);
@@ -252,3 +505,103 @@ exit:
     return;
 }
 
+
+void
+dis_print_usage(const char *prog)
+{
+    dprint("Usage: %s [options] <S> <N> <block-size> <l1-size> <l1-assoc> "   \
+            "<l2-size> <l2-assoc>\n"                                          \
+            "          <trace-file>\n", prog);
+    dprint("    S                   : size of the scheduling queue.\n");
+    dprint("    N                   : superscalar bandwidth.\n");
+    dprint("    block-size          : size of each cache block in bytes; "     \
+            "0 disables caches.\n");
+    dprint("    l1-size, l1-assoc   : size and set associativity of L1.\n");
+    dprint("    l2-size, l2-assoc   : size and set associativity of L2; "      \
+            "0 disables L2.\n");
+    dprint("    trace-file          : instruction trace file with full "       \
+            "path; an\n"                                                     \
+            "                          optional 7th column marks "           \
+            "loads (r) and\n"                                                \
+            "                          stores (w).\n");
+    dprint("Options:\n");
+    dprint("    --mshr <n>          : make L1 non-blocking with n MSHRs.\n");
+    dprint("    --fill-interval <c> : cycles between two L1 block fills "      \
+            "(with --mshr).\n");
+    dprint("    --victim <size>     : add a fully associative L1 victim "      \
+            "cache of size bytes.\n");
+    dprint("    --tag-index         : hash index tags of caches with "         \
+            "8 or more ways.\n");
+    dprint("    --snapshot-save <f> : save the warm cache state to file f.\n");
+    dprint("    --snapshot-at <n>   : take the snapshot once n insts are "      \
+            "done; default at end.\n");
+    dprint("    --snapshot-load <f> : start with the cache state saved in "    \
+            "file f.\n");
+    dprint("    --sched <e>         : issue queue wakeup engine, list "        \
+            "(default) or\n"                                                 \
+            "                          matrix.\n");
+    dprint("    --select <p>        : issue select policy, oldest "           \
+            "(default), loads-first,\n"                                      \
+            "                          longest-latency or critical-path.\n");
+    dprint("    --generic-kernel    : do not use the cycle kernels "          \
+            "specialized for S and N.\n");
+    dprint("    --fu <t>:<c>[:<l>[:<i>]]\n"                                   \
+            "                        : c units (0 = unlimited) for inst "    \
+            "type t, with latency\n"                                         \
+            "                          l and initiation interval i "         \
+            "(default 1).\n");
+    dprint("    --stall-stats       : charge every unused fetch, dispatch "    \
+            "and issue slot to\n"                                            \
+            "                          a stall reason and print a CPI "      \
+            "stack.\n");
+    dprint("    --occupancy         : print histograms of the dispatch, "      \
+            "issue and exec list\n"                                          \
+            "                          lengths and of all insts in "         \
+            "flight.\n");
+    dprint("    --occupancy-series <f>[:<k>]\n"                               \
+            "                        : also write the mean lengths over "    \
+            "every k cycles\n"                                               \
+            "                          (default 100) to file f.\n");
+    dprint("    --perf-counters     : measure the simulator with the host "    \
+            "hardware counters,\n"                                           \
+            "                          where available.\n");
+    dprint("    --engine <e>        : pipeline engine, fast (default), "      \
+            "ref, the baseline\n"                                            \
+            "                          linked list pipeline which ignores "  \
+            "--sched, or\n"                                                  \
+            "                          lockstep, fast checked against ref "  \
+            "every cycle.\n");
+    dprint("    --cycle-log <f>     : write the list lengths, cache stats "    \
+            "and the insts\n"                                                \
+            "                          done, every cycle, to file f.\n");
+    dprint("    --dataflow          : report the dataflow limit IPC and "      \
+            "critical path of\n"                                             \
+            "                          the trace; S and N are ignored.\n");
+    dprint("    --dump-order <o>    : print the cache contents in way "        \
+            "(default) or mru\n"                                             \
+            "                          order.\n");
+    dprint("    --dump-bin <f>      : write the final cache contents to "      \
+            "file f in binary.\n");
+    dprint("    --set-sample <k>    : simulate only 1 in k sets of L2 and "    \
+            "beyond, and\n"                                                  \
+            "                          extrapolate the rest.\n");
+    dprint("    --addr-bits <b>     : simulate b-bit addresses (32 - 64); "    \
+            "default 64.\n"                                                  \
+            "                          Wider trace addresses are an "          \
+            "error.\n");
+    dprint("    --lsq <n>           : n entry load/store queue; default "      \
+            "holds all mem\n"                                                \
+            "                          insts in the issue and exec "          \
+            "lists.\n");
+    dprint("    --prefetch <l>:<t>[:<d>]\n"                                    \
+            "                        : attach prefetcher t (next-line, "     \
+            "stride or stream)\n"                                            \
+            "                          of degree d (default %u) to "         \
+            "cache level l.\n", CACHE_PF_DEFAULT_DEGREE);
+    dprint("    --cache-config <f>  : read the cache hierarchy from file f; "  \
+            "the cache\n"                                                    \
+            "                          arguments are then left out:\n"       \
+            "                          %s [options] <S> <N> <trace-file>\n",  \
+            prog);
+    return;
+}
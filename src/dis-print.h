@@ -12,6 +12,7 @@
 #define DIS_PRINT_H_
 
 #include "dis.h"
+#include "dis-utils.h"
 
 /* Function declarations */
 void
@@ -23,12 +24,25 @@ dis_print_rmt(struct dis_input *dis, int16_t regno);
 void
 dis_print_input_data(struct dis_input *dis);
 
+void
+dis_print_usage(const char *prog);
+
 inline void
-dis_print_inst_entry_stats(struct dis_input *dis, struct dis_inst_node *inst);
+dis_print_inst_entry_stats(struct dis_input *dis, struct dis_out *out,
+        struct dis_inst_node *inst);
+
+void
+dis_print_inst_init(struct dis_input *dis);
+
+void
+dis_print_inst_retire(struct dis_input *dis, struct dis_inst_node *inst);
 
 inline void
 dis_print_inst_stats(struct dis_input *dis);
 
+void
+dis_print_dataflow_stats(struct dis_input *dis);
+
 void
 dis_print_inst_graph_data(struct dis_input *dis);
 
@@ -0,0 +1,64 @@
+/*
+ * ECE 521 - Computer Design Techniques, Fall 2014
+ * Project 3 - Dynamic Instruction Scheduler
+ *
+ * This module keeps the host ticks spent in each pipeline stage and prints
+ * the breakdown at exit, per simulated cycle and per inst. Only built into
+ * the PROF_ON builds.
+ *
+ * Author: Aravindhan Dhanasekaran <adhanas@ncsu.edu>
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <inttypes.h>
+
+#include "dis.h"
+#include "dis-utils.h"
+#include "dis-pipeline.h"
+#include "dis-prof.h"
+
+#ifdef PROF_ON
+/* Globals */
+uint64_t    g_prof_ticks[PROF_MAX];     /* host ticks, per stage    */
+
+static const char *g_prof_names[PROF_MAX] = {
+    "retire", "execute", " cache lookup", "issue", "dispatch", "fetch"};
+
+
+/*
+ * Prints the ticks spent in each stage, their share of the total and the
+ * ticks per cycle and per inst. The cache lookups are a part of execute, so
+ * they are left out of the total.
+ */
+void
+dis_prof_print(struct dis_input *dis)
+{
+    uint32_t    stage = 0;
+    uint64_t    total = 0;
+    double      num_cycles = (double) (dis_get_cycle_num() + 1);
+    double      num_insts = (double) dis_get_inst_num();
+
+    for (stage = 0; stage < PROF_MAX; ++stage) {
+        if (PROF_CACHE != stage)
+            total += g_prof_ticks[stage];
+    }
+    if (!total || !num_insts)
+        return;
+
+    dprint("PROFILE (host ticks)\n");
+    dprint(" %-14s %14s %7s %10s %10s\n", "stage", "ticks", "share",
+            "/cycle", "/inst");
+    for (stage = 0; stage < PROF_MAX; ++stage) {
+        dprint(" %-14s %14" PRIu64 " %6.2f%% %10.1f %10.1f\n",
+                g_prof_names[stage], g_prof_ticks[stage],
+                ((100.0 * (double) g_prof_ticks[stage]) / (double) total),
+                ((double) g_prof_ticks[stage] / num_cycles),
+                ((double) g_prof_ticks[stage] / num_insts));
+    }
+    dprint(" %-14s %14" PRIu64 " %6.2f%% %10.1f %10.1f\n", "total", total,
+            100.0, ((double) total / num_cycles),
+            ((double) total / num_insts));
+    return;
+}
+#endif /* PROF_ON */
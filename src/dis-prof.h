@@ -0,0 +1,67 @@
+/*
+ * ECE 521 - Computer Design Techniques, Fall 2014
+ * Project 3 - Dynamic Instruction Scheduler
+ *
+ * This module contains the macros for timing the pipeline stages and the
+ * cache lookups in host ticks; the TSC on x86, nanoseconds elsewhere. They
+ * compile to nothing unless the build has PROF_ON (make PROFILE="-D PROF_ON").
+ *
+ * Author: Aravindhan Dhanasekaran <adhanas@ncsu.edu>
+ */
+
+#ifndef DIS_PROF_H_
+#define DIS_PROF_H_
+
+#include <stdint.h>
+
+#include "dis.h"
+
+/* Constants */
+#define PROF_RETIRE             0
+#define PROF_EXECUTE            1       /* includes the cache lookups   */
+#define PROF_CACHE              2
+#define PROF_ISSUE              3
+#define PROF_DISPATCH           4
+#define PROF_FETCH              5
+#define PROF_MAX                6
+
+#ifdef PROF_ON
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <time.h>
+#endif
+
+/* Externs */
+extern uint64_t g_prof_ticks[PROF_MAX];
+
+/* Inline functions */
+/* Returns the current host tick count. */
+static inline uint64_t
+dis_prof_now(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (((uint64_t) ts.tv_sec * 1000000000ULL) + ts.tv_nsec);
+#endif
+}
+
+/* Declare the tick variable last among the locals of the function. */
+#define PROF_VAR(v)         uint64_t v = 0
+#define PROF_START(v)       ((v) = dis_prof_now())
+#define PROF_STOP(id, v)    (g_prof_ticks[(id)] += (dis_prof_now() - (v)))
+
+/* Function declarations */
+void
+dis_prof_print(struct dis_input *dis);
+#else
+#define PROF_VAR(v)         uint64_t v __attribute__((unused))
+#define PROF_START(v)       do { } while (0)
+#define PROF_STOP(id, v)    do { } while (0)
+#endif /* PROF_ON */
+
+#endif /* DIS_PROF_H_ */
@@ -0,0 +1,254 @@
+/*
+ * ECE 521 - Computer Design Techniques, Fall 2014
+ * Project 3 - Dynamic Instruction Scheduler
+ *
+ * This module implements the dependency matrix scheduler. Every issue queue
+ * row holds a bit vector of the producers its inst waits on. Producers are
+ * named by a column, held from dispatch till completion, so that insts in
+ * the exec list can still wake up their consumers. Wakeup is then a column
+ * clear and an inst is ready when its row is all zeroes.
+ *
+ * The matrix is stored word major: word w of all the rows is contiguous, so
+ * a column clear is a branch-free AND-NOT pass, at unit stride, over one
+ * word per row, which the compiler vectorizes. The pass also takes the
+ * cleared bit off the row's count of wait bits and notes whether it was
+ * set; a separate scan of those notes then picks the rows which are left
+ * with no wait bits. A readiness check is just a look at the row's count.
+ *
+ * Author: Aravindhan Dhanasekaran <adhanas@ncsu.edu>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "dis.h"
+#include "dis-utils.h"
+#include "dis-pipeline.h"
+#include "dis-pipeline-pri.h"
+#include "dis-sched.h"
+
+#define SCHED_WORD_BITS     64
+
+
+/*
+ * Sets up the dependency matrix for the configured S and N. The list engine
+ * needs nothing.
+ */
+bool
+dis_sched_init(struct dis_input *dis)
+{
+    uint32_t            i = 0;
+    struct dis_sched    *sched = &dis->sched;
+
+    if (!dis_sched_is_matrix(dis))
+        return TRUE;
+
+    /* A wakeup walks all the rows; keep that bounded. */
+    if (dis->s > SCHED_MATRIX_MAX_ROWS) {
+        dprint("ERROR: The matrix scheduler supports upto %u issue list "
+                "entries; use the list scheduler for larger windows.\n",
+                SCHED_MATRIX_MAX_ROWS);
+        return FALSE;
+    }
+
+    /* Producers live in the issue list or in the exec list. */
+    sched->num_rows = dis->s;
+    sched->num_cols = (dis->s + (dis->n * EXEC_LIST_FACTOR));
+    sched->num_words =
+        ((sched->num_cols + (SCHED_WORD_BITS - 1)) / SCHED_WORD_BITS);
+
+    sched->matrix = (uint64_t *) calloc((sched->num_words * sched->num_rows),
+            sizeof(*sched->matrix));
+    sched->free_rows = (uint32_t *) malloc(sched->num_rows *
+            sizeof(*sched->free_rows));
+    sched->free_cols = (uint32_t *) malloc(sched->num_cols *
+            sizeof(*sched->free_cols));
+    sched->row_node = (struct dis_inst_node **) calloc(sched->num_rows,
+            sizeof(*sched->row_node));
+    sched->num_pending = (uint32_t *) calloc(sched->num_rows,
+            sizeof(*sched->num_pending));
+    sched->woken = (uint8_t *) calloc(sched->num_rows,
+            sizeof(*sched->woken));
+    if (!sched->matrix || !sched->free_rows || !sched->free_cols ||
+            !sched->row_node || !sched->num_pending || !sched->woken) {
+        dprint("ERROR: Unable to allocate memory for the scheduler.\n");
+        goto error_exit;
+    }
+
+    /* Free lists are stacks; hand out the low rows and columns first. */
+    for (i = 0; i < sched->num_rows; ++i)
+        sched->free_rows[i] = (sched->num_rows - 1 - i);
+    sched->num_free_rows = sched->num_rows;
+
+    for (i = 0; i < sched->num_cols; ++i)
+        sched->free_cols[i] = (sched->num_cols - 1 - i);
+    sched->num_free_cols = sched->num_cols;
+    return TRUE;
+
+error_exit:
+    dis_sched_cleanup(dis);
+    return FALSE;
+}
+
+
+/* Frees the dependency matrix. */
+void
+dis_sched_cleanup(struct dis_input *dis)
+{
+    struct dis_sched *sched = &dis->sched;
+
+    free(sched->matrix);
+    free(sched->free_rows);
+    free(sched->free_cols);
+    free(sched->row_node);
+    free(sched->num_pending);
+    free(sched->woken);
+    sched->matrix = NULL;
+    sched->free_rows = sched->free_cols = NULL;
+    sched->row_node = NULL;
+    sched->num_pending = NULL;
+    sched->woken = NULL;
+    return;
+}
+
+
+/* Sets the bit of the producer of the given source reg, if still pending. */
+static inline void
+dis_sched_add_dep(struct dis_sched *sched, struct dis_inst_data *data,
+        struct dis_reg_data *sreg)
+{
+    uint32_t col = 0;
+    uint64_t bit = 0;
+    uint64_t *cell = NULL;
+
+    if (!dis_is_reg_valid(sreg->rnum) || sreg->ready)
+        return;
+
+    /* Both sources may wait on the same producer; one bit for both. */
+    col = sched->reg_col[sreg->rnum];
+    cell = &sched->matrix[((col / SCHED_WORD_BITS) * sched->num_rows) +
+        data->sched_row];
+    bit = (((uint64_t) 1) << (col % SCHED_WORD_BITS));
+    if (!(*cell & bit))
+        sched->num_pending[data->sched_row] += 1;
+    *cell |= bit;
+    return;
+}
+
+
+/*
+ * Puts a newly dispatched inst in the matrix. The source regs of the issue
+ * list node carry the RMT state before the inst renamed its dreg, so the
+ * producers are looked up before this inst takes over its dreg column.
+ */
+void
+dis_sched_insert(struct dis_input *dis, struct dis_inst_node *node)
+{
+    struct dis_sched        *sched = &dis->sched;
+    struct dis_inst_data    *data = node->data;
+
+    dis_assert(sched->num_free_rows);
+    data->sched_row = sched->free_rows[--sched->num_free_rows];
+    sched->row_node[data->sched_row] = node;
+
+    dis_sched_add_dep(sched, data, &node->sreg1);
+    dis_sched_add_dep(sched, data, &node->sreg2);
+
+    data->sched_col = SCHED_NO_COL;
+    if (dis_is_reg_valid(data->dreg)) {
+        dis_assert(sched->num_free_cols);
+        data->sched_col = sched->free_cols[--sched->num_free_cols];
+        sched->reg_col[data->dreg] = data->sched_col;
+    }
+    return;
+}
+
+
+/* Frees the issue queue row of an inst leaving for the exec list. */
+void
+dis_sched_issue(struct dis_input *dis, struct dis_inst_data *data)
+{
+    struct dis_sched *sched = &dis->sched;
+
+    dis_assert(dis_sched_is_ready(dis, data));
+    sched->free_rows[sched->num_free_rows++] = data->sched_row;
+    return;
+}
+
+
+/*
+ * Wakes up the consumers of a completed inst by clearing its column in all
+ * the rows and frees the column. Free rows are all zeroes, so only the rows
+ * of waiting insts have the bit set; those left with no pending producers
+ * go on the ready heap.
+ */
+void
+dis_sched_wakeup(struct dis_input *dis, struct dis_inst_data *data)
+{
+    uint32_t            row = 0;
+    uint32_t            num_rows = 0;
+    uint32_t            shift = 0;
+    uint64_t            hit = 0;
+    uint64_t            *cells = NULL;
+    uint32_t            *num_pending = NULL;
+    uint8_t             *woken = NULL;
+    struct dis_sched    *sched = &dis->sched;
+
+    if (SCHED_NO_COL == data->sched_col)
+        return;
+
+    cells = &sched->matrix[(data->sched_col / SCHED_WORD_BITS) *
+        sched->num_rows];
+    num_rows = sched->num_rows;
+    num_pending = sched->num_pending;
+    woken = sched->woken;
+    shift = (data->sched_col % SCHED_WORD_BITS);
+
+    /* Clear the column; no branches, so this one vectorizes. */
+    for (row = 0; row < num_rows; ++row) {
+        hit = ((cells[row] >> shift) & 1);
+        cells[row] &= ~(hit << shift);
+        num_pending[row] -= (uint32_t) hit;
+        woken[row] = (uint8_t) (hit & !num_pending[row]);
+    }
+
+    /* Then pick the rows it left with no wait bits, in row order. */
+    for (row = 0; row < num_rows; ++row) {
+        if (woken[row])
+            dis_ready_push(dis, sched->row_node[row]);
+    }
+
+    sched->free_cols[sched->num_free_cols++] = data->sched_col;
+    data->sched_col = SCHED_NO_COL;
+    return;
+}
+
+
+/* Maps an issue select policy given on the command line to its type. */
+uint8_t
+dis_select_get_type(const char *name)
+{
+    if (!strcmp(name, "oldest"))
+        return SELECT_OLDEST;
+    if (!strcmp(name, "loads-first"))
+        return SELECT_LOADS_FIRST;
+    if (!strcmp(name, "longest-latency"))
+        return SELECT_LONGEST_LATENCY;
+    if (!strcmp(name, "critical-path"))
+        return SELECT_CRITICAL_PATH;
+    return SELECT_INVALID;
+}
+
+
+/* Maps a scheduler name given on the command line to its type. */
+uint8_t
+dis_sched_get_type(const char *name)
+{
+    if (!strcmp(name, "list"))
+        return SCHED_LIST;
+    if (!strcmp(name, "matrix"))
+        return SCHED_MATRIX;
+    return SCHED_INVALID;
+}
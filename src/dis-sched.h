@@ -0,0 +1,52 @@
+/*
+ * ECE 521 - Computer Design Techniques, Fall 2014
+ * Project 3 - Dynamic Instruction Scheduler
+ *
+ * This module contains the function declarations and the inline routines of
+ * the dependency matrix scheduler, an alternative to waking up the issue
+ * list by comparing register names.
+ *
+ * Author: Aravindhan Dhanasekaran <adhanas@ncsu.edu>
+ */
+
+#ifndef DIS_SCHED_H_
+#define DIS_SCHED_H_
+
+#include "dis.h"
+
+/* Inline functions */
+/* Checks whether the given scheduler engine is in use. */
+static inline bool
+dis_sched_is_matrix(struct dis_input *dis)
+{
+    return ((SCHED_MATRIX == dis->sched.type) ? TRUE : FALSE);
+}
+
+
+/*
+ * Checks whether the inst in the given issue queue row waits on no producer
+ * (TRUE) or not (FALSE), by the count of wait bits set in the row.
+ */
+static inline bool
+dis_sched_is_ready(struct dis_input *dis, struct dis_inst_data *data)
+{
+    return (dis->sched.num_pending[data->sched_row] ? FALSE : TRUE);
+}
+
+/* Function declarations */
+bool
+dis_sched_init(struct dis_input *dis);
+void
+dis_sched_cleanup(struct dis_input *dis);
+void
+dis_sched_insert(struct dis_input *dis, struct dis_inst_node *node);
+void
+dis_sched_issue(struct dis_input *dis, struct dis_inst_data *data);
+void
+dis_sched_wakeup(struct dis_input *dis, struct dis_inst_data *data);
+uint8_t
+dis_sched_get_type(const char *name);
+uint8_t
+dis_select_get_type(const char *name);
+
+#endif /* DIS_SCHED_H_ */
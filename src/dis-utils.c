@@ -15,3 +15,56 @@
 #include <unistd.h>
 #include <sys/time.h>
 
+#include <errno.h>
+
+#include "dis.h"
+#include "dis-utils.h"
+
+/* Globals */
+const char g_dis_digit_pairs[] =        /* "00" to "99", for dis_out_u32 */
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+
+/*
+ * Sets up the output writer on the given file descriptor. Whatever stdio
+ * still holds goes out first, so the output stays in order.
+ */
+void
+dis_out_init(struct dis_out *out, int fd)
+{
+    fflush(stdout);
+    out->fd = fd;
+    out->len = 0;
+    return;
+}
+
+
+/* Writes out the buffer, in as many writes as the fd takes it in. */
+void
+dis_out_flush(struct dis_out *out)
+{
+    ssize_t     rv = 0;
+    uint32_t    done = 0;
+
+    while (done < out->len) {
+        rv = write(out->fd, (out->buf + done), (out->len - done));
+        if (rv < 0) {
+            if (EINTR == errno)
+                continue;
+            dprint_err("write failed, errno %d\n", errno);
+            break;
+        }
+        done += rv;
+    }
+    out->len = 0;
+    return;
+}
@@ -12,9 +12,13 @@
 #define DIS_UTILS_H
 
 #include <assert.h>
+#include <string.h>
 
 #include "dis.h"
 
+#define DIS_OUT_BUF_SIZE        (256 * 1024)    /* output writer buffer */
+#define DIS_OUT_LINE_MAX        256     /* room reserved per line       */
+
 #define dprint(str, ...) printf(str, ##__VA_ARGS__)
 #ifdef DBG_ON
 #define dprint_dbg(str, ...)    printf(str, ##__VA_ARGS__)
@@ -40,5 +44,89 @@
 #define dis_assert(cond)
 #endif /* DBG_ON */
 
+/*
+ * Buffered output writer, for the bulk of the output. Lines are formatted
+ * straight into the buffer, which goes out with a single write once full.
+ * The callers reserve room for a line first, so the put routines need no
+ * bounds checks.
+ */
+struct dis_out {
+    int         fd;                 /* file descriptor to write to  */
+    uint32_t    len;                /* bytes in the buffer          */
+    char        buf[DIS_OUT_BUF_SIZE];
+};
+
+/* Externs */
+extern const char g_dis_digit_pairs[];
+
+/* Function declarations */
+void
+dis_out_init(struct dis_out *out, int fd);
+void
+dis_out_flush(struct dis_out *out);
+
+/* Inline functions */
+/* Makes sure the buffer has room for the given # of bytes. */
+static inline void
+dis_out_reserve(struct dis_out *out, uint32_t size)
+{
+    if ((out->len + size) > DIS_OUT_BUF_SIZE)
+        dis_out_flush(out);
+    return;
+}
+
+
+/* Puts the given chars in the buffer. */
+static inline void
+dis_out_mem(struct dis_out *out, const char *str, uint32_t len)
+{
+    memcpy(out->buf + out->len, str, len);
+    out->len += len;
+    return;
+}
+
+/* Puts a string literal in the buffer; its length is known at build time. */
+#define dis_out_lit(out, lit)   dis_out_mem((out), (lit), (sizeof(lit) - 1))
+
+
+/* Puts the given unsigned int in the buffer, in decimal; same as %u. */
+static inline void
+dis_out_u32(struct dis_out *out, uint32_t val)
+{
+    char        tmp[10];
+    char        *pos = (tmp + sizeof(tmp));
+    uint32_t    pair = 0;
+
+    /* Two digits at a time, from the least significant end. */
+    while (val >= 100) {
+        pair = ((val % 100) * 2);
+        val /= 100;
+        *--pos = g_dis_digit_pairs[pair + 1];
+        *--pos = g_dis_digit_pairs[pair];
+    }
+    if (val >= 10) {
+        *--pos = g_dis_digit_pairs[(val * 2) + 1];
+        *--pos = g_dis_digit_pairs[val * 2];
+    } else {
+        *--pos = ('0' + val);
+    }
+    dis_out_mem(out, pos, ((tmp + sizeof(tmp)) - pos));
+    return;
+}
+
+
+/* Puts the given signed int in the buffer, in decimal; same as %d. */
+static inline void
+dis_out_i32(struct dis_out *out, int32_t val)
+{
+    if (val < 0) {
+        out->buf[out->len++] = '-';
+        dis_out_u32(out, (0U - (uint32_t) val));
+        return;
+    }
+    dis_out_u32(out, (uint32_t) val);
+    return;
+}
+
 #endif /* DIS_UTILS_H */
 
@@ -11,12 +11,25 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <getopt.h>
 
 #include "dis.h"
 #include "dis-utils.h"
 #include "dis-cache.h"
+#include "dis-cache-mshr.h"
+#include "dis-cache-snapshot.h"
+#include "dis-cache-config.h"
+#include "dis-cache-prefetch.h"
+#include "dis-cache-utils.h"
 #include "dis-print.h"
 #include "dis-pipeline.h"
+#include "dis-sched.h"
+#include "dis-dataflow.h"
+#include "dis-occupancy.h"
+#include "dis-prof.h"
+#include "dis-perf.h"
+#include "dis-cyclelog.h"
+#include "dis-lockstep.h"
 #include "utlist.h"
 
 /* Globals */
@@ -25,6 +38,64 @@ uint32_t            g_cycle_num;        /* current cycle #          */
 FILE                *g_trace_fptr;      /* tracefile ptr            */
 struct dis_input    g_dis;              /* global dis data          */
 
+/* Optional command line switches; these may appear anywhere on the line. */
+enum dis_opt__ {
+    DIS_OPT_MSHR = 256,
+    DIS_OPT_FILL_INTERVAL,
+    DIS_OPT_VICTIM,
+    DIS_OPT_TAG_INDEX,
+    DIS_OPT_SNAPSHOT_SAVE,
+    DIS_OPT_SNAPSHOT_AT,
+    DIS_OPT_SNAPSHOT_LOAD,
+    DIS_OPT_CACHE_CONFIG,
+    DIS_OPT_SET_SAMPLE,
+    DIS_OPT_PREFETCH,
+    DIS_OPT_LSQ,
+    DIS_OPT_ADDR_BITS,
+    DIS_OPT_DUMP_ORDER,
+    DIS_OPT_DUMP_BIN,
+    DIS_OPT_SCHED,
+    DIS_OPT_GENERIC_KERNEL,
+    DIS_OPT_DATAFLOW,
+    DIS_OPT_FU,
+    DIS_OPT_SELECT,
+    DIS_OPT_STALL_STATS,
+    DIS_OPT_OCCUPANCY,
+    DIS_OPT_OCCUPANCY_SERIES,
+    DIS_OPT_PERF_COUNTERS,
+    DIS_OPT_ENGINE,
+    DIS_OPT_CYCLE_LOG
+};
+
+static struct option g_dis_opts[] = {
+    {"mshr",            required_argument,  NULL,   DIS_OPT_MSHR},
+    {"fill-interval",   required_argument,  NULL,   DIS_OPT_FILL_INTERVAL},
+    {"victim",          required_argument,  NULL,   DIS_OPT_VICTIM},
+    {"tag-index",       no_argument,        NULL,   DIS_OPT_TAG_INDEX},
+    {"snapshot-save",   required_argument,  NULL,   DIS_OPT_SNAPSHOT_SAVE},
+    {"snapshot-at",     required_argument,  NULL,   DIS_OPT_SNAPSHOT_AT},
+    {"snapshot-load",   required_argument,  NULL,   DIS_OPT_SNAPSHOT_LOAD},
+    {"cache-config",    required_argument,  NULL,   DIS_OPT_CACHE_CONFIG},
+    {"set-sample",      required_argument,  NULL,   DIS_OPT_SET_SAMPLE},
+    {"prefetch",        required_argument,  NULL,   DIS_OPT_PREFETCH},
+    {"lsq",             required_argument,  NULL,   DIS_OPT_LSQ},
+    {"addr-bits",       required_argument,  NULL,   DIS_OPT_ADDR_BITS},
+    {"dump-order",      required_argument,  NULL,   DIS_OPT_DUMP_ORDER},
+    {"dump-bin",        required_argument,  NULL,   DIS_OPT_DUMP_BIN},
+    {"sched",           required_argument,  NULL,   DIS_OPT_SCHED},
+    {"generic-kernel",  no_argument,        NULL,   DIS_OPT_GENERIC_KERNEL},
+    {"dataflow",        no_argument,        NULL,   DIS_OPT_DATAFLOW},
+    {"fu",              required_argument,  NULL,   DIS_OPT_FU},
+    {"select",          required_argument,  NULL,   DIS_OPT_SELECT},
+    {"stall-stats",     no_argument,        NULL,   DIS_OPT_STALL_STATS},
+    {"occupancy",       no_argument,        NULL,   DIS_OPT_OCCUPANCY},
+    {"occupancy-series", required_argument, NULL,   DIS_OPT_OCCUPANCY_SERIES},
+    {"perf-counters",   no_argument,        NULL,   DIS_OPT_PERF_COUNTERS},
+    {"engine",          required_argument,  NULL,   DIS_OPT_ENGINE},
+    {"cycle-log",       required_argument,  NULL,   DIS_OPT_CYCLE_LOG},
+    {NULL,              0,                  NULL,   0}
+};
+
 
 /*
  * DIS init routine. Called during startup. Allocate memory for required data 
@@ -33,8 +104,6 @@ struct dis_input    g_dis;              /* global dis data          */
 static void
 dis_init(struct dis_input *dis)
 {
-    uint16_t i = 0;
-
     if (!dis) {
         dis_assert(0);
         goto exit;
@@ -43,18 +112,7 @@ dis_init(struct dis_input *dis)
     g_inst_num = 0;
     g_cycle_num = 0;
     dis->l1 = &g_l1_cache;
-    dis->l2 = &g_l2_cache;
-
-    /* Allocate memory for rmt and set the ready bit for all regs. */
-    for (i = 0; i < REG_TOTAL; ++i) {
-        dis->rmt[i] = (struct dis_reg_data *) calloc(1, sizeof(*dis->rmt[i]));
-        dis->rmt[i]->rnum = i;
-        dis->rmt[i]->ready = TRUE;
-    }
-    dis->rmt[REG_TOTAL] = (struct dis_reg_data *)
-        calloc(1, sizeof(*dis->rmt[REG_TOTAL]));
-    dis->rmt[i]->rnum = REG_TOTAL;
-    dis->rmt[i]->ready = FALSE;
+    dis->vc = &g_vic_cache;
 
     /* Allocate memory for all the lists. */
     dis->list_inst = (struct dis_inst_list *)
@@ -64,6 +122,7 @@ dis_init(struct dis_input *dis)
     dis->list_issue = (struct dis_list *) calloc(1, sizeof(*dis->list_issue));
     dis->list_exec = (struct dis_list *) calloc(1, sizeof(*dis->list_exec));
     dis->list_wback = (struct dis_list *) calloc(1, sizeof(*dis->list_wback));
+    dis->list_lsq = (struct dis_list *) calloc(1, sizeof(*dis->list_lsq));
 
 exit:
     return;
@@ -72,14 +131,26 @@ exit:
 
 /*
  * DIS cleanup code. Usually called in exit path. Free all memory allocated
- * for various lists, RMT and caches.
+ * for various lists, register names and caches.
  */
 static void
 dis_cleanup(struct dis_input *dis)
 {
-    uint16_t                i = 0;
     struct dis_inst_node    *iter = NULL;
     struct dis_inst_node    *tmp = NULL;
+    cache_generic_t         *cache = NULL;
+    cache_generic_t         *next_cache = NULL;
+
+    /* The lock-step shadow first, with its globals swapped in. */
+    if (dis->lockstep.ref) {
+        dis_lockstep_swap(dis);
+        dis_cleanup(dis->lockstep.ref);
+        dis_lockstep_swap(dis);
+        free(dis->lockstep.ref);
+        free(dis->lockstep.caches);
+        dis->lockstep.ref = NULL;
+        dis->lockstep.caches = NULL;
+    }
 
     /* Close the trace file pointer. */
     if (g_trace_fptr) {
@@ -87,22 +158,21 @@ dis_cleanup(struct dis_input *dis)
         g_trace_fptr = NULL;
     }
 
-    /* Free cache and tagstores. */
+    /* Free cache and tagstores, from L1 outwards. */
     if (dis->l1) {
-        if (dis->l2) {
-            cache_cleanup(dis->l2);
-            dis->l2 = NULL;
+        cache_batch_cleanup(&dis->mem_batch);
+        for (cache = dis->l1; cache; cache = next_cache) {
+            next_cache = cache->next_cache;
+            cache_cleanup(cache);
         }
-
-        cache_cleanup(dis->l1);
-        dis->l1 = NULL;
+        dis->l1 = dis->vc = NULL;
     }
 
-    /* Free the RMT table. */
-    for (i = 0; i <= REG_TOTAL; ++i) {
-        free(dis->rmt[i]);
-        dis->rmt[i] = NULL;
-    }
+    dis_cyclelog_cleanup(dis);
+    dis_occupancy_cleanup(dis);
+    dis_fu_cleanup(dis);
+    dis_sched_cleanup(dis);
+    dis_prf_cleanup(dis);
 
     /* Free various lists. */
     if (dis->list_disp) {
@@ -137,6 +207,14 @@ dis_cleanup(struct dis_input *dis)
         dis->list_wback = NULL;
     }
 
+    if (dis->list_lsq) {
+        DL_FOREACH_SAFE(dis->list_lsq->list, iter, tmp)
+            free(iter);
+        iter = tmp = NULL;
+        free(dis->list_lsq);
+        dis->list_lsq = NULL;
+    }
+
     if (dis->list_inst) {
         DL_FOREACH_SAFE(dis->list_inst->list, iter, tmp) {
             free(iter->data);
@@ -151,14 +229,29 @@ dis_cleanup(struct dis_input *dis)
 }
 
 
+/*
+ * Save the current cache state to the snapshot file. Only one snapshot is
+ * taken per run.
+ */
+static void
+dis_save_snapshot(struct dis_input *dis)
+{
+    dis->snapshot_done = TRUE;
+    cache_snapshot_save(dis->l1, dis->snapshot_save,
+            dis_inst_list_get_len(dis, LIST_WBACK));
+    return;
+}
+
+
 /*
  * Parse the given trace file and feed instructions to the pipeline.
  */
 static bool
 dis_parse_tracefile(struct dis_input *dis)
 {
-    bool    trace_done = FALSE;
-    char    *trace_fpath = NULL;
+    bool            trace_done = FALSE;
+    char            *trace_fpath = NULL;
+    dis_cycle_fn_t  cycle_fn = NULL;
 
     if (!dis) {
         dis_assert(0);
@@ -173,30 +266,50 @@ dis_parse_tracefile(struct dis_input *dis)
         goto error_exit;
     }
 
+    /* Measure the simulator itself from here on, if asked for. */
+    if (dis->perf.on)
+        dis_perf_start(dis);
+
+    /* The dataflow limit needs no pipeline at all. */
+    if (dis->dataflow.on) {
+        dis_dataflow_run(dis);
+        goto done;
+    }
+
+    /* The insts print as they retire. */
+    dis_print_inst_init(dis);
+
+    /* A cycle kernel specialized for S and N, if there is one. */
+    if (ENGINE_REF == dis->engine)
+        cycle_fn = dis_cycle_ref;
+    else if (dis->generic_kernel)
+        cycle_fn = dis_cycle_generic;
+    else
+        cycle_fn = dis_get_cycle_kernel(dis);
+
     do {
         dprint_dbg("\n\n");
         dprint_dbg("curr cycle %u\n", dis_get_cycle_num());
         dprint_dbg("--------------\n");
 
-        /* Retire stage. */
-        dis_retire(dis);
+        /* Retire, execute, issue, dispatch and fetch stages. */
+        trace_done = cycle_fn(dis, trace_done);
 
-        /* Execute stage. */
-        dis_execute(dis);
+        /* Run the reference engine thru the same cycle, and compare. */
+        if (dis->lockstep.ref)
+            dis_lockstep_cycle(dis);
 
-        /* Issue stage. */
-        dis_issue(dis);
+        if (dis->occupancy.on)
+            dis_occupancy_sample(dis);
 
-        /* Dispatch stage. */
-        dis_dispatch(dis);
+        if (dis->cyclelog.fptr)
+            dis_cyclelog_cycle(dis);
 
-        /* Fetch stage. */
-        if (!trace_done && !dis_fetch(dis)) {
-            /* Done fetching all the insts from the trace file. No more
-             * fetch stages. The tracefile will be closed as part of cleanup.
-             */
-            trace_done = TRUE;
-        }
+        /* Save the warm cache state once enough insts are done. */
+        if (dis->snapshot_save[0] && dis->snapshot_at &&
+                !dis->snapshot_done &&
+                (dis_inst_list_get_len(dis, LIST_WBACK) >= dis->snapshot_at))
+            dis_save_snapshot(dis);
 
 #ifdef DBG_ON
         /* Print all inst fetched so far. */
@@ -205,20 +318,49 @@ dis_parse_tracefile(struct dis_input *dis)
         dis_print_list(dis, LIST_ISSUE);
         dis_print_list(dis, LIST_EXEC);
         dis_print_list(dis, LIST_WBACK);
+        dis_print_list(dis, LIST_LSQ);
 #endif /* DBG_ON */
     } while (dis_run_cycle(dis));
 
+    /* The insts done in the last cycle are still to retire. */
+    dis_retire(dis);
+
 #ifdef DBG_ON
     dis_print_rmt(dis, REG_INVALID_VALUE);
 #endif /* DBG_ON */
 
+    if (dis->occupancy.on)
+        dis_occupancy_finish(dis);
+
+done:
+    if (dis->perf.on)
+        dis_perf_stop(dis);
+
+    /* No (or an unreached) snapshot point; save the final cache state. */
+    if (dis->snapshot_save[0] && !dis->snapshot_done)
+        dis_save_snapshot(dis);
+
+    /* Final cache contents, for diffing offline. */
+    if (dis->dump_bin[0])
+        cache_snapshot_dump(dis->l1, dis->dump_bin);
+
     /* Done with all the inst execution. Print the stats and be gone. */
 #ifndef GRAPH_ON
-    dis_print_inst_stats(dis);
+    if (dis->dataflow.on)
+        dis_print_dataflow_stats(dis);
+    else
+        dis_print_inst_stats(dis);
 #else
     dis_print_inst_graph_data(dis);
 #endif /* GRAPH_ON */
 
+#ifdef PROF_ON
+    dis_prof_print(dis);
+#endif /* PROF_ON */
+
+    if (dis->perf.on)
+        dis_perf_print(dis);
+
     return TRUE;
 
 error_exit:
@@ -226,6 +368,290 @@ error_exit:
 }
 
 
+/*
+ * Parse the optional command line switches and store them in the global dis
+ * data structure. On return, argv[optind] is the first positional argument.
+ */
+static bool
+dis_parse_options(int argc, char **argv, struct dis_input *dis)
+{
+    int         opt = 0;
+    uint32_t    level = 0;
+    uint32_t    degree = 0;
+    uint32_t    bits = 0;
+    uint32_t    type = 0;
+    uint32_t    count = 0;
+    uint32_t    latency = 0;
+    uint32_t    ii = 0;
+    char        name[MAX_FILE_NAME_LEN + 1];
+
+    while (-1 != (opt = getopt_long(argc, argv, "", g_dis_opts, NULL))) {
+        switch (opt) {
+        case DIS_OPT_MSHR:
+            dis->mshr_size = atoi(optarg);
+            if (dis->mshr_size > CACHE_MSHR_MAX_ENTRIES) {
+                dprint("ERROR: Too many MSHRs %u, max %u.\n",
+                        dis->mshr_size, CACHE_MSHR_MAX_ENTRIES);
+                goto error_exit;
+            }
+            break;
+
+        case DIS_OPT_FILL_INTERVAL:
+            dis->fill_interval = atoi(optarg);
+            if (dis->fill_interval > CACHE_MSHR_MAX_FILL_INTERVAL) {
+                dprint("ERROR: Fill interval %u too long, max %u.\n",
+                        dis->fill_interval, CACHE_MSHR_MAX_FILL_INTERVAL);
+                goto error_exit;
+            }
+            break;
+
+        case DIS_OPT_VICTIM:
+            dis->victim_size = atoi(optarg);
+            break;
+
+        case DIS_OPT_TAG_INDEX:
+            g_tag_index_present = TRUE;
+            break;
+
+        case DIS_OPT_SNAPSHOT_SAVE:
+            strncpy(dis->snapshot_save, optarg, MAX_FILE_NAME_LEN);
+            break;
+
+        case DIS_OPT_SNAPSHOT_AT:
+            dis->snapshot_at = atoi(optarg);
+            break;
+
+        case DIS_OPT_SNAPSHOT_LOAD:
+            strncpy(dis->snapshot_load, optarg, MAX_FILE_NAME_LEN);
+            break;
+
+        case DIS_OPT_CACHE_CONFIG:
+            strncpy(dis->cache_config, optarg, MAX_FILE_NAME_LEN);
+            break;
+
+        case DIS_OPT_SET_SAMPLE:
+            dis->set_sample = atoi(optarg);
+            if (!util_is_power_of_2(dis->set_sample)) {
+                dprint("ERROR: Set sample ratio %s is not a power of 2.\n",
+                        optarg);
+                goto error_exit;
+            }
+            break;
+
+        case DIS_OPT_PREFETCH:
+            /* <level>:<type>[:<degree>], once per cache level */
+            degree = CACHE_PF_DEFAULT_DEGREE;
+            if ((2 > sscanf(optarg, "%u:%255[^:]:%u", &level, name,
+                            &degree)) || (!level) ||
+                    (level > CACHE_MAX_LEVELS) || (!degree) ||
+                    (degree > CACHE_PF_MAX_DEGREE) ||
+                    (CACHE_PF_NONE == cache_prefetch_get_type(name))) {
+                dprint("ERROR: Bad prefetcher %s.\n", optarg);
+                goto error_exit;
+            }
+            dis->pf_type[level - 1] = cache_prefetch_get_type(name);
+            dis->pf_degree[level - 1] = degree;
+            break;
+
+        case DIS_OPT_LSQ:
+            dis->lsq_size = atoi(optarg);
+            if (!dis->lsq_size) {
+                dprint("ERROR: LSQ needs at least 1 entry.\n");
+                goto error_exit;
+            }
+            break;
+
+        case DIS_OPT_ADDR_BITS:
+            bits = atoi(optarg);
+            if ((bits < CACHE_ADDR_MIN_BITS) ||
+                    (bits > CACHE_ADDR_MAX_BITS)) {
+                dprint("ERROR: Address bits %s not in [%u, %u].\n", optarg,
+                        CACHE_ADDR_MIN_BITS, CACHE_ADDR_MAX_BITS);
+                goto error_exit;
+            }
+            dis->addr_bits = bits;
+            break;
+
+        case DIS_OPT_DUMP_ORDER:
+            if (!strcmp(optarg, "way")) {
+                g_cache_dump_order = CACHE_DUMP_ORDER_WAY;
+            } else if (!strcmp(optarg, "mru")) {
+                g_cache_dump_order = CACHE_DUMP_ORDER_MRU;
+            } else {
+                dprint("ERROR: Bad cache dump order %s.\n", optarg);
+                goto error_exit;
+            }
+            break;
+
+        case DIS_OPT_DUMP_BIN:
+            strncpy(dis->dump_bin, optarg, MAX_FILE_NAME_LEN);
+            break;
+
+        case DIS_OPT_SCHED:
+            dis->sched.type = dis_sched_get_type(optarg);
+            if (SCHED_INVALID == dis->sched.type) {
+                dprint("ERROR: Bad scheduler %s.\n", optarg);
+                goto error_exit;
+            }
+            break;
+
+        case DIS_OPT_SELECT:
+            dis->select = dis_select_get_type(optarg);
+            if (SELECT_INVALID == dis->select) {
+                dprint("ERROR: Bad select policy %s.\n", optarg);
+                goto error_exit;
+            }
+            break;
+
+        case DIS_OPT_STALL_STATS:
+            dis->stalls.on = TRUE;
+            break;
+
+        case DIS_OPT_OCCUPANCY:
+            dis->occupancy.on = TRUE;
+            break;
+
+        case DIS_OPT_OCCUPANCY_SERIES:
+            /* <file>[:<interval>] */
+            dis->occupancy.on = TRUE;
+            dis->occupancy.interval = OCC_DEFAULT_INTERVAL;
+            if ((1 > sscanf(optarg, "%255[^:]:%u",
+                            dis->occupancy.series_path,
+                            &dis->occupancy.interval)) ||
+                    (!dis->occupancy.interval)) {
+                dprint("ERROR: Bad occupancy series %s.\n", optarg);
+                goto error_exit;
+            }
+            break;
+
+        case DIS_OPT_PERF_COUNTERS:
+            dis->perf.on = TRUE;
+            break;
+
+        case DIS_OPT_ENGINE:
+            dis->engine = dis_engine_get_type(optarg);
+            if (ENGINE_INVALID == dis->engine) {
+                dprint("ERROR: Bad pipeline engine %s.\n", optarg);
+                goto error_exit;
+            }
+            break;
+
+        case DIS_OPT_CYCLE_LOG:
+            strncpy(dis->cyclelog.path, optarg, MAX_FILE_NAME_LEN);
+            break;
+
+        case DIS_OPT_GENERIC_KERNEL:
+            dis->generic_kernel = TRUE;
+            break;
+
+        case DIS_OPT_DATAFLOW:
+            dis->dataflow.on = TRUE;
+            break;
+
+        case DIS_OPT_FU:
+            /* <type>:<count>[:<latency>[:<ii>]], once per inst type */
+            latency = 0;
+            ii = 1;
+            if ((2 > sscanf(optarg, "%u:%u:%u:%u", &type, &count, &latency,
+                            &ii)) || (type >= TYPE_MAX) ||
+                    (count > FU_MAX_UNITS) ||
+                    (latency > FU_MAX_LATENCY) || (!ii)) {
+                dprint("ERROR: Bad functional unit pool %s.\n", optarg);
+                goto error_exit;
+            }
+            dis->fu[type].count = count;
+            dis->fu[type].latency = latency;
+            dis->fu[type].ii = ii;
+            break;
+
+        default:
+            goto error_exit;
+        }
+    }
+    return TRUE;
+
+error_exit:
+    return FALSE;
+}
+
+
+/*
+ * Sets up the reference engine shadow of a lock-step run, on the same
+ * configuration but with pipeline state, a trace file pointer and caches
+ * of its own. The main engine's globals are put aside while the shadow's
+ * are set up.
+ */
+static bool
+dis_lockstep_setup(struct dis_input *dis, const cache_config_t *config)
+{
+    bool                rv = TRUE;
+    uint32_t            type = 0;
+    struct dis_input    *ref = NULL;
+    cache_ctx_t         *caches = NULL;
+
+    if (dis->dataflow.on) {
+        dprint("ERROR: The dataflow limit mode has no pipeline to run in "
+                "lock-step.\n");
+        goto error_exit;
+    }
+
+    ref = (struct dis_input *) calloc(1, sizeof(*ref));
+    caches = (cache_ctx_t *) malloc(sizeof(*caches));
+    if (!ref || !caches) {
+        dprint("ERROR: Unable to allocate memory for the lock-step "
+                "engine.\n");
+        free(ref);
+        free(caches);
+        goto error_exit;
+    }
+    cache_ctx_init(caches);
+    dis->lockstep.ref = ref;
+    dis->lockstep.caches = caches;
+
+    ref->s = dis->s;
+    ref->n = dis->n;
+    ref->lsq_size = dis->lsq_size;
+    ref->addr_bits = dis->addr_bits;
+    ref->select = dis->select;
+    ref->engine = ENGINE_REF;
+    ref->stalls.on = dis->stalls.on;
+    ref->lockstep.shadow = TRUE;
+    memcpy(ref->tracefile, dis->tracefile, sizeof(ref->tracefile));
+    for (type = 0; type < TYPE_MAX; ++type) {
+        ref->fu[type].count = dis->fu[type].count;
+        ref->fu[type].latency = dis->fu[type].latency;
+        ref->fu[type].ii = dis->fu[type].ii;
+    }
+
+    dis_init(ref);
+    ref->l1 = ref->vc = NULL;
+    if (!dis_prf_init(ref) || !dis_fu_init(ref))
+        goto error_exit;
+
+    dis_lockstep_swap(dis);
+    g_trace_fptr = fopen(ref->tracefile, "r");
+    if (!g_trace_fptr) {
+        dprint("ERROR: Unable to open trace file %s.\n", ref->tracefile);
+        rv = FALSE;
+    } else if (dis->l1) {
+        cache_init(config);
+        ref->l1 = cache_util_get_l1();
+        ref->vc = (cache_util_is_victim_present() ?
+                cache_util_get_vc() : NULL);
+        if (dis->mshr_size)
+            cache_mshr_init(ref->l1, dis->mshr_size, dis->fill_interval);
+        if (dis->snapshot_load[0] &&
+                !cache_snapshot_restore(ref->l1, dis->snapshot_load))
+            rv = FALSE;
+    }
+    dis_lockstep_swap(dis);
+    return rv;
+
+error_exit:
+    return FALSE;
+}
+
+
 /*
  * Parse and validate the given input parameters. If good, store them
  * in the global dis data structure.
@@ -233,55 +659,140 @@ error_exit:
 static bool
 dis_parse_input(int argc, char **argv, struct dis_input *dis)
 {
-    uint8_t     arg_iter = 0;
-    uint32_t    blk_size = 0;
-    uint32_t    l1_cache_size = 0;
-    uint32_t    l1_set_assoc = 0;
-    uint32_t    l2_cache_size = 0;
-    uint32_t    l2_set_assoc = 0;
+    uint8_t         arg_iter = 0;
+    uint32_t        iter = 0;
+    uint32_t        num_params = 0;
+    cache_config_t  config;
 
     if (!dis) { 
         dis_assert(0);
         goto error_exit;
     }
     
-    if (!dis->l1 || !dis->l2) {
-        dis_assert(0);
+    if (!dis_parse_options(argc, argv, dis)) {
+        dis_print_usage(argv[0]);
         goto error_exit;
     }
 
-    if (DS_NUM_INPUT_PARAMS != (argc - 1)) {
+    /* With a cache config file, the caches are not on the command line. */
+    num_params = (dis->cache_config[0] ?
+            DS_NUM_CONFIG_INPUT_PARAMS : DS_NUM_INPUT_PARAMS);
+    if (num_params != (argc - optind)) {
         dprint("ERROR: Bad number of input arguments, req %u, curr %u.\n",
-                DS_NUM_INPUT_PARAMS, (argc - 1));
+                num_params, (argc - optind));
+        dis_print_usage(argv[0]);
         goto error_exit;
     }
 
     /* Input arguments are of the form:
      * sim <S> <N> <BLOCKSIZE> <L1_size> <L1_ASSOC> 
      *                         <L2_SIZE> <L2_ASSOC> <tracefile>
+     * or, with a cache config file:
+     * sim <S> <N> <tracefile>
      */
+    arg_iter = (optind - 1);
     dis->s = atoi(argv[++arg_iter]);
     dis->n = atoi(argv[++arg_iter]);
 
-    blk_size = atoi(argv[++arg_iter]);
-    l1_cache_size = atoi(argv[++arg_iter]);
-    l1_set_assoc = atoi(argv[++arg_iter]);
-    l2_cache_size = atoi(argv[++arg_iter]);
-    l2_set_assoc = atoi(argv[++arg_iter]);
+    /* The per stage structures are sized off S and N. */
+    if (!dis->s || (dis->s > DIS_MAX_S)) {
+        dprint("ERROR: Bad S %s, has to be in [1, %u].\n",
+                argv[arg_iter - 1], DIS_MAX_S);
+        goto error_exit;
+    }
+    if (!dis->n || (dis->n > DIS_MAX_N)) {
+        dprint("ERROR: Bad N %s, has to be in [1, %u].\n",
+                argv[arg_iter], DIS_MAX_N);
+        goto error_exit;
+    }
+
+    /* The reference engine has its own wakeup, by tag compare. */
+    if (ENGINE_REF == dis->engine)
+        dis->sched.type = SCHED_LIST;
+
+    /* Register names and the issue queue wakeup engine. */
+    if (!dis_prf_init(dis) || !dis_sched_init(dis) || !dis_fu_init(dis) ||
+            !dis_occupancy_init(dis) || !dis_cyclelog_init(dis))
+        goto error_exit;
+
+    /* By default, the LSQ never holds up dispatch. */
+    if (!dis->lsq_size)
+        dis->lsq_size = (dis->s + (dis->n * EXEC_LIST_FACTOR));
 
-    if (blk_size) {
-        cache_init(dis->l1, NULL, dis->l2, argc, argv + 3);
-        cache_tagstore_init(dis->l1, &g_l1_cache_ts);
+    if (dis->cache_config[0]) {
+        if (!cache_config_parse_file(&config, dis->cache_config))
+            goto error_exit;
 
-        if (l2_cache_size)
-            cache_tagstore_init(dis->l2, &g_l2_cache_ts);
-        else
-            dis->l2 = NULL;
+        /* --victim overrides the victim cache of the config file. */
+        if (dis->victim_size)
+            config.victim_size = dis->victim_size;
+        config.trace_file = argv[arg_iter + 1];
     } else {
-        dis->l1 = dis->l2 = NULL;
+        cache_config_from_args(&config, dis->victim_size,
+                argv + optind + 2);
+        arg_iter += 5;
+    }
+
+    config.set_sample = dis->set_sample;
+
+    /* --addr-bits overrides the config file; wider trace addresses fail. */
+    if (dis->addr_bits)
+        config.addr_bits = dis->addr_bits;
+    dis->addr_bits = config.addr_bits;
+
+    /* --prefetch overrides the prefetchers of the config file. */
+    for (iter = 0; iter < CACHE_MAX_LEVELS; ++iter) {
+        if (CACHE_PF_NONE == dis->pf_type[iter])
+            continue;
+        config.levels[iter].pf_type = dis->pf_type[iter];
+        config.levels[iter].pf_degree = dis->pf_degree[iter];
+    }
+
+    if (config.num_levels) {
+        if (!cache_config_validate(&config))
+            goto error_exit;
+
+        cache_init(&config);
+        dis->l1 = cache_util_get_l1();
+        dis->vc = (cache_util_is_victim_present() ?
+                cache_util_get_vc() : NULL);
+        dis->victim_size = config.victim_size;
+
+        /* Make L1 non-blocking, if asked for; MSHRs need the cycle loop. */
+        if (dis->mshr_size && dis->dataflow.on) {
+            dprint("ERROR: The dataflow limit mode needs a blocking L1.\n");
+            goto error_exit;
+        }
+        if (dis->mshr_size)
+            cache_mshr_init(dis->l1, dis->mshr_size, dis->fill_interval);
+
+        /* All the insts in the exec list may look up L1 in a cycle. */
+        cache_batch_init(&dis->mem_batch, (dis->n * EXEC_LIST_FACTOR));
+
+        /* Start with warm caches, if asked for. */
+        if (dis->snapshot_load[0] &&
+                !cache_snapshot_restore(dis->l1, dis->snapshot_load))
+            goto error_exit;
+    } else {
+        dis->l1 = dis->vc = NULL;
+
+        if (dis->snapshot_save[0] || dis->snapshot_load[0]) {
+            dprint("ERROR: Cache snapshots need caches to be enabled.\n");
+            goto error_exit;
+        }
+
+        if (dis->dump_bin[0]) {
+            dprint("ERROR: Cache dumps need caches to be enabled.\n");
+            goto error_exit;
+        }
     }
 
     strncpy(dis->tracefile, argv[++arg_iter], MAX_FILE_NAME_LEN);
+
+    /* Check the fast engine against the reference one, if asked for. */
+    if ((ENGINE_LOCKSTEP == dis->engine) &&
+            !dis_lockstep_setup(dis, &config))
+        goto error_exit;
     return TRUE;
 
 error_exit:
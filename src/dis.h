@@ -12,11 +12,13 @@
 #define DIS_H_
 
 #include <stdint.h>
+#include <inttypes.h>
 
 #include "dis-cache.h"
 
 /* Constants */
 #define DS_NUM_INPUT_PARAMS     8
+#define DS_NUM_CONFIG_INPUT_PARAMS  3   /* S, N and tracefile */
 #define MAX_FILE_NAME_LEN       255
 
 #define REG_TOTAL               128
@@ -30,6 +32,71 @@
 #define LIST_ISSUE              2
 #define LIST_EXEC               3
 #define LIST_WBACK              4
+#define LIST_LSQ                5
+
+#define EXEC_LIST_FACTOR        5       /* exec list holds up to 5*N insts */
+#define DIS_MAX_S               (1 << 20)   /* issue list entries, at most */
+#define DIS_MAX_N               (1 << 16)   /* pipeline width, at most  */
+#define EXEC_WHEEL_SIZE         256     /* completion wheel slots, 2^k  */
+
+#define TRACE_LINE_LEN          256     /* max length of a trace line   */
+#define LSQ_FWD_LATENCY         1       /* store-to-load forwarding, 1c */
+#define LSQ_WORD_MASK           (~((mem_addr_t) 0x3))   /* per 4B word  */
+
+#define RMT_READY_BIT           0x80000000  /* RMT entry: ready | name  */
+#define RMT_NAME_MASK           0x7fffffff
+#define RMT_ALIGN               64          /* cache line               */
+#define PRF_EXTRA_REGS          1       /* new name taken before old freed */
+
+#define SCHED_LIST              0       /* wakeup by name compare       */
+#define SCHED_MATRIX            1       /* dependency matrix            */
+#define SCHED_INVALID           0xff
+#define SCHED_NO_COL            0xffffffff
+#define SCHED_MATRIX_MAX_ROWS   4096    /* S * (S + 5N) bits, at most   */
+
+#define SELECT_OLDEST           0       /* issue policies, by inst num  */
+#define SELECT_LOADS_FIRST      1       /* loads, then the rest         */
+#define SELECT_LONGEST_LATENCY  2       /* by type latency              */
+#define SELECT_CRITICAL_PATH    3       /* by # of dependent insts      */
+#define SELECT_INVALID          0xff
+
+#define ENGINE_FAST             0       /* ready heap, completion wheel */
+#define ENGINE_REF              1       /* list walks, to diff against  */
+#define ENGINE_LOCKSTEP         2       /* fast, checked against ref    */
+#define ENGINE_INVALID          0xff
+
+#define STALL_STAGE_FETCH       0       /* stages with N slots a cycle  */
+#define STALL_STAGE_DISPATCH    1
+#define STALL_STAGE_ISSUE       2
+#define STALL_STAGE_MAX         3
+
+#define STALL_USED              0       /* slot used, no stall          */
+#define STALL_DISP_FULL         1       /* dispatch queue full          */
+#define STALL_SCHED_FULL        2       /* issue queue (S) full         */
+#define STALL_LSQ_FULL          3       /* LSQ full                     */
+#define STALL_OPERANDS          4       /* waiting on operands          */
+#define STALL_EXEC_FULL         5       /* exec list full               */
+#define STALL_STRUCTURAL        6       /* no free FU, or load held     */
+#define STALL_STARVED           7       /* nothing from the prev stage  */
+#define STALL_TRACE_DONE        8       /* trace exhausted              */
+#define STALL_MAX               9
+
+#define OCC_DISP                0       /* queues tracked for occupancy */
+#define OCC_ISSUE               1
+#define OCC_EXEC                2
+#define OCC_ROB                 3       /* all in flight insts          */
+#define OCC_MAX                 4
+#define OCC_HIST_BINS           10      /* bins printed per histogram   */
+#define OCC_DEFAULT_INTERVAL    100     /* cycles per time series line  */
+
+#define PERF_INSTRUCTIONS       0       /* host counters, --perf-counters */
+#define PERF_CYCLES             1
+#define PERF_CACHE_MISSES       2
+#define PERF_BRANCH_MISSES      3
+#define PERF_MAX                4
+
+#define FU_MAX_UNITS            1024    /* units per functional unit pool */
+#define FU_MAX_LATENCY          255     /* g_latency is 8 bits wide     */
 
 #ifndef TRUE
 #define TRUE    1
@@ -53,7 +120,8 @@ typedef enum inst_state__ {
 typedef enum inst_type__ {
     TYPE_0,     /* latency = 1c */
     TYPE_1,     /* latency = 2c */
-    TYPE_2      /* latency = 5c */
+    TYPE_2,     /* latency = 5c */
+    TYPE_MAX    /* Unused boundary value    */
 } inst_type;
 
 typedef enum inst_latency__ {
@@ -73,8 +141,9 @@ extern FILE *g_trace_fptr;
 struct dis_reg_data {
     uint16_t    rnum;               /* register number, 0 - 127     */
     uint32_t    name;               /* newest assigned name         */
-    uint32_t    cycle;              /* when it was renamed last?    */
     bool        ready;              /* ready or not?                */
+    struct dis_reg_data *next;      /* next sreg waiting on the name*/
+    struct dis_inst_node *owner;    /* issue list node of the sreg  */
 };
 
 /* Inst list; fake ROB. */
@@ -85,6 +154,9 @@ struct dis_inst_node {
     struct dis_reg_data     sreg1;
     struct dis_reg_data     sreg2;
     struct dis_reg_data     dreg;
+    struct dis_inst_node    *link;  /* exec list: completion wheel slot
+                                       or pending mem insts; LSQ:
+                                       next word in the bucket      */
 };
 
 /* Dispatch list */
@@ -108,35 +180,224 @@ struct dis_list {
 struct dis_inst_data {
     uint32_t    num;                /* instrction number        */
     uint8_t     state;              /* fetch/decode/dispatch... */
-    uint32_t    pc;                 /* pc as given in trace     */
+    mem_addr_t  pc;                 /* pc as given in trace     */
     uint8_t     type;               /* inst type - 0, 1, 2      */
-    uint8_t     latency;            /* total latency for inst   */
+    uint32_t    latency;            /* total latency for inst   */
     uint16_t    dreg;               /* dst register             */
     uint16_t    sreg1;              /* src register 1           */
     uint16_t    sreg2;              /* src register 2           */
-    uint32_t    mem_addr;           /* mem address in trace     */
+    mem_addr_t  mem_addr;           /* mem address in trace     */
+    bool        mem_write;          /* store (TRUE) or load?    */
+    bool        mem_done;           /* cache lookup done?       */
+    bool        mem_fwd;            /* load forwarded from LSQ? */
+    struct dis_inst_node    *lsq_node;  /* LSQ entry, if mem inst */
+    struct dis_inst_data    *lsq_store; /* older store to the word  */
+    uint32_t    lsq_store_num;      /* its inst num; done insts are
+                                       freed, so check before use   */
+    uint32_t    sched_row;          /* issue queue row (matrix) */
+    uint32_t    sched_col;          /* producer column (matrix) */
+    uint64_t    sel_key;            /* select priority, low first */
     uint32_t    cycle[STATE_MAX];   /* state-cycle transition   */
 
 };
 
+/* Load/store queue stats */
+struct dis_lsq_stats {
+    uint32_t    num_loads;          /* loads seen               */
+    uint32_t    num_stores;         /* stores seen              */
+    uint32_t    num_fwds;           /* loads fed by older stores*/
+    uint32_t    num_held;           /* load-cycles held for an
+                                       unissued older store     */
+    uint32_t    num_full_stalls;    /* dispatch stalls, LSQ full*/
+};
+
+/* Physical register names */
+struct dis_prf {
+    uint32_t    num_regs;           /* # of names, RMT + window     */
+    uint32_t    *free_list;         /* stack of free names          */
+    uint32_t    num_free;
+    struct dis_reg_data **waiters;  /* per name, pending sregs of the
+                                       issue list                   */
+    uint32_t    *num_deps;          /* per name, # of insts which
+                                       dispatched waiting on it     */
+};
+
+/*
+ * Ready insts of the issue list, a min heap on the select key. The key
+ * holds the policy priority above the inst number, so ties go oldest first.
+ */
+struct dis_ready_heap {
+    struct dis_inst_node    **nodes;
+    uint32_t                count;
+    uint32_t                size;
+};
+
+/* Dependency matrix scheduler */
+struct dis_sched {
+    uint8_t     type;               /* SCHED_LIST or SCHED_MATRIX   */
+    uint32_t    num_rows;           /* issue queue rows, S          */
+    uint32_t    num_cols;           /* producers, issue + exec list */
+    uint32_t    num_words;          /* 64b words per row            */
+    uint64_t    *matrix;            /* [word][row] wait bits        */
+    uint32_t    *num_pending;       /* wait bits set, per row       */
+    uint8_t     *woken;             /* rows cleared by a wakeup     */
+    struct dis_inst_node    **row_node; /* issue list node of a row */
+    uint32_t    *free_rows;         /* stack of free rows           */
+    uint32_t    num_free_rows;
+    uint32_t    *free_cols;         /* stack of free columns        */
+    uint32_t    num_free_cols;
+    uint32_t    reg_col[REG_TOTAL + 1]; /* column of the newest name */
+};
+
+/*
+ * Functional unit pool of an inst type. Every unit of a pool takes a new
+ * inst once every 'ii' cycles, so the units free up in the order they were
+ * taken and a ring of their next free cycles stays sorted.
+ */
+struct dis_fu_pool {
+    uint32_t    count;              /* # of units, 0 = unlimited    */
+    uint32_t    latency;            /* overrides g_latency, 0 = no  */
+    uint32_t    ii;                 /* initiation interval, cycles  */
+    uint32_t    *free_at;           /* ring, cycle each unit is free*/
+    uint32_t    head;               /* unit that frees up first     */
+    uint32_t    num_issued;         /* insts issued to the pool     */
+    uint32_t    num_stalls;         /* ready inst-cycles held for
+                                       a free unit                  */
+};
+
+/* Use of the fetch, dispatch and issue slots, by stall reason */
+struct dis_stall_stats {
+    bool        on;                 /* --stall-stats given?         */
+    bool        trace_done;         /* fetched the last inst?       */
+    uint64_t    slots[STALL_STAGE_MAX][STALL_MAX];
+};
+
+/* Per cycle occupancy of the pipeline queues */
+struct dis_occupancy {
+    bool        on;                 /* --occupancy given?           */
+    uint32_t    size[OCC_MAX];      /* capacity of each queue       */
+    uint64_t    *hist[OCC_MAX];     /* # of cycles at each length   */
+    uint64_t    num_cycles;
+    char        series_path[MAX_FILE_NAME_LEN + 1];
+    FILE        *series;            /* time series, if asked for    */
+    uint32_t    interval;           /* cycles averaged per line     */
+    uint32_t    num_samples;        /* cycles in the current line   */
+    uint64_t    sum[OCC_MAX];       /* lengths in the current line  */
+};
+
+/* Host hardware counters around the main loop */
+struct dis_perf {
+    bool        on;                 /* --perf-counters given?       */
+    int         fd[PERF_MAX];       /* -1 if not available          */
+    int         leader;             /* group leader fd, -1 if none  */
+    uint32_t    order[PERF_MAX];    /* counters, in group order     */
+    uint32_t    num_open;           /* # of counters in the group   */
+    bool        valid[PERF_MAX];    /* count read?                  */
+    uint64_t    count[PERF_MAX];    /* scaled to the enabled time   */
+    double      running;            /* fraction of the time counted */
+    uint64_t    start_ns;           /* wall clock                   */
+    uint64_t    elapsed_ns;
+};
+
+/* Per cycle log of the pipeline and cache state, to diff two engines */
+struct dis_cyclelog {
+    char        path[MAX_FILE_NAME_LEN + 1];
+    FILE        *fptr;              /* NULL if not asked for        */
+    struct dis_inst_data    **done; /* insts done in the cycle      */
+};
+
+/* Dataflow limit of a trace, with no window or bandwidth limits */
+struct dis_dataflow {
+    bool        on;                 /* --dataflow given?            */
+    uint32_t    path_len;           /* critical path, in cycles     */
+    uint32_t    reg_ready[REG_TOTAL];   /* cycle each arch reg is
+                                           written by its producer  */
+};
+
+/*
+ * Lock-step run: the reference engine steps thru every cycle right after
+ * the fast one, on a dis data and caches of its own, and the two are
+ * compared. The globals of the engine not running are kept here.
+ */
+struct dis_lockstep {
+    struct dis_input    *ref;           /* shadow, NULL if not on       */
+    bool                shadow;         /* this is the shadow?          */
+    bool                trace_done;     /* shadow fetched the last inst?*/
+    uint32_t            inst_num;       /* g_inst_num                   */
+    FILE                *trace_fptr;    /* g_trace_fptr                 */
+    cache_ctx_t         *caches;        /* cache hierarchy              */
+};
+
 /* Main scheduler info data */
 struct dis_input {
     /* configuration data */
     uint32_t                    s;      /* Size of scheduling queue     */
     uint32_t                    n;      /* Pipeline bandwidth           */
-    cache_generic_t             *l1;    /* L1 cache data                */
-    cache_generic_t             *l2;    /* L2 cache data                */
+    cache_generic_t             *l1;    /* L1 cache data; rest chained  */
+    cache_generic_t             *vc;    /* L1 victim cache data         */
+    uint32_t                    victim_size;    /* VC size, 0 = no VC       */
+    uint32_t                    mshr_size;      /* # of L1 MSHRs, 0 = off   */
+    uint32_t                    fill_interval;  /* cycles b/w two fills     */
+    uint32_t                    set_sample;     /* L2+: simulate 1 in n sets*/
+    uint32_t                    lsq_size;       /* # of LSQ entries         */
+    uint8_t                     addr_bits;      /* # of address bits        */
+    uint8_t                     pf_type[CACHE_MAX_LEVELS];  /* prefetchers  */
+    uint8_t                     pf_degree[CACHE_MAX_LEVELS];
     char                        tracefile[MAX_FILE_NAME_LEN + 1];
+    char                        cache_config[MAX_FILE_NAME_LEN + 1];
+    bool                        generic_kernel; /* no (S, N) kernels        */
+    uint8_t                     select;         /* issue select policy      */
+    uint8_t                     engine;         /* pipeline engine          */
 
-    /* registers */
-    struct dis_reg_data         *rmt[REG_TOTAL + 1];    /* register data/rmt */
+    /* warm cache snapshots */
+    char                        snapshot_save[MAX_FILE_NAME_LEN + 1];
+    char                        snapshot_load[MAX_FILE_NAME_LEN + 1];
+    uint32_t                    snapshot_at;    /* save after n insts, 0=end */
+    bool                        snapshot_done;  /* snapshot saved already?  */
+    char                        dump_bin[MAX_FILE_NAME_LEN + 1]; /* final */
+
+    /* registers; each RMT entry packs the ready bit and the name */
+    uint32_t                    rmt[REG_TOTAL + 1]
+                                    __attribute__((aligned(RMT_ALIGN)));
+    struct dis_inst_node        **rename_group; /* insts renamed together */
+    struct dis_reg_data         ref_rmt[REG_TOTAL + 1]; /* reference engine;
+                                                   names are producer inst
+                                                   nums, never reused       */
 
     /* pipeline lists */
     struct dis_inst_list        *list_inst;     /* inst. list               */
     struct dis_disp_list        *list_disp;     /* dispatch list            */
     struct dis_list             *list_issue;    /* issue list               */
     struct dis_list             *list_exec;     /* execute list             */
-    struct dis_list             *list_wback;    /* writeback list           */
+    struct dis_list             *list_wback;    /* writeback list; insts
+                                                   done since the last
+                                                   retire, len counts all   */
+    struct dis_list             *list_lsq;      /* load/store queue         */
+    struct dis_inst_node        **lsq_words;    /* LSQ, youngest store by
+                                                   word; chained on link    */
+    uint32_t                    lsq_words_mask; /* # of word buckets - 1    */
+    struct dis_lsq_stats        lsq_stats;      /* load/store queue stats   */
+    struct dis_sched            sched;          /* issue queue wakeup       */
+    struct dis_ready_heap       ready;          /* issue list, ready insts  */
+    struct dis_inst_node        **held;         /* ready insts held back,
+                                                   by select key            */
+    struct dis_inst_node        **held_next;    /* held ones, next cycle    */
+    uint32_t                    num_held;       /* # of held insts          */
+    struct dis_inst_node        *wheel[EXEC_WHEEL_SIZE];    /* exec list, by
+                                                   completion cycle         */
+    struct dis_inst_node        *mem_pending;   /* exec list, waiting on L1 */
+    struct dis_inst_node        **mem_pending_tail;
+    struct dis_prf              prf;            /* physical reg names       */
+    struct dis_dataflow         dataflow;       /* dataflow limit mode      */
+    struct dis_fu_pool          fu[TYPE_MAX];   /* functional unit pools    */
+    struct dis_stall_stats      stalls;         /* slot use, by reason      */
+    struct dis_occupancy        occupancy;      /* queue occupancy          */
+    struct dis_perf             perf;           /* host counters            */
+    struct dis_cyclelog         cyclelog;       /* per cycle log            */
+    struct dis_lockstep         lockstep;       /* ref engine shadow        */
+
+    /* memory refs issued to L1 in a cycle */
+    cache_batch_t               mem_batch;
 };
 
 
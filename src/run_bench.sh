@@ -0,0 +1,160 @@
+#
+# ECE 521 - Computer Design Techniques, Fall 2014
+# Project 3 - Dynamic Instruction Scheduler
+#
+# Module: run_bench.sh
+#
+# Shell script to benchmark the simulator itself. Runs a fixed matrix of
+# S/N/cache configurations over the given traces and synthetic ones from
+# tracegen, and reports simulated insts per host second and peak RSS, as
+# printed by --perf-counters. Each run is repeated and the best time kept.
+# The results can be saved as a baseline, and later runs compared against
+# it; a config slower than the baseline by more than the threshold is a
+# regression and the script exits with 1.
+#
+# Author: Aravindhan Dhanasekaran <adhanas@ncsu.edu>
+#
+
+#!/bin/bash
+
+SIM="./sim"
+TRACEGEN="./tracegen"
+BENCH_DIR="bench"
+REPEAT="3"
+THRESHOLD="10"
+BASELINE=""
+SAVE_BASELINE=""
+
+# <name> <tracegen options>
+SYNTH_TRACES=(
+    "alu     --insts 200000 --mem-frac 0 --mix 2:1 --dep-mean 3"
+    "mem     --insts 200000 --mem-frac 0.4 --footprint 1048576 --locality 0.6"
+    "wide    --insts 200000 --mem-frac 0.2 --dep-mean 32 --src2-frac 0.2"
+)
+
+# <name> <trace> <sim arguments, trace file last>
+CONFIGS=(
+    "gcc_16x4         ../docs/val_gcc_trace_mem.txt  16 4 0 0 0 0 0"
+    "perl_64x8_l2     ../docs/val_perl_trace_mem.txt 64 8 32 1024 4 2048 8"
+    "alu_64x8         $BENCH_DIR/alu.txt             64 8 0 0 0 0 0"
+    "alu_1024x64      $BENCH_DIR/alu.txt             1024 64 0 0 0 0 0"
+    "mem_32x4_l2      $BENCH_DIR/mem.txt             32 4 32 8192 4 262144 8"
+    "mem_128x8_mshr   $BENCH_DIR/mem.txt             128 8 32 8192 4 262144 8 --mshr 8"
+    "wide_256x16      $BENCH_DIR/wide.txt            256 16 32 8192 4 0 0"
+    "wide_256x16_mtx  $BENCH_DIR/wide.txt            256 16 32 8192 4 0 0 --sched matrix"
+)
+
+
+function print_usage()
+{
+    echo "Usage: $0 [-r <repeat>] [-b <baseline>] [-s <save-baseline>] [-t <pct>]"
+    echo "repeat: runs per config, best one kept; default $REPEAT"
+    echo "baseline: compare against the results in this file"
+    echo "save-baseline: save the results to this file"
+    echo "pct: slowdown over the baseline flagged as a regression; default $THRESHOLD"
+}
+
+
+# Build the simulator and the trace generator, and the synthetic traces.
+function prepare()
+{
+    make all tracegen > /dev/null || exit 1
+    mkdir -p $BENCH_DIR
+
+    for entry in "${SYNTH_TRACES[@]}"
+    do
+        set -- $entry
+        name=$1
+        shift
+        if [ ! -s "$BENCH_DIR/$name.txt" ]
+        then
+            $TRACEGEN "$@" > $BENCH_DIR/$name.txt || exit 1
+        fi
+    done
+}
+
+
+# Run one config; prints "<insts per sec> <peak rss KB>" of the best run.
+function run_config()
+{
+    trace=$1
+    shift
+    best_ips="0"
+    rss="0"
+
+    for run in $(seq 1 $REPEAT)
+    do
+        out=$($SIM --perf-counters "$@" $trace | \
+            awk -F'= ' '/sim insts per host second/ {ips = $2}
+                        /host peak RSS/ {rss = $2}
+                        END {print ips, rss}')
+        ips=${out% *}
+        rss=${out#* }
+        if [ -n "$ips" ] && [ "${ips%.*}" -gt "${best_ips%.*}" ]
+        then
+            best_ips=$ips
+        fi
+    done
+    echo "$best_ips $rss"
+}
+
+
+while getopts "r:b:s:t:h" opt
+do
+    case $opt in
+        r) REPEAT=$OPTARG ;;
+        b) BASELINE=$OPTARG ;;
+        s) SAVE_BASELINE=$OPTARG ;;
+        t) THRESHOLD=$OPTARG ;;
+        *) print_usage
+           exit 0 ;;
+    esac
+done
+
+prepare
+
+rc=0
+results=""
+printf "%-18s %14s %12s %14s %8s\n" "config" "insts/sec" "rss (KB)" \
+    "baseline" "change"
+for entry in "${CONFIGS[@]}"
+do
+    set -- $entry
+    name=$1
+    trace=$2
+    shift 2
+
+    set -- $(run_config $trace "$@")
+    ips=$1
+    rss=$2
+    results="$results$name $ips $rss"$'\n'
+
+    base="-"
+    change="-"
+    if [ -n "$BASELINE" ] && [ -f "$BASELINE" ]
+    then
+        base=$(awk -v n=$name '$1 == n {print $2}' $BASELINE)
+        if [ -n "$base" ]
+        then
+            change=$(awk -v a=$ips -v b=$base \
+                'BEGIN {printf "%+.1f%%", ((a - b) * 100.0) / b}')
+            if awk -v a=$ips -v b=$base -v t=$THRESHOLD \
+                'BEGIN {exit !(a < (b * (100.0 - t) / 100.0))}'
+            then
+                change="$change REGRESSION"
+                rc=1
+            fi
+        else
+            base="-"
+        fi
+    fi
+    printf "%-18s %14s %12s %14s %8s\n" $name $ips $rss $base "$change"
+done
+
+if [ -n "$SAVE_BASELINE" ]
+then
+    echo -n "$results" > $SAVE_BASELINE
+    echo "Saved the results to $SAVE_BASELINE"
+fi
+
+exit $rc
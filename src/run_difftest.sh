@@ -0,0 +1,158 @@
+#
+# ECE 521 - Computer Design Techniques, Fall 2014
+# Project 3 - Dynamic Instruction Scheduler
+#
+# Module: run_difftest.sh
+#
+# Shell script to check the fast pipeline engine against the reference one
+# on random synthetic traces and configurations. Each case runs the
+# simulator with --engine lockstep, which steps the reference engine thru
+# every cycle right after the fast one, in the same process, and compares
+# the list lengths, every inst in flight, the RMT ready bits, the LSQ, FU
+# and stall counts and the cache and MSHR stats; it quits at the first
+# difference, which is reported here along with a command line to
+# reproduce it. Runs that match all the way also have to print the same
+# output as a run of the reference engine alone.
+#
+# Coverage: the reference engine keeps the baseline rename (tags are
+# producer inst numbers), dispatch, wakeup by tag compare, list walks for
+# issue and execute, a list search for the LSQ, a scan of the FU units and
+# one reference at a time into L1. Only the trace parsing of fetch, retire,
+# the issue stall accounting and the cache model below its entry point are
+# the same code in both, so a bug there is NOT caught here; the validation
+# runs of run_tests.sh cover those.
+#
+# Author: Aravindhan Dhanasekaran <adhanas@ncsu.edu>
+#
+
+#!/bin/bash
+
+SIM="./sim"
+TRACEGEN="./tracegen"
+WORK_DIR="difftest"
+NUM_RUNS="50"
+SEED="1"
+RUN_TIMEOUT="600"
+
+
+function print_usage()
+{
+    echo "Usage: $0 [-n <runs>] [-s <seed>]"
+    echo "runs: # of random traces and configurations; default $NUM_RUNS"
+    echo "seed: seed of the random picks; default $SEED"
+}
+
+
+# Prints one of the given arguments, at random.
+function pick()
+{
+    shift $((RANDOM % $#))
+    echo $1
+}
+
+
+# Build the simulator and the trace generator.
+function prepare()
+{
+    make all tracegen > /dev/null || exit 1
+    mkdir -p $WORK_DIR
+}
+
+
+# Picks a random trace and configuration; sets TRACE_ARGS and SIM_ARGS.
+function random_case()
+{
+    TRACE_ARGS="--insts $((1000 + (RANDOM % 20000))) --seed $RANDOM"
+    TRACE_ARGS="$TRACE_ARGS --mem-frac 0.$((RANDOM % 6))"
+    TRACE_ARGS="$TRACE_ARGS --store-frac 0.$((RANDOM % 6))"
+    TRACE_ARGS="$TRACE_ARGS --src2-frac 0.$((RANDOM % 10))"
+    TRACE_ARGS="$TRACE_ARGS --dep-mean $((1 + (RANDOM % 16)))"
+    TRACE_ARGS="$TRACE_ARGS --footprint $(pick 4096 65536 1048576)"
+    TRACE_ARGS="$TRACE_ARGS --locality 0.$((RANDOM % 10))"
+
+    caches=$(pick "0 0 0 0 0" "16 512 2 0 0" "32 1024 4 0 0" \
+        "32 1024 4 8192 8" "64 2048 1 16384 4")
+    SIM_ARGS="--select $(pick oldest loads-first longest-latency critical-path)"
+    if [ $((RANDOM % 2)) -eq 0 ]
+    then
+        SIM_ARGS="$SIM_ARGS --sched matrix"
+    fi
+    if [ $((RANDOM % 4)) -eq 0 ]
+    then
+        SIM_ARGS="$SIM_ARGS --generic-kernel"
+    fi
+    if [ $((RANDOM % 3)) -eq 0 ]
+    then
+        SIM_ARGS="$SIM_ARGS --lsq $((1 + (RANDOM % 16)))"
+    fi
+    if [ $((RANDOM % 3)) -eq 0 ]
+    then
+        SIM_ARGS="$SIM_ARGS --fu $((RANDOM % 3)):$((1 + (RANDOM % 4)))"
+        SIM_ARGS="$SIM_ARGS:$((1 + (RANDOM % 6))):$((1 + (RANDOM % 3)))"
+    fi
+    if [ "${caches%% *}" != "0" ] && [ $((RANDOM % 3)) -eq 0 ]
+    then
+        SIM_ARGS="$SIM_ARGS --mshr $((1 + (RANDOM % 8)))"
+        SIM_ARGS="$SIM_ARGS --fill-interval $((RANDOM % 4))"
+    fi
+    SIM_ARGS="$SIM_ARGS --stall-stats"
+    SIM_ARGS="$SIM_ARGS $(pick 1 2 4 8 16 32 64 128 256 $((1 + (RANDOM % 300))))"
+    SIM_ARGS="$SIM_ARGS $(pick 1 2 3 4 8 16) $caches"
+}
+
+
+# Runs one case; returns 0 if the engines agree.
+function run_case()
+{
+    $TRACEGEN $TRACE_ARGS > $WORK_DIR/trace.txt || exit 1
+
+    timeout $RUN_TIMEOUT $SIM --engine lockstep $SIM_ARGS \
+        $WORK_DIR/trace.txt > $WORK_DIR/fast.out 2>&1
+    rc=$?
+    if [ $rc -ne 0 ]
+    then
+        echo "  lock-step run failed ($rc):"
+        grep -o "ERROR.*" $WORK_DIR/fast.out | head -3 | sed "s/^/  /"
+        return 1
+    fi
+
+    $SIM --engine ref $SIM_ARGS $WORK_DIR/trace.txt > $WORK_DIR/ref.out 2>&1
+    if ! cmp -s $WORK_DIR/ref.out $WORK_DIR/fast.out
+    then
+        echo "  outputs differ:"
+        diff $WORK_DIR/ref.out $WORK_DIR/fast.out | head -10
+        return 1
+    fi
+    return 0
+}
+
+
+while getopts "n:s:h" opt
+do
+    case $opt in
+        n) NUM_RUNS=$OPTARG ;;
+        s) SEED=$OPTARG ;;
+        *) print_usage
+           exit 0 ;;
+    esac
+done
+
+prepare
+RANDOM=$SEED
+
+num_fails=0
+for run in $(seq 1 $NUM_RUNS)
+do
+    random_case
+    if ! run_case
+    then
+        num_fails=$((num_fails + 1))
+        cp $WORK_DIR/trace.txt $WORK_DIR/fail_$run.txt
+        echo "FAIL run $run: $SIM --engine lockstep $SIM_ARGS" \
+            "$WORK_DIR/fail_$run.txt"
+        echo "  trace: $TRACEGEN $TRACE_ARGS"
+    fi
+done
+
+echo "$((NUM_RUNS - num_fails)) of $NUM_RUNS runs matched"
+[ $num_fails -eq 0 ]
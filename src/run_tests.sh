@@ -18,7 +18,8 @@ NUM_PARAMS=2
 function print_usage()
 {
     echo "Usage: $0 <test-#> <diff-required>"
-    echo "test-#: gcc - 1, perl - 2, gcc extra - 3, gcc perl - 4, all - 5"
+    echo "test-#: gcc - 1, perl - 2, gcc extra - 3, gcc perl - 4, all - 5,"
+    echo "        snapshot round trip - 6"
     echo "diff-required: 0 - no diff, 1 - with diff"
 }
 
@@ -110,6 +111,48 @@ function perl_extra()
 }
 
 
+# Max EX cycles of an inst in the given sim output.
+function max_ex()
+{
+    sed -n 's/.*EX{[0-9]*,\([0-9]*\)}.*/\1/p' $1 | sort -n | tail -1
+}
+
+
+# Save a warm cache snapshot with the L1 prefetcher on and restore it, with
+# and without the prefetcher. No ref in the restored runs may wait longer
+# than the slowest ref of a cold run; blocks still marked prefetched by the
+# old run must not hold refs up till the old run's fill cycles.
+function snapshot()
+{
+    SNAP_ARGS="16 4 32 1024 4 0 0 snap_trace.txt"
+
+    echo "Begin snapshot round trip test run.."
+    make tracegen > /dev/null || exit 1
+    ./tracegen --insts 100000 --seed 5 > snap_trace.txt
+    ./sim --prefetch 1:next-line:4 --snapshot-save snap_pf.bin $SNAP_ARGS \
+        > ad_snap_cold.txt
+    ./sim --snapshot-load snap_pf.bin $SNAP_ARGS > ad_snap_load.txt
+    ./sim --prefetch 1:next-line:4 --snapshot-load snap_pf.bin $SNAP_ARGS \
+        > ad_snap_load_pf.txt
+    echo "End snapshot round trip test run.."
+
+    cold=$(max_ex ad_snap_cold.txt)
+    for out in ad_snap_load.txt ad_snap_load_pf.txt
+    do
+        if [ "$(max_ex $out)" -gt "$cold" ]
+        then
+            echo "FAIL: $out max EX $(max_ex $out), cold run $cold"
+        else
+            echo "PASS: $out max EX $(max_ex $out), cold run $cold"
+        fi
+    done
+    rm -f snap_trace.txt snap_pf.bin
+
+    echo " "
+    echo "~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~"
+}
+
+
 if [ $# -ne "$NUM_PARAMS" ]
 then
     echo "Error: Invalid usage."
@@ -126,6 +169,8 @@ case "$1" in
        perl $2
        gcc_extra $2
        perl_extra $2
+       snapshot
        ;;
+    6) snapshot ;;
 esac
 
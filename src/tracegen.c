@@ -0,0 +1,236 @@
+/*
+ * ECE 521 - Computer Design Techniques, Fall 2014
+ * Project 3 - Dynamic Instruction Scheduler
+ *
+ * This module implements a synthetic trace generator for benchmarking the
+ * simulator. It writes traces in the format of docs/pa2_spec.pdf, section 3,
+ * with the r/w column, to stdout:
+ *  - Mem insts are type 2 and make up a given fraction of the trace; the
+ *    rest are type 0 or 1, per the given mix. Type 2 insts always carry an
+ *    address, as the simulator times a type 2 inst with no address at zero
+ *    latency when the L1 is on and never completes it.
+ *  - Each source reg reads the dreg of an inst a geometrically distributed
+ *    distance back. Dregs are handed out round robin, so a reg is not
+ *    written again for REG_TOTAL insts and the distance holds.
+ *  - Mem addresses fall in a footprint of the given size; with the given
+ *    probability the next address is the word after the last one, else a
+ *    random word of the footprint.
+ *
+ * Author: Aravindhan Dhanasekaran <adhanas@ncsu.edu>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <math.h>
+#include <getopt.h>
+
+#define TG_REG_TOTAL            128
+#define TG_NO_REG               -1
+#define TG_PC_BASE              0x400000
+#define TG_ADDR_BASE            0x10000000
+#define TG_WORD_SIZE            4
+
+/* Trace generator knobs */
+struct tg_config {
+    uint32_t    num_insts;
+    double      mix[2];             /* type 0/1 share, non-mem      */
+    double      mem_frac;           /* mem insts, all type 2        */
+    double      store_frac;         /* of the mem insts             */
+    double      src2_frac;          /* insts with a second source   */
+    double      dep_mean;           /* mean dependency distance     */
+    uint64_t    footprint;          /* bytes                        */
+    double      locality;           /* P(next word is sequential)   */
+    uint32_t    seed;
+};
+
+static struct option g_tg_opts[] = {
+    {"insts",       required_argument,  NULL,   'n'},
+    {"mix",         required_argument,  NULL,   'x'},
+    {"mem-frac",    required_argument,  NULL,   'm'},
+    {"store-frac",  required_argument,  NULL,   'w'},
+    {"src2-frac",   required_argument,  NULL,   '2'},
+    {"dep-mean",    required_argument,  NULL,   'd'},
+    {"footprint",   required_argument,  NULL,   'f'},
+    {"locality",    required_argument,  NULL,   'l'},
+    {"seed",        required_argument,  NULL,   's'},
+    {NULL,          0,                  NULL,   0}
+};
+
+
+static void
+tg_print_usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [options] > <trace-file>\n", prog);
+    fprintf(stderr, "    --insts <n>         : # of insts; default 100000.\n");
+    fprintf(stderr, "    --mix <a>:<b>       : type 0/1 weights of the "
+            "non-mem insts;\n"
+            "                          default 2:1.\n");
+    fprintf(stderr, "    --mem-frac <f>      : fraction of mem insts; "
+            "default 0.3.\n");
+    fprintf(stderr, "    --store-frac <f>    : fraction of the mem insts "
+            "that are stores;\n"
+            "                          default 0.3.\n");
+    fprintf(stderr, "    --src2-frac <f>     : fraction of insts with a "
+            "second source;\n"
+            "                          default 0.5.\n");
+    fprintf(stderr, "    --dep-mean <d>      : mean dependency distance, "
+            "geometric; default 4.\n");
+    fprintf(stderr, "    --footprint <b>     : mem footprint in bytes; "
+            "default 65536.\n");
+    fprintf(stderr, "    --locality <p>      : chance the next address is "
+            "sequential;\n"
+            "                          default 0.7.\n");
+    fprintf(stderr, "    --seed <s>          : random seed; default 1.\n");
+    return;
+}
+
+
+/* Returns a uniform random number in [0, 1). */
+static inline double
+tg_rand(void)
+{
+    return ((double) rand() / ((double) RAND_MAX + 1.0));
+}
+
+
+/* Returns a geometrically distributed distance >= 1 with the given mean. */
+static inline uint32_t
+tg_rand_distance(double mean)
+{
+    if (mean <= 1.0)
+        return 1;
+    return (1 + (uint32_t) floor(log(1.0 - tg_rand()) /
+                log(1.0 - (1.0 / mean))));
+}
+
+
+/*
+ * Picks a source reg: the dreg of the inst the given distance back, if it
+ * wrote one and is still within the last REG_TOTAL insts.
+ */
+static inline int32_t
+tg_pick_src(const int32_t *history, uint32_t inst, double dep_mean)
+{
+    uint32_t dist = tg_rand_distance(dep_mean);
+
+    if ((dist > inst) || (dist >= TG_REG_TOTAL))
+        return TG_NO_REG;
+    return history[(inst - dist) % TG_REG_TOTAL];
+}
+
+
+static int
+tg_generate(struct tg_config *config)
+{
+    uint32_t    i = 0;
+    uint32_t    type = 0;
+    uint32_t    next_reg = 0;
+    int32_t     dreg = 0;
+    int32_t     sreg1 = 0;
+    int32_t     sreg2 = 0;
+    int32_t     history[TG_REG_TOTAL];
+    uint64_t    mem_addr = 0;
+    uint64_t    last_word = 0;
+    uint64_t    num_words = 0;
+    double      pick = 0.0;
+    double      mix_total = 0.0;
+    char        mem_op = 'r';
+
+    srand(config->seed);
+    num_words = (config->footprint / TG_WORD_SIZE);
+    if (!num_words)
+        num_words = 1;
+    mix_total = (config->mix[0] + config->mix[1]);
+
+    for (i = 0; i < config->num_insts; ++i) {
+        sreg1 = tg_pick_src(history, i, config->dep_mean);
+        sreg2 = ((tg_rand() < config->src2_frac) ?
+                tg_pick_src(history, i, config->dep_mean) : TG_NO_REG);
+        mem_addr = 0;
+        mem_op = 'r';
+
+        if (tg_rand() < config->mem_frac) {
+            type = 2;
+            if (tg_rand() < config->locality)
+                last_word = ((last_word + 1) % num_words);
+            else
+                last_word = ((uint64_t) (tg_rand() * (double) num_words));
+            mem_addr = (TG_ADDR_BASE + (last_word * TG_WORD_SIZE));
+            if (tg_rand() < config->store_frac)
+                mem_op = 'w';
+        } else {
+            pick = (tg_rand() * mix_total);
+            type = ((pick < config->mix[0]) ? 0 : 1);
+        }
+
+        /* Stores write no reg. */
+        dreg = TG_NO_REG;
+        if ('w' != mem_op) {
+            dreg = next_reg;
+            next_reg = ((next_reg + 1) % TG_REG_TOTAL);
+        }
+        history[i % TG_REG_TOTAL] = dreg;
+
+        printf("%x %u %d %d %d %" PRIx64 " %c\n",
+                (TG_PC_BASE + ((i % 4096) * TG_WORD_SIZE)), type, dreg,
+                sreg1, sreg2, mem_addr, mem_op);
+    }
+    return 0;
+}
+
+
+int
+main(int argc, char **argv)
+{
+    int                 opt = 0;
+    struct tg_config    config = {100000, {2, 1}, 0.3, 0.3, 0.5, 4.0,
+                                  65536, 0.7, 1};
+
+    while (-1 != (opt = getopt_long(argc, argv, "", g_tg_opts, NULL))) {
+        switch (opt) {
+        case 'n':
+            config.num_insts = strtoul(optarg, NULL, 0);
+            break;
+        case 'x':
+            if (2 != sscanf(optarg, "%lf:%lf", &config.mix[0],
+                        &config.mix[1]))
+                goto error_exit;
+            break;
+        case 'm':
+            config.mem_frac = atof(optarg);
+            break;
+        case 'w':
+            config.store_frac = atof(optarg);
+            break;
+        case '2':
+            config.src2_frac = atof(optarg);
+            break;
+        case 'd':
+            config.dep_mean = atof(optarg);
+            break;
+        case 'f':
+            config.footprint = strtoull(optarg, NULL, 0);
+            break;
+        case 'l':
+            config.locality = atof(optarg);
+            break;
+        case 's':
+            config.seed = strtoul(optarg, NULL, 0);
+            break;
+        default:
+            goto error_exit;
+        }
+    }
+
+    if ((optind != argc) || ((config.mix[0] + config.mix[1]) <= 0.0))
+        goto error_exit;
+
+    return tg_generate(&config);
+
+error_exit:
+    tg_print_usage(argv[0]);
+    return -1;
+}